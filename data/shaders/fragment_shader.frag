@@ -1,6 +1,14 @@
 #version 450
 
-layout(binding = 1) uniform sampler2D texSampler;
+layout(binding = 1) uniform sampler2DArray texSampler;
+
+// Where the material's texture is in the array, see TextureRegion.
+layout(push_constant) uniform Material
+{
+    vec2 offset;
+    vec2 scale;
+    uint layer;
+} material;
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
@@ -9,5 +17,10 @@ layout(location = 0) out vec4 outColor;
 
 void main() 
 {
-    outColor = texture(texSampler, fragTexCoord);
-}
\ No newline at end of file
+    // Atlased textures repeat within their region. The gradients come from the
+    // unwrapped coordinates, so the wrap doesn't pick the smallest level.
+    vec2 uv = material.offset + fract(fragTexCoord) * material.scale;
+    vec2 dx = dFdx(fragTexCoord) * material.scale;
+    vec2 dy = dFdy(fragTexCoord) * material.scale;
+    outColor = textureGrad(texSampler, vec3(uv, float(material.layer)), dx, dy);
+}
@@ -0,0 +1,31 @@
+#version 450
+
+#define PAGE_SIZE 128.0
+
+layout(push_constant) uniform VirtualTexture
+{
+    vec2 scale;
+    float size;
+    float maxLevel;
+    float lodBias;
+    float cacheSize;
+} vt;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out uint outPage;
+
+// Writes the page virtual_fragment_shader samples at full resolution, lodBias
+// makes up for the smaller target.
+void main()
+{
+    vec2 texel = fragTexCoord * vt.scale * vt.size;
+    float lod = log2(max(length(dFdx(texel)), length(dFdy(texel)))) + vt.lodBias;
+    int level = int(clamp(lod, 0.0, vt.maxLevel));
+
+    vec2 uv = fract(fragTexCoord) * vt.scale;
+    ivec2 pages = ivec2(vt.size / PAGE_SIZE) >> level;
+    uvec2 page = uvec2(clamp(ivec2(uv * vec2(pages)), ivec2(0), pages - 1));
+    outPage = (uint(level) << 28) | (page.y << 14) | page.x;
+}
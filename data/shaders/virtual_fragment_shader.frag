@@ -0,0 +1,45 @@
+#version 450
+
+#define PAGE_SIZE 128.0
+#define PAGE_BORDER 4.0
+#define PAGE_STRIDE 136.0
+
+layout(binding = 2) uniform usampler2D pageTable;
+layout(binding = 3) uniform sampler2D pageCache;
+
+layout(push_constant) uniform VirtualTexture
+{
+    vec2 scale;
+    float size;
+    float maxLevel;
+    float lodBias;
+    float cacheSize;
+} vt;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    // The level is picked from the footprint at level 0 before wrapping, so
+    // the wrap doesn't show up in the derivatives.
+    vec2 texel = fragTexCoord * vt.scale * vt.size;
+    float lod = log2(max(length(dFdx(texel)), length(dFdy(texel)))) + vt.lodBias;
+    int level = int(clamp(lod, 0.0, vt.maxLevel));
+
+    vec2 uv = fract(fragTexCoord) * vt.scale;
+    ivec2 pages = ivec2(vt.size / PAGE_SIZE) >> level;
+    uvec4 entry = texelFetch(pageTable, clamp(ivec2(uv * vec2(pages)), ivec2(0), pages - 1), level);
+    if (entry.a == 0u)
+    {
+        outColor = vec4(0.5, 0.5, 0.5, 1.0);
+        return;
+    }
+
+    // The entry may be a coarser page covering this one.
+    vec2 inPage = fract(uv * (vt.size / PAGE_SIZE) / float(1u << entry.b));
+    vec2 cacheTexel = vec2(entry.rg) * PAGE_STRIDE + PAGE_BORDER + inPage * PAGE_SIZE;
+    outColor = textureLod(pageCache, cacheTexel / vt.cacheSize, 0.0);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <MyMath.hpp>
+#include <MappedFile.hpp>
+#include <ThreadPool.hpp>
+
+#define ARCHIVE_MAGIC 0x4B434150 // "PACK"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_BLOCK_SIZE (64 * 1024)
+#define ARCHIVE_ALIGNMENT 64
+
+#define ARCHIVE_ENTRY_COMPRESSED 0x1
+
+typedef struct ArchiveHeader
+{
+    u32 magic;
+    u32 version;
+    u32 entryCount;
+    u32 blockCount;
+    u64 namesSize;
+    u64 dataOffset;
+} ArchiveHeader;
+
+// Stored entries are size bytes at offset, compressed ones blockCount blocks
+// of ARCHIVE_BLOCK_SIZE bytes, the last one shorter, that decode in order.
+typedef struct ArchiveEntry
+{
+    u32 nameOffset;
+    u32 nameLength;
+    u32 flags;
+    u32 firstBlock;
+    u32 blockCount;
+    u32 reserved;
+    u64 offset;
+    u64 size;
+} ArchiveEntry;
+
+// LZ4 block, or a copy of the data when compressedSize equals size.
+typedef struct ArchiveBlock
+{
+    u64 offset;
+    u32 compressedSize;
+    u32 size;
+} ArchiveBlock;
+
+// Single file holding many assets: the header, the entries sorted by name,
+// the block table and the names, then the data aligned to ARCHIVE_ALIGNMENT.
+// Everything before the data is used straight out of the mapping, so looking
+// a file up is a binary search over mapped entries.
+class AssetArchive
+{
+public:
+    AssetArchive() = default;
+
+    // Names are the paths as given, with forward slashes. Blocks are
+    // compressed on the pool; entries that don't shrink are stored as is.
+    static bool Write(const std::string& archivePath, const std::vector<std::string>& paths, ThreadPool& pool);
+    static std::string NormalizePath(const std::string& path);
+
+    bool Open(const std::string& archivePath);
+    void Close();
+
+    const ArchiveEntry* Find(const std::string& path) const;
+    u32 GetEntryCount() const;
+
+    // Stored entries point into the mapping, compressed ones return null and
+    // have to be read.
+    const char* GetStoredData(const ArchiveEntry& entry) const;
+
+    // Decodes the entry's blocks into entry.size bytes at destination, spread
+    // over the pool when there is one.
+    void Read(const ArchiveEntry& entry, ThreadPool* pool, void* destination) const;
+
+private:
+    MappedFile m_file;
+    const ArchiveHeader* m_header = nullptr;
+    const ArchiveEntry* m_entries = nullptr;
+    const ArchiveBlock* m_blocks = nullptr;
+    const char* m_names = nullptr;
+};
+
+// Mounted archives are searched by MappedFile::Open before the file system,
+// most recently mounted first. They stay mapped until unmounted, which must
+// come after every file opened from them is closed.
+bool MountArchive(const std::string& archivePath, ThreadPool* pool);
+void UnmountArchives();
+
+// Stored files point data into the archive, compressed ones are decoded into
+// buffer. Returns false when no mounted archive has the file.
+bool ReadArchivedFile(const std::string& path, const char*& data, size_t& size, std::unique_ptr<char[]>& buffer);
+bool IsArchivedFile(const std::string& path);
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+
+#include <MyMath.hpp>
+
+#define COOKED_ASSET_EXTENSION ".cooked"
+#define MAX_ASSET_DEPENDENCIES 8
+
+// Content hashes of the files a cached or cooked asset was built from, its
+// source first. The asset is stale as soon as any of them changes.
+typedef struct AssetDependencies
+{
+    u32 count;
+    u32 reserved;
+    u64 hashes[MAX_ASSET_DEPENDENCIES];
+} AssetDependencies;
+
+static inline bool SameDependencies(const AssetDependencies& a, const AssetDependencies& b)
+{
+    if (a.count != b.count)
+        return false;
+    for (u32 i = 0; i < a.count && i < MAX_ASSET_DEPENDENCIES; i++)
+        if (a.hashes[i] != b.hashes[i])
+            return false;
+    return true;
+}
+
+// Cooked assets sit next to their source, the runtime loads them in its place
+// without reading the source at all.
+static inline std::string GetCookedPath(const char* sourcePath)
+{
+    return std::string(sourcePath) + COOKED_ASSET_EXTENSION;
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <MyMath.hpp>
+#include <AsyncIo.hpp>
+#include <GlbParser.hpp>
+#include <Ktx2File.hpp>
+#include <MappedFile.hpp>
+#include <MeshCache.hpp>
+#include <MeshletBuilder.hpp>
+#include <MeshSimplifier.hpp>
+#include <TextureCache.hpp>
+#include <ThreadPool.hpp>
+#include <VertexPacking.hpp>
+
+#define OPTIMIZE_MESHES true
+#define GENERATE_MESH_LODS true
+#define PREFER_COOKED_ASSETS true
+#define MODEL_CACHE_FLAGS ((OPTIMIZE_MESHES ? MESH_CACHE_OPTIMIZED : 0) | (GENERATE_MESH_LODS ? MESH_CACHE_LODS : 0))
+#define OBJ_STREAM_THRESHOLD (512ull * 1024 * 1024)
+#define STREAM_STAGING_CHUNK_SIZE (64ull * 1024 * 1024)
+
+// Hands out mapped, host visible upload memory to streamed loads from any
+// thread: size bytes in the staging buffer whose id it stores in buffer.
+typedef std::function<void*(size_t size, u32& buffer)> StagingAllocator;
+
+// A copy from a staging buffer into the model's vertex or index buffer.
+typedef struct StagedRange
+{
+    u32 buffer;
+    bool index;
+    u64 sourceOffset;
+    u64 destinationOffset;
+    u64 size;
+} StagedRange;
+
+// CPU side of a loaded model. The data pointers either point into the mesh
+// cache mapping or into the vectors built from the source file.
+typedef struct ModelAsset
+{
+    MeshCache cache;
+    VertexLayout layout{};
+
+    std::vector<Submesh> submeshes;
+    const Submesh* submeshData = nullptr;
+    u32 submeshCount = 0;
+
+    std::vector<MeshLod> lods;
+    const MeshLod* lodData = nullptr;
+
+    MeshletData meshlets;
+    const Meshlet* meshletData = nullptr;
+
+    std::vector<Vertex> vertices;
+    const Vertex* vertexData = nullptr;
+    u32 vertexCount = 0;
+
+    std::vector<u32> indices;
+    const u32* indexData = nullptr;
+    u32 indexCount = 0;
+
+    // GLB models have no vertexData or indexData, they keep the file mapped and
+    // are packed from its buffer views straight into staging memory. Primitive
+    // i is submesh i; unindexed ones are welded on load and point into the
+    // welded vectors instead.
+    MappedFile source;
+    std::vector<GlbPrimitive> primitives;
+    std::vector<std::vector<Vertex>> weldedVertices;
+    std::vector<std::vector<u32>> weldedIndices;
+
+    // Streamed models are already packed in staging buffers from the
+    // StagingAllocator and only list the copies to make. Their meshlets keep
+    // the culling bounds but not the vertex and triangle lists.
+    std::vector<StagedRange> stagedRanges;
+
+    // Equal for loads that produce the same data, 0 when unknown as for
+    // streamed models and placeholders.
+    u64 contentHash = 0;
+} ModelAsset;
+
+// Image in its upload format with its mip levels back to back, largest first,
+// or at mipOffsets when there are any. pixelData points into the cooked
+// texture or KTX2 mapping or into pixels. Textures read straight into staging
+// memory have no pixelData; their levels start at offset 0 of stagingBuffer
+// from the StagingAllocator.
+typedef struct TextureAsset
+{
+    TextureCache cache;
+    Ktx2File ktx2;
+    VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+    u32 width = 0;
+    u32 height = 0;
+    u32 mipCount = 1;
+
+    // Layers of a texture array follow each other within every level.
+    u32 layerCount = 1;
+
+    std::vector<u8> pixels;
+    const u8* pixelData = nullptr;
+    size_t pixelSize = 0;
+    std::vector<u64> mipOffsets;
+
+    bool staged = false;
+    u32 stagingBuffer = 0;
+
+    u64 contentHash = 0;
+
+    // Spent reading and decoding by the async loads, without the time queued
+    // on the pool.
+    double loadMilliseconds = 0.0;
+} TextureAsset;
+
+// Result of a load running on the thread pool. The owner polls IsReady once
+// per frame and takes the asset when it is; errors thrown by the load are
+// rethrown from Take.
+template<typename Asset>
+class AssetHandle
+{
+public:
+    AssetHandle() = default;
+    explicit AssetHandle(std::future<std::unique_ptr<Asset>>&& future) : m_future(std::move(future)) {}
+
+    bool IsPending() const
+    {
+        return m_future.valid();
+    }
+
+    bool IsReady() const
+    {
+        return m_future.valid() && m_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    std::unique_ptr<Asset> Take()
+    {
+        return m_future.get();
+    }
+
+private:
+    std::future<std::unique_ptr<Asset>> m_future;
+};
+
+// Synchronous loads, these run on whichever thread calls them. A cooked file
+// next to the source is mapped instead of it when there is one and preferCooked
+// is set, hot reloads of an edited source clear it. Otherwise paths
+// ending in .glb are read as binary glTF, anything else as OBJ. OBJ files of at
+// least OBJ_STREAM_THRESHOLD bytes are streamed into staging memory when an
+// allocator is given, with a fixed layout and without the mesh cache or LODs.
+// Textures decoded from their source have a single level unless a mipPool is
+// given to build the chain on, for devices that can't blit it themselves. A
+// block-compressed format is only read from the KTX2 file the cooker wrote in
+// it; without one the texture loads as RGBA8 like any other. Single-level
+// textures decoded from their source are converted straight into staging
+// memory when an allocator is given.
+std::unique_ptr<ModelAsset> LoadModel(ThreadPool& pool, const char* path, const VertexPackingOptions& options,
+    const StagingAllocator& staging = StagingAllocator(), bool preferCooked = PREFER_COOKED_ASSETS);
+std::unique_ptr<TextureAsset> LoadTexture(const char* path, bool preferCooked = PREFER_COOKED_ASSETS, ThreadPool* mipPool = nullptr,
+    VkFormat format = VK_FORMAT_R8G8B8A8_SRGB, const StagingAllocator& staging = StagingAllocator());
+
+// The source conversions behind the loads above, shared with the cooker. The
+// model is welded, optimized and split into LODs and meshlets in its vectors,
+// without a vertex layout; the texture is a single RGBA8 sRGB level, staged
+// when there is an allocator.
+std::unique_ptr<ModelAsset> BuildObjModel(ThreadPool& pool, const char* path, const char* data, size_t size);
+std::unique_ptr<TextureAsset> DecodeTexture(const char* path, const char* data, size_t size,
+    const StagingAllocator& staging = StagingAllocator());
+
+// Reads only the image header.
+bool GetTextureSize(const char* data, size_t size, u32& width, u32& height);
+
+AssetHandle<ModelAsset> LoadModelAsync(ThreadPool& pool, const std::string& path, const VertexPackingOptions& options,
+    const StagingAllocator& staging = StagingAllocator(), bool preferCooked = PREFER_COOKED_ASSETS);
+AssetHandle<TextureAsset> LoadTextureAsync(ThreadPool& pool, const std::string& path, bool preferCooked = PREFER_COOKED_ASSETS,
+    bool buildMips = false, VkFormat format = VK_FORMAT_R8G8B8A8_SRGB, const StagingAllocator& staging = StagingAllocator());
+
+// Loose cooked RGBA8 textures are read through io with no thread waiting on
+// them: the header first, then the mip levels straight into staging memory.
+// Anything else, or a read that fails, is loaded on the pool as above.
+AssetHandle<TextureAsset> LoadTextureAsync(ThreadPool& pool, AsyncIo& io, const std::string& path,
+    const StagingAllocator& staging, bool preferCooked = PREFER_COOKED_ASSETS, bool buildMips = false,
+    VkFormat format = VK_FORMAT_R8G8B8A8_SRGB);
+
+// Write the model's vertices and indices in its layout, into GetPackedVertexSize
+// and GetPackedIndexSize bytes.
+void PackModelVertices(const ModelAsset& model, void* destination);
+void PackModelIndices(const ModelAsset& model, void* destination);
+
+// Tiny stand-ins drawn until the real assets are uploaded.
+std::unique_ptr<ModelAsset> MakePlaceholderModel(const VertexPackingOptions& options);
+std::unique_ptr<TextureAsset> MakePlaceholderTexture();
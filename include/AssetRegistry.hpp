@@ -0,0 +1,85 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <MyMath.hpp>
+
+// Live resources by the path they were loaded from and by a hash of their
+// content, so a second user of either gets the resource that is already there
+// instead of loading and uploading a copy. The registry only holds weak
+// references: handles are shared pointers whose deleter frees the resource
+// once the last user lets go, and the entry is dropped the next time the
+// registry changes. A content hash of 0 stands for unknown content, which is
+// never shared.
+template<typename Resource>
+class AssetRegistry
+{
+public:
+    typedef std::shared_ptr<Resource> Handle;
+
+    // The resource loaded from path, whatever its content.
+    Handle Find(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto entry = m_paths.find(path);
+        return entry != m_paths.end() ? entry->second.resource.lock() : nullptr;
+    }
+
+    // The resource with this content, preferably the one loaded from path. An
+    // edited file hashes differently and misses its own old entry.
+    Handle Find(const std::string& path, u64 contentHash)
+    {
+        if (contentHash == 0)
+            return nullptr;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto entry = m_paths.find(path);
+        if (entry != m_paths.end() && entry->second.contentHash == contentHash)
+            if (Handle resource = entry->second.resource.lock())
+                return resource;
+
+        auto content = m_contents.find(contentHash);
+        return content != m_contents.end() ? content->second.lock() : nullptr;
+    }
+
+    // Makes resource the one for path, and for its content unless another
+    // live resource already has it.
+    void Insert(const std::string& path, u64 contentHash, const Handle& resource)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        prune();
+
+        m_paths[path] = { contentHash, resource };
+        if (contentHash != 0 && !m_contents.count(contentHash))
+            m_contents[contentHash] = resource;
+    }
+
+    u32 GetSize()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        prune();
+        return static_cast<u32>(m_paths.size());
+    }
+
+private:
+    typedef struct Entry
+    {
+        u64 contentHash;
+        std::weak_ptr<Resource> resource;
+    } Entry;
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, Entry> m_paths;
+    std::unordered_map<u64, std::weak_ptr<Resource>> m_contents;
+
+    void prune()
+    {
+        for (auto entry = m_paths.begin(); entry != m_paths.end();)
+            entry = entry->second.resource.expired() ? m_paths.erase(entry) : std::next(entry);
+        for (auto entry = m_contents.begin(); entry != m_contents.end();)
+            entry = entry->second.expired() ? m_contents.erase(entry) : std::next(entry);
+    }
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <MyMath.hpp>
+#include <ThreadPool.hpp>
+
+#define ASYNC_IO_QUEUE_DEPTH 256
+#define ASYNC_IO_MAX_READ_SIZE (1ull << 20)
+#define ASYNC_IO_MAX_BUFFERS 64
+
+// Called once every byte of a read arrived, or with false when the file could
+// not be opened or ended early.
+typedef std::function<void(bool success)> ReadCallback;
+
+struct IoUring;
+struct AsyncRead;
+
+// Positional reads of loose files straight into caller memory. On Linux one
+// thread keeps up to queueDepth pieces of at most ASYNC_IO_MAX_READ_SIZE bytes
+// in flight on an io_uring and runs the callbacks as they complete. Elsewhere,
+// or when the kernel has no io_uring, the pieces are blocking reads on the
+// pool and the callbacks run on whichever worker finishes last.
+class AsyncIo
+{
+public:
+    AsyncIo() = default;
+    ~AsyncIo();
+
+    AsyncIo(const AsyncIo&) = delete;
+    AsyncIo& operator=(const AsyncIo&) = delete;
+
+    void Create(ThreadPool& pool, u32 queueDepth = ASYNC_IO_QUEUE_DEPTH);
+
+    // Waits for every read, including ones issued from callbacks meanwhile.
+    void Destroy();
+
+    bool IsUringBacked() const;
+
+    // Memory that reads will land in, such as mapped staging buffers. The ring
+    // pins it once instead of on every read into it. Returns false when it
+    // can't, reads into the memory work either way. Unregister before freeing.
+    bool RegisterBuffer(void* data, size_t size);
+    void UnregisterBuffer(void* data);
+
+    // Callbacks may issue further reads but must not throw.
+    void Read(const std::string& path, u64 offset, size_t size, void* destination, ReadCallback done);
+
+private:
+    typedef struct ReadPiece
+    {
+        AsyncRead* read;
+        u64 offset;
+        size_t size;
+        char* destination;
+    } ReadPiece;
+
+    typedef struct RegisteredBuffer
+    {
+        char* data;
+        size_t size;
+    } RegisteredBuffer;
+
+    ThreadPool* m_pool = nullptr;
+    IoUring* m_ring = nullptr;
+    std::thread m_thread;
+
+    std::mutex m_mutex;
+    std::condition_variable m_idle;
+    std::deque<ReadPiece> m_pending;
+    u32 m_outstanding = 0;
+    bool m_stopping = false;
+
+    std::mutex m_buffersMutex;
+    std::vector<RegisteredBuffer> m_buffers;
+
+    bool createRing(u32 queueDepth);
+    void destroyRing();
+    void ringLoop();
+    void submitPiece(const ReadPiece& piece);
+    void finishPiece(AsyncRead* read, bool success);
+    void readPiece(const ReadPiece& piece);
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include <MyMath.hpp>
+#include <ThreadPool.hpp>
+
+#define BLOCK_ROWS_PER_JOB 8
+
+// Bytes per 4x4 block of the block-compressed formats this can encode, BC1
+// without alpha, BC3 and BC7. 0 for any other format.
+u32 GetBlockSize(VkFormat format);
+
+// Short lowercase name of an encodable format, as used in file names and on
+// the cooker's command line, nullptr for any other format.
+const char* GetBlockFormatName(VkFormat format);
+VkFormat GetBlockFormat(const char* name);
+
+// Encodes an RGBA8 sRGB image into rows of 4x4 blocks, BLOCK_ROWS_PER_JOB rows
+// of them per job on the pool. Blocks over the right or bottom edge repeat the
+// last column or row. Errors are measured on the stored sRGB values. BC7 uses
+// its single subset RGBA mode only, which is fast and handles soft gradients
+// well but is less precise on blocks with several distinct colors.
+void CompressImage(ThreadPool& pool, VkFormat format, const u8* pixels, u32 width, u32 height, u8* blocks);
+
+// Every level of a chain laid out as BuildMipChain writes it, into the same
+// layout with each level block-compressed.
+void CompressMipChain(ThreadPool& pool, VkFormat format, const u8* chain, u32 width, u32 height, u32 mipCount,
+    std::vector<u8>& blocks);
@@ -1,9 +1,40 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
+
+#include <array>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
 #include <MyMath.hpp>
+#include <AssetArchive.hpp>
+#include <AssetLoader.hpp>
+#include <AssetRegistry.hpp>
+#include <AsyncIo.hpp>
+#include <FileWatcher.hpp>
+#include <HostImageCopy.hpp>
+#include <TexturePacker.hpp>
+#include <TextureScheduler.hpp>
+#include <TextureStreamer.hpp>
+#include <ThreadPool.hpp>
+#include <VirtualTexture.hpp>
 
 #define MAX_FRAMES_IN_FLIGHT 2
+#define LOD_PIXEL_ERROR 1.0f
+#define CULL_MESHLETS true
+#define ASSET_ARCHIVE_PATH "data.pack"
+#define MODEL_ASSET_PATH "data/potatOS.obj"
+#define TEXTURE_ASSET_PATH "data/potatOS.png"
+
+// Texture of each material of the model by index, the last one for any past
+// the end. More than one are packed into a single texture array.
+#define MATERIAL_TEXTURE_PATHS { TEXTURE_ASSET_PATH }
+#define PACKED_TEXTURES_NAME "packed material textures"
+#define HOT_RELOAD_ASSETS true
+#define VIRTUAL_TEXTURING true
+#define HOST_IMAGE_COPY true
+#define STREAM_TEXTURE_MIPS true
 
 class Window;
 
@@ -20,6 +51,9 @@ public:
     VkDevice GetLogicalDevice();
 
 private:
+    ThreadPool m_threadPool;
+    AsyncIo m_io;
+
     // Instance
     VkInstance m_instance;
     VkApplicationInfo m_appInfo{};
@@ -31,11 +65,18 @@ private:
     VkDevice m_logicalDevice;
     const std::vector<const char*> m_deviceExtensions = { "VK_KHR_swapchain" };
 
-    bool isPhysicalDeviceSuitable(VkPhysicalDevice device);
+    // Queue
+    typedef struct QueueFamilyIndices
+    {
+        u32 graphicsFamily;
+        u32 presentFamily;
+    } QueueFamilyIndices;
+
+    bool isPhysicalDeviceSuitable(VkPhysicalDevice device, QueueFamilyIndices& queueFamilies);
+    void querySurfaceSupport();
     void pickPhysicalDevice();
     void createLogicalDevice();
 
-    // Queue
     u32 m_graphicsFamily;
     VkQueue m_graphicsQueue;
     u32 m_presentFamily;
@@ -51,22 +92,187 @@ private:
     VkDeviceMemory m_depthImageMemory;
     VkImageView m_depthImageView;
 
+    // Asset loading
+    typedef struct StagingBuffer
+    {
+        VkBuffer buffer;
+        VkDeviceMemory memory;
+        void* data;
+    } StagingBuffer;
+
+    // Everything an upload replaced or used up, destroyed once the device has
+    // finished frame number frame.
+    typedef struct RetiredResources
+    {
+        u64 frame;
+        std::vector<StagingBuffer> stagingBuffers;
+        std::vector<VkBuffer> buffers;
+        std::vector<VkDeviceMemory> memory;
+        std::vector<VkImage> images;
+        std::vector<VkImageView> imageViews;
+        std::vector<VkPipeline> pipelines;
+        std::vector<VkPipelineLayout> pipelineLayouts;
+        std::vector<VkCommandBuffer> commandBuffers;
+    } RetiredResources;
+
+    typedef struct AssetReload
+    {
+        bool queued;
+        bool preferCooked;
+    } AssetReload;
+
+    // Device copies of loaded assets. They are shared through the registries
+    // and retired by their deleters once the last user lets go.
+    typedef struct ModelResource
+    {
+        std::unique_ptr<ModelAsset> asset;
+        VkBuffer vertexBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
+        VkBuffer indexBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
+    } ModelResource;
+
+    typedef struct TextureResource
+    {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+        VkImageView imageView = VK_NULL_HANDLE;
+        u32 mipLevels = 1;
+
+        // Streamed textures keep their pixels to upload finer levels from.
+        // The image holds the levels from firstLevel on and the view samples
+        // the ones from residentLevel on.
+        std::unique_ptr<TextureAsset> asset;
+        u32 streamed = TEXTURE_STREAMING_NONE;
+        u32 firstLevel = 0;
+        u32 residentLevel = 0;
+    } TextureResource;
+
+    AssetHandle<ModelAsset> m_modelHandle;
+    TextureScheduler m_textureLoads;
+    std::vector<StagingBuffer> m_stagingBuffers;
+    std::deque<RetiredResources> m_retired;
+
+    AssetRegistry<ModelResource> m_models;
+    AssetRegistry<TextureResource> m_textures;
+
+    FileWatcher m_watcher;
+    AssetReload m_modelReload{};
+    std::vector<AssetReload> m_textureReloads;
+
+    // Staging buffers filled by streamed loads on the pool, by id.
+    std::unordered_map<u32, StagingBuffer> m_streamingStaging;
+    u32 m_nextStreamingStaging = 0;
+    std::mutex m_streamingStagingMutex;
+
+    void watchAssets();
+    void loadModel(bool preferCooked);
+    void loadTexture(u32 material, bool preferCooked);
+    void pollAssets();
+    void uploadAssets(const std::string& modelPath, std::unique_ptr<ModelAsset> model,
+        const std::string& texturePath, std::unique_ptr<TextureAsset> texture);
+    std::shared_ptr<ModelResource> createModelResource(VkCommandBuffer commandBuffer, std::unique_ptr<ModelAsset> model);
+    std::shared_ptr<TextureResource> createTextureResource(VkCommandBuffer commandBuffer, std::unique_ptr<TextureAsset> texture);
+    void* createStagingBuffer(VkDeviceSize size);
+    void* allocateStreamingStaging(size_t size, u32& buffer);
+    void copyStagedRanges(VkCommandBuffer commandBuffer, const ModelAsset& model, bool index, VkBuffer destination);
+    void destroyRetiredResources(u64 completedFrame);
+
     // Texturing
-    VkBuffer m_stagingBuffer;
-    VkDeviceMemory m_stagingBufferMemory;
-    VkImage m_textureImage;
-    VkDeviceMemory m_textureImageMemory;
-    VkImageView m_textureImageView;
     VkSampler m_textureSampler;
+    std::shared_ptr<TextureResource> m_texture;
+
+    // Every material samples its region of the one texture array, pushed
+    // before its draws. Several material textures are loaded without staging
+    // and kept, to be packed again on the pool when one of them is reloaded.
+    std::vector<std::string> m_materialTexturePaths = MATERIAL_TEXTURE_PATHS;
+    std::vector<std::shared_ptr<TextureAsset>> m_materialTextures;
+    AssetHandle<PackedTextures> m_packedTextures;
+    bool m_repackTextures = false;
+    std::vector<TextureRegion> m_materialRegions;
+
+    TextureRegion getMaterialRegion(u32 material);
+
+    // Textures without a mip chain get one blitted on the device when it can
+    // filter the format, or built on the pool while they load otherwise.
+    bool m_blitMips = false;
+
+    // Block-compressed format textures are loaded in when the cooker wrote
+    // one, the first of BC7, BC3 and BC1 the device samples.
+    VkFormat m_textureFormat = VK_FORMAT_R8G8B8A8_SRGB;
+
+    // Textures loaded onto the host are written straight into their image
+    // from the CPU when the device can copy to the formats it samples, with
+    // no staging buffer or commands. Their chains are built on the pool then.
+    bool m_hostImageCopy = false;
+    PFN_vkCopyMemoryToImageEXT m_vkCopyMemoryToImage = nullptr;
+    PFN_vkTransitionImageLayoutEXT m_vkTransitionImageLayout = nullptr;
+
+    bool supportsHostImageCopy(VkPhysicalDevice device);
+    bool supportsHostImageCopy(VkFormat format);
+    void copyMemoryToImage(const TextureAsset& texture, VkImage image);
+
+    // Textures larger than their tail of small levels are streamed in level
+    // by level after it, as far as their coverage of the screen asks for and
+    // TEXTURE_MEMORY_BUDGET allows. Their pixels stay on the host.
+    TextureStreamer m_textureStreamer;
+    std::unordered_map<u32, TextureResource*> m_streamedTextures;
+
+    void requestTextureLevels();
+    void streamTextures();
+    void updateStreamedTexture(VkCommandBuffer commandBuffer, TextureResource& resource, u32 firstLevel, u32 residentLevel);
+
+    // Virtual texturing, used instead of the texture when the cooker tiled it.
+    // A low resolution pass before the frame writes the page every pixel
+    // samples, which is read back once the frame has finished. Pages stream
+    // into upload slots of one mapped buffer and are copied from there into
+    // the cache at the start of a frame, along with the page table when it
+    // changed. Each frame slot has its own page table staging and feedback.
+    bool m_virtualTexturing = false;
+    VirtualTexture m_virtualTexture;
+
+    VkImage m_pageTableImage;
+    VkDeviceMemory m_pageTableMemory;
+    VkImageView m_pageTableView;
+    VkSampler m_pageTableSampler;
+    VkImage m_pageCacheImage;
+    VkDeviceMemory m_pageCacheMemory;
+    VkImageView m_pageCacheView;
+    VkSampler m_pageCacheSampler;
+
+    StagingBuffer m_virtualUploads{};
+    std::vector<VirtualPageUpload> m_pageUploads;
+    bool m_pageTableStale = false;
+
+    VkRenderPass m_feedbackRenderPass;
+    VkPipeline m_feedbackPipeline = VK_NULL_HANDLE;
+    VkExtent2D m_feedbackExtent{};
+    VkImage m_feedbackDepthImage;
+    VkDeviceMemory m_feedbackDepthImageMemory;
+    VkImageView m_feedbackDepthImageView;
+    std::array<VkImage, MAX_FRAMES_IN_FLIGHT> m_feedbackImages{};
+    std::array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> m_feedbackImagesMemory{};
+    std::array<VkImageView, MAX_FRAMES_IN_FLIGHT> m_feedbackImageViews{};
+    std::array<VkFramebuffer, MAX_FRAMES_IN_FLIGHT> m_feedbackFramebuffers{};
+    std::array<StagingBuffer, MAX_FRAMES_IN_FLIGHT> m_feedbackReadbacks{};
+
+    void createVirtualTexture();
+    void destroyVirtualTexture();
+    void createFeedbackRenderPass();
+    void createFeedbackResources();
+    void destroyFeedbackResources();
+    void updateVirtualTexture();
+    void recordPageUploads(VkCommandBuffer commandBuffer);
+    void recordFeedbackPass(VkCommandBuffer commandBuffer);
+    VkDeviceSize getPageTableStagingOffset(u32 frame);
 
     // Model Buffers
-    std::vector<Vertex> m_vertices;
-    VkBuffer m_vertexBuffer;
-    VkDeviceMemory m_vertexBufferMemory;
+    std::shared_ptr<ModelResource> m_model;
+
+    std::vector<VkDrawIndexedIndirectCommand> m_meshletDraws;
+    MeshletCullStats m_meshletCullStats{};
 
-    std::vector<u32> m_indices;
-    VkBuffer m_indexBuffer;
-    VkDeviceMemory m_indexBufferMemory;
+    UniformBufferObject m_ubo{};
 
     std::vector<VkBuffer> m_uniformBuffers;
     std::vector<VkDeviceMemory> m_uniformBuffersMemory;
@@ -78,8 +284,8 @@ private:
         VkBuffer& buffer, 
         VkDeviceMemory& bufferMemory);
 
-    void createVertexBuffer();
-    void createIndexBuffer();
+    void createVertexBuffer(VkCommandBuffer commandBuffer, ModelResource& model);
+    void createIndexBuffer(VkCommandBuffer commandBuffer, ModelResource& model);
     void createUniformBuffers();
 
     // Swap Chain
@@ -99,15 +305,15 @@ private:
 
     // Graphics pipeline
     VkRenderPass m_renderPass;
-    VkPipeline m_graphicsPipeline;
+    VkPipeline m_graphicsPipeline = VK_NULL_HANDLE;
     VkDescriptorSetLayout m_descriptorSetLayout;
     VkDescriptorPool m_descriptorPool;
     std::vector<VkDescriptorSet> m_descriptorSets;
-    VkPipelineLayout m_pipelineLayout;
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
 
     void createImageViews();
     void createRenderPass();
-    VkShaderModule createShaderModule(const std::vector<char>& code);
+    VkShaderModule createShaderModule(FileSpan code);
     void createDescriptorSetLayout();
     void createGraphicsPipeline();
     VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
@@ -115,10 +321,17 @@ private:
     void createCommandPool();
     void createDepthResources();
     void recordCommandBuffer(VkCommandBuffer commandBuffer, u32 imageIndex);
+    u32 selectLod(const Submesh& submesh, const glm::mat4& objectToView, const glm::mat4& proj);
     u32 findMemoryType(u32 typeFilter, VkMemoryPropertyFlags properties);
 
     // Drawing
     u32 m_currentFrame = 0, m_imageIndex = 0;
+
+    // Frames are numbered from 1 in submission order, each slot remembers the
+    // last one it submitted.
+    u64 m_submittedFrames = 0;
+    u64 m_completedFrames = 0;
+    std::array<u64, MAX_FRAMES_IN_FLIGHT> m_slotFrames{};
     
     void createFramebuffers();
 
@@ -128,29 +341,40 @@ private:
     void createCommandBuffers();
     VkCommandBuffer beginSingleTimeCommands();
     void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+    void copyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 
-    void loadModel(const char* path);
-    void createImage(u32 width, u32 height, VkFormat format,
+    VertexPackingOptions getVertexPackingOptions();
+    void createImage(u32 width, u32 height, u32 mipLevels, VkFormat format,
         VkImageTiling tiling, VkImageUsageFlags usage,
         VkMemoryPropertyFlags properties, VkImage& image,
-        VkDeviceMemory& imageMemory);
-    void createTextureImage(const char* path);
-    VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
-    void createTextureImageView();
+        VkDeviceMemory& imageMemory, u32 arrayLayers = 1);
+    void createTextureImage(VkCommandBuffer commandBuffer, const TextureAsset& texture, TextureResource& resource);
+    VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, u32 mipLevels,
+        VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D, u32 layerCount = 1, u32 baseMipLevel = 0);
     void createTextureSampler();
-    void copyBufferToImage(VkBuffer buffer, VkImage image, u32 width, u32 height);
+    void copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image,
+        VkFormat format, u32 width, u32 height, u32 mipLevels, const u64* mipOffsets = nullptr, u32 layerCount = 1);
+    bool supportsLinearBlit(VkFormat format);
+    void generateMipmaps(VkCommandBuffer commandBuffer, VkImage image, u32 width, u32 height, u32 mipLevels);
 
     void createDescriptorPool();
     void createDescriptorSets();
+    void updateDescriptorSet(u32 frame);
+
+    // Slots whose descriptor set still points at a replaced texture, each is
+    // rewritten once its own previous frame has finished.
+    u32 m_staleDescriptorSets = 0;
 
     std::vector<VkSemaphore> m_imageAvailableSemaphores;
     std::vector<VkSemaphore> m_renderFinishedSemaphores;
     std::vector<VkFence> m_inFlightFences;
     
     void createSyncObjects();
-    void transitionImageLayout(VkImage image, 
+    void transitionImageLayout(VkCommandBuffer commandBuffer,
+        VkImage image,
         VkFormat format,
         VkImageLayout oldLayout,
-        VkImageLayout newLayout);
+        VkImageLayout newLayout,
+        u32 mipLevels,
+        u32 baseMipLevel = 0);
 };
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <MyMath.hpp>
+
+#define FILE_WATCHER_POLL_INTERVAL_MS 500
+
+// Reports writes to a set of files without blocking. On Linux their
+// directories are watched with inotify, so files replaced through a rename
+// are caught as well; elsewhere, or without inotify, the write times and sizes
+// are compared every FILE_WATCHER_POLL_INTERVAL_MS.
+class FileWatcher
+{
+public:
+    FileWatcher() = default;
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    void Create();
+    void Destroy();
+
+    // The file doesn't have to exist yet, its directory does for inotify.
+    void Watch(const std::string& path);
+
+    // Appends the watched paths, as given to Watch, that were written since the
+    // last call, each once.
+    void Poll(std::vector<std::string>& changed);
+
+private:
+    typedef struct FileState
+    {
+        std::filesystem::file_time_type writeTime;
+        u64 size;
+        bool exists;
+    } FileState;
+
+    // By absolute path, with every spelling that was given to Watch.
+    std::unordered_map<std::string, std::vector<std::string>> m_paths;
+    std::unordered_map<std::string, FileState> m_states;
+    std::chrono::steady_clock::time_point m_lastPoll;
+
+    int m_inotify = -1;
+    std::unordered_map<int, std::string> m_directories;
+
+    static FileState getState(const std::string& path);
+    void pollStates(std::vector<std::string>& changed);
+    void readEvents(std::vector<std::string>& changed);
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <MyMath.hpp>
+
+#define GLB_COMPONENT_BYTE 5120
+#define GLB_COMPONENT_UNSIGNED_BYTE 5121
+#define GLB_COMPONENT_SHORT 5122
+#define GLB_COMPONENT_UNSIGNED_SHORT 5123
+#define GLB_COMPONENT_UNSIGNED_INT 5125
+#define GLB_COMPONENT_FLOAT 5126
+
+// Strided view of one accessor. data points into the BIN chunk of the mapped
+// file, or is null when the primitive lacks the attribute.
+typedef struct GlbAccessor
+{
+    const u8* data;
+    u32 count;
+    u32 stride;
+    u32 componentType;
+    u32 componentCount;
+    bool normalized;
+    bool hasBounds;
+    glm::vec3 minimum;
+    glm::vec3 maximum;
+} GlbAccessor;
+
+typedef struct GlbPrimitive
+{
+    u32 mesh;
+    u32 material;
+    GlbAccessor position;
+    GlbAccessor color;
+    GlbAccessor texCoord;
+    GlbAccessor indices;
+} GlbPrimitive;
+
+// Triangle primitives of every mesh in a binary glTF 2.0 file. Mesh names and
+// material names are indexed by GlbPrimitive::mesh and material, the last
+// material is the unnamed default for primitives without one.
+typedef struct GlbData
+{
+    std::vector<std::string> meshes;
+    std::vector<std::string> materials;
+    std::vector<GlbPrimitive> primitives;
+} GlbData;
+
+// The data must stay mapped for as long as the accessors are used. Node
+// transforms are not applied, each mesh stays in its own space.
+void ParseGlb(const char* data, size_t size, GlbData& glb);
+
+// Vertex i of the primitive with attributes converted to floats, missing
+// colors are white and missing texture coordinates zero.
+Vertex FetchGlbVertex(const GlbPrimitive& primitive, u32 index);
+u32 FetchGlbIndex(const GlbAccessor& indices, u32 index);
+
+// Writes the indices in the given type. Tightly packed indices already in that
+// type are copied as one block.
+void CopyGlbIndices(const GlbAccessor& indices, VkIndexType indexType, void* destination);
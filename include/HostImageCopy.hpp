@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// VK_EXT_host_image_copy, for Vulkan headers older than it. Only what the
+// texture uploads use is declared, matching the registry.
+#ifndef VK_EXT_host_image_copy
+#define VK_EXT_host_image_copy 1
+#define VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME "VK_EXT_host_image_copy"
+
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT static_cast<VkStructureType>(1000270000)
+#define VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES_EXT static_cast<VkStructureType>(1000270001)
+#define VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT static_cast<VkStructureType>(1000270002)
+#define VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT static_cast<VkStructureType>(1000270005)
+#define VK_STRUCTURE_TYPE_HOST_IMAGE_LAYOUT_TRANSITION_INFO_EXT static_cast<VkStructureType>(1000270006)
+
+#define VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT 0x00400000
+#define VK_FORMAT_FEATURE_2_HOST_IMAGE_TRANSFER_BIT_EXT 0x400000000000ULL
+
+typedef VkFlags VkHostImageCopyFlagsEXT;
+
+typedef struct VkPhysicalDeviceHostImageCopyFeaturesEXT
+{
+    VkStructureType sType;
+    void* pNext;
+    VkBool32 hostImageCopy;
+} VkPhysicalDeviceHostImageCopyFeaturesEXT;
+
+typedef struct VkPhysicalDeviceHostImageCopyPropertiesEXT
+{
+    VkStructureType sType;
+    void* pNext;
+    uint32_t copySrcLayoutCount;
+    VkImageLayout* pCopySrcLayouts;
+    uint32_t copyDstLayoutCount;
+    VkImageLayout* pCopyDstLayouts;
+    uint8_t optimalTilingLayoutUUID[VK_UUID_SIZE];
+    VkBool32 identicalMemoryTypeRequirements;
+} VkPhysicalDeviceHostImageCopyPropertiesEXT;
+
+typedef struct VkMemoryToImageCopyEXT
+{
+    VkStructureType sType;
+    const void* pNext;
+    const void* pHostPointer;
+    uint32_t memoryRowLength;
+    uint32_t memoryImageHeight;
+    VkImageSubresourceLayers imageSubresource;
+    VkOffset3D imageOffset;
+    VkExtent3D imageExtent;
+} VkMemoryToImageCopyEXT;
+
+typedef struct VkCopyMemoryToImageInfoEXT
+{
+    VkStructureType sType;
+    const void* pNext;
+    VkHostImageCopyFlagsEXT flags;
+    VkImage dstImage;
+    VkImageLayout dstImageLayout;
+    uint32_t regionCount;
+    const VkMemoryToImageCopyEXT* pRegions;
+} VkCopyMemoryToImageInfoEXT;
+
+typedef struct VkHostImageLayoutTransitionInfoEXT
+{
+    VkStructureType sType;
+    const void* pNext;
+    VkImage image;
+    VkImageLayout oldLayout;
+    VkImageLayout newLayout;
+    VkImageSubresourceRange subresourceRange;
+} VkHostImageLayoutTransitionInfoEXT;
+
+typedef VkResult (VKAPI_PTR *PFN_vkCopyMemoryToImageEXT)(VkDevice device, const VkCopyMemoryToImageInfoEXT* pCopyMemoryToImageInfo);
+typedef VkResult (VKAPI_PTR *PFN_vkTransitionImageLayoutEXT)(VkDevice device, uint32_t transitionCount,
+    const VkHostImageLayoutTransitionInfoEXT* pTransitions);
+#endif
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+
+#include <MyMath.hpp>
+#include <AssetDependencies.hpp>
+#include <MappedFile.hpp>
+
+#define KTX2_EXTENSION ".ktx2"
+#define KTX2_DEPENDENCIES_KEY "VulkanTemplate.dependencies"
+
+typedef struct Ktx2Header
+{
+    u8 identifier[12];
+    u32 vkFormat;
+    u32 typeSize;
+    u32 pixelWidth;
+    u32 pixelHeight;
+    u32 pixelDepth;
+    u32 layerCount;
+    u32 faceCount;
+    u32 levelCount;
+    u32 supercompressionScheme;
+    u32 dfdByteOffset;
+    u32 dfdByteLength;
+    u32 kvdByteOffset;
+    u32 kvdByteLength;
+    u64 sgdByteOffset;
+    u64 sgdByteLength;
+} Ktx2Header;
+
+typedef struct Ktx2Level
+{
+    u64 byteOffset;
+    u64 byteLength;
+    u64 uncompressedByteLength;
+} Ktx2Level;
+
+// Block-compressed textures written by the cooker as
+// "<source>.<format>.ktx2", one per format it was asked for.
+static inline std::string GetKtx2Path(const char* sourcePath, const char* formatName)
+{
+    return std::string(sourcePath) + "." + formatName + KTX2_EXTENSION;
+}
+
+// Single 2D image in a KTX2 container, with a full or partial mip chain and
+// no supercompression, in any format TextureCache::GetMipSize knows. The
+// levels are stored smallest first, so they are read as one span from the
+// smallest up with each level at its own offset into it. The cooker records
+// its dependencies under KTX2_DEPENDENCIES_KEY; files from other tools open
+// with none.
+class Ktx2File
+{
+public:
+    Ktx2File() = default;
+
+    // data holds the levels back to back, largest first.
+    static bool Write(const std::string& path, const AssetDependencies& dependencies,
+        VkFormat format, u32 width, u32 height, u32 mipCount, const u8* data, size_t size);
+
+    bool Open(const std::string& path);
+    void Close();
+
+    const AssetDependencies& GetDependencies() const;
+    VkFormat GetFormat() const;
+    u32 GetWidth() const;
+    u32 GetHeight() const;
+    u32 GetMipCount() const;
+    const u8* GetData() const;
+    size_t GetDataSize() const;
+    u64 GetMipOffset(u32 level) const;
+
+private:
+    MappedFile m_file;
+    const Ktx2Header* m_header = nullptr;
+    const Ktx2Level* m_levels = nullptr;
+    AssetDependencies m_dependencies{};
+    u64 m_dataOffset = 0;
+    u64 m_dataSize = 0;
+
+    void readDependencies();
+};
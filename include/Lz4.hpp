@@ -0,0 +1,13 @@
+#pragma once
+
+#include <MyMath.hpp>
+
+// LZ4 block format, without the frame around it. Offsets are 16 bit, so
+// blocks are meant to be at most 64 KiB.
+size_t Lz4CompressBound(size_t size);
+
+// Returns the compressed size, or 0 when it doesn't fit in capacity bytes.
+size_t Lz4Compress(const u8* source, size_t size, u8* destination, size_t capacity);
+
+// Fails on malformed input or when it doesn't decode to exactly size bytes.
+bool Lz4Decompress(const u8* source, size_t sourceSize, u8* destination, size_t size);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <MyMath.hpp>
+
+// Access hints for the pages of a mapping. Sequential reads ahead aggressively
+// and lets the system drop pages behind the reader, willneed starts paging the
+// range in right away.
+#define MAPPED_FILE_NORMAL 0x0
+#define MAPPED_FILE_SEQUENTIAL 0x1
+#define MAPPED_FILE_WILLNEED 0x2
+
+typedef struct FileSpan
+{
+    const char* data;
+    size_t size;
+} FileSpan;
+
+// Read only view of a whole file. Files in a mounted AssetArchive are served
+// from it instead, either pointing into the archive's mapping or decoded into
+// a buffer the view owns.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& path, u32 hints = MAPPED_FILE_NORMAL);
+    void Close();
+
+    // Hints for part of the file, and a way to give back pages that were read
+    // and won't be again. Both only affect residency, never the contents.
+    void Advise(size_t offset, size_t size, u32 hints) const;
+    void Discard(size_t offset, size_t size) const;
+
+    bool IsOpen() const;
+    const char* GetData() const;
+    size_t GetSize() const;
+    FileSpan GetSpan() const;
+
+private:
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+    bool m_open = false;
+    bool m_archived = false;
+    std::unique_ptr<char[]> m_buffer;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#else
+    int m_file = -1;
+#endif
+
+    bool openFile(const std::string& path, u32 hints);
+};
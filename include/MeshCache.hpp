@@ -0,0 +1,85 @@
+#pragma once
+
+#include <MyMath.hpp>
+#include <AssetDependencies.hpp>
+#include <MappedFile.hpp>
+#include <MeshletBuilder.hpp>
+#include <MeshSimplifier.hpp>
+
+#define MESH_CACHE_MAGIC 0x4853454D // "MESH"
+#define MESH_CACHE_VERSION 6
+
+#define MESH_CACHE_OPTIMIZED 0x1
+#define MESH_CACHE_LODS 0x2
+
+// One object/material pair of the source. Its vertices are a range of the
+// shared vertex buffer that its indices and meshlet vertices are relative to,
+// its LODs a range of the LOD table.
+typedef struct Submesh
+{
+    u32 firstLod;
+    u32 lodCount;
+    i32 vertexOffset;
+    u32 vertexCount;
+    u32 object;
+    u32 material;
+    BoundingSphere bounds;
+} Submesh;
+
+typedef struct MeshCacheHeader
+{
+    u32 magic;
+    u32 version;
+    u32 flags;
+    u32 lodCount;
+    u32 submeshCount;
+    u32 reserved;
+    AssetDependencies dependencies;
+    u64 vertexCount;
+    u64 indexCount;
+    u64 meshletCount;
+    u64 meshletVertexCount;
+    u64 meshletTriangleCount;
+} MeshCacheHeader;
+
+// Welded mesh stored next to its source as "<source>.meshcache", or as its
+// cooked file when written by the cooker. The submesh and LOD tables, meshlets, vertex and index arrays are read straight
+// out of the mapping, meshlet vertices and triangles come last. flags
+// record the processing the mesh went through, a cache built with other
+// flags is a miss, and so is one whose dependencies don't match the caller's.
+class MeshCache
+{
+public:
+    MeshCache() = default;
+
+    static u64 HashSource(const char* data, size_t size);
+    static std::string GetCachePath(const char* sourcePath);
+    static bool Write(const std::string& cachePath, const AssetDependencies& dependencies, u32 flags,
+        const Submesh* submeshes, size_t submeshCount,
+        const MeshLod* lods, size_t lodCount,
+        const MeshletData& meshlets,
+        const Vertex* vertices, size_t vertexCount,
+        const u32* indices, size_t indexCount);
+
+    bool Open(const std::string& cachePath, u32 flags);
+    void Close();
+
+    const AssetDependencies& GetDependencies() const;
+
+    const Submesh* GetSubmeshes() const;
+    u32 GetSubmeshCount() const;
+    const MeshLod* GetLods() const;
+    u32 GetLodCount() const;
+    const Meshlet* GetMeshlets() const;
+    u32 GetMeshletCount() const;
+    const Vertex* GetVertices() const;
+    u32 GetVertexCount() const;
+    const u32* GetIndices() const;
+    u32 GetIndexCount() const;
+    const u32* GetMeshletVertices() const;
+    const u8* GetMeshletTriangles() const;
+
+private:
+    MappedFile m_file;
+    const MeshCacheHeader* m_header = nullptr;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+#include <MyMath.hpp>
+
+#define VERTEX_CACHE_SIZE 16
+
+typedef struct VertexCacheStats
+{
+    float acmr; // Transformed vertices per triangle, 0.5 at best and 3 at worst
+    float atvr; // Transformed vertices per vertex, 1 at best
+} VertexCacheStats;
+
+// Simulates a FIFO post-transform cache of cacheSize entries.
+VertexCacheStats AnalyzeVertexCache(const u32* indices, size_t indexCount, size_t vertexCount, u32 cacheSize = VERTEX_CACHE_SIZE);
+
+// Tipsify (Sander et al. 2007) triangle reordering for post-transform cache
+// locality. clusters receives the first triangle of every run that started at
+// a dead end, which are the places reordering for overdraw can cut at cheaply.
+void OptimizeVertexCache(u32* indices, size_t indexCount, size_t vertexCount,
+    std::vector<u32>& clusters, u32 cacheSize = VERTEX_CACHE_SIZE);
+
+// Sorts the clusters so outward facing ones on the hull are drawn first,
+// which lets early depth testing reject more of the rest.
+void OptimizeOverdraw(u32* indices, size_t indexCount, const Vertex* vertices, const std::vector<u32>& clusters);
+
+// Reorders vertices by first use so fetches walk the buffer linearly, dropping
+// unreferenced ones. Returns the new vertex count.
+size_t OptimizeVertexFetch(Vertex* vertices, size_t vertexCount, u32* indices, size_t indexCount);
+
+// Runs the three passes above in order.
+void OptimizeMesh(std::vector<Vertex>& vertices, std::vector<u32>& indices);
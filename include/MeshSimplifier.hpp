@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#include <MyMath.hpp>
+
+#define MAX_MESH_LODS 8
+
+typedef struct MeshLod
+{
+    u32 firstIndex;
+    u32 indexCount;
+    u32 firstMeshlet;
+    u32 meshletCount;
+    float error; // Object space distance to the full detail surface
+} MeshLod;
+
+typedef struct BoundingSphere
+{
+    glm::vec3 center;
+    float radius;
+} BoundingSphere;
+
+// Quadric error edge collapse (Garland & Heckbert) down to about targetIndexCount
+// indices. Vertices are only moved onto their neighbours, so the result indexes
+// the same vertex array. Vertices on a border or UV seam only collapse along
+// it, onto one of their two neighbours on it, so outlines and UV islands keep
+// their shape; corners and junctions of several seams don't move at all.
+// Returns the error of the simplified mesh.
+float SimplifyMesh(const Vertex* vertices, size_t vertexCount,
+    const u32* indices, size_t indexCount,
+    size_t targetIndexCount, std::vector<u32>& result);
+
+// Appends coarser and coarser levels after the full detail indices, halving the
+// triangle count each time, and describes every level in lods.
+void BuildLodChain(const std::vector<Vertex>& vertices, std::vector<u32>& indices, std::vector<MeshLod>& lods);
+
+BoundingSphere ComputeBoundingSphere(const Vertex* vertices, size_t vertexCount);
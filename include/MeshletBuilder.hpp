@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include <MyMath.hpp>
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+typedef struct Meshlet
+{
+    glm::vec3 center;
+    float radius;
+    glm::vec3 coneAxis;
+    float coneCutoff; // Sine of the cone half angle, 1 when the cone never culls
+    u32 vertexOffset;
+    u32 triangleOffset; // Also the first index of the meshlet in the index buffer
+    u32 vertexCount;
+    u32 triangleCount;
+} Meshlet;
+
+// Meshlet triangles use 8 bit indices into the meshlet's slice of vertices,
+// which holds indices into the vertex buffer. triangles runs parallel to the
+// index buffer the meshlets were built from.
+typedef struct MeshletData
+{
+    std::vector<Meshlet> meshlets;
+    std::vector<u32> vertices;
+    std::vector<u8> triangles;
+} MeshletData;
+
+typedef struct MeshletCullStats
+{
+    u32 visibleMeshlets;
+    u32 visibleTriangles;
+    u32 frustumCulledTriangles;
+    u32 coneCulledTriangles;
+} MeshletCullStats;
+
+// Splits indices into meshlets of at most MESHLET_MAX_VERTICES vertices and
+// MESHLET_MAX_TRIANGLES triangles, appending to meshlets, and reorders the
+// triangles of indices to match. The first index of indices must be at
+// meshlets.triangles.size() in the index buffer.
+void BuildMeshlets(const Vertex* vertices, size_t vertexCount, u32* indices, size_t indexCount, MeshletData& meshlets);
+
+// Frustum and backface cone culling in object space. Visible meshlets with
+// contiguous index ranges are merged into a single draw.
+MeshletCullStats CullMeshlets(const Meshlet* meshlets, u32 meshletCount,
+    const glm::mat4& objectToClip, const glm::vec3& cameraPosition,
+    std::vector<VkDrawIndexedIndirectCommand>& draws);
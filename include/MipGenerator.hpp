@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+
+#include <MyMath.hpp>
+#include <ThreadPool.hpp>
+
+#define MIP_ROWS_PER_JOB 16
+
+// Levels in a full chain down to 1x1.
+u32 GetMipCount(u32 width, u32 height);
+
+// Writes mipCount levels of an RGBA8 sRGB image into chain, the base level
+// first and each next one half the size of the previous, rounded down. Every
+// texel averages the box of source texels it covers, in linear space. Rows of
+// a level are filtered on the pool, MIP_ROWS_PER_JOB at a time, and levels are
+// built from the previous one's linear values so only the written texels are
+// rounded.
+void BuildMipChain(ThreadPool& pool, const u8* pixels, u32 width, u32 height, u32 mipCount, std::vector<u8>& chain);
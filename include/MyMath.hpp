@@ -9,6 +9,36 @@
 #include <array>
 #include <cstdint>
 typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int64_t i64;
+typedef int32_t i32;
+typedef uint16_t u16;
+typedef uint8_t u8;
+
+// How a mesh's vertices are laid out in its vertex buffer, see VertexPacking.hpp.
+// A constant color is not stored per vertex but read from a second binding
+// with a zero stride.
+typedef struct VertexLayout
+{
+    VkFormat positionFormat;
+    VkFormat colorFormat;
+    VkFormat texCoordFormat;
+    u32 positionOffset;
+    u32 colorOffset;
+    u32 texCoordOffset;
+    u32 stride;
+    bool constantColor;
+
+    // Quantized positions are dequantized as offset + scale * position.
+    glm::vec3 dequantizeOffset;
+    glm::vec3 dequantizeScale;
+
+    VkIndexType indexType;
+
+    // Largest error the packing introduced, in object space and UV units.
+    float positionError;
+    float texCoordError;
+} VertexLayout;
 
 typedef struct Vertex
 {
@@ -52,6 +82,42 @@ typedef struct Vertex
         
         return attributeDescriptions;
     }
+    
+    static std::array<VkVertexInputBindingDescription, 2> getBindingDescriptions(const VertexLayout& layout)
+    {
+        std::array<VkVertexInputBindingDescription, 2> bindingDescriptions{};
+        bindingDescriptions[0].binding = 0;
+        bindingDescriptions[0].stride = layout.stride;
+        bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        
+        bindingDescriptions[1].binding = 1;
+        bindingDescriptions[1].stride = 0;
+        bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        
+        return bindingDescriptions;
+    }
+    
+    static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions(const VertexLayout& layout)
+    {
+        std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+        
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = layout.positionFormat;
+        attributeDescriptions[0].offset = layout.positionOffset;
+        
+        attributeDescriptions[1].binding = layout.constantColor ? 1 : 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = layout.colorFormat;
+        attributeDescriptions[1].offset = layout.constantColor ? 0 : layout.colorOffset;
+        
+        attributeDescriptions[2].binding = 0;
+        attributeDescriptions[2].location = 2;
+        attributeDescriptions[2].format = layout.texCoordFormat;
+        attributeDescriptions[2].offset = layout.texCoordOffset;
+        
+        return attributeDescriptions;
+    }
 } Vertex;
 
 namespace std 
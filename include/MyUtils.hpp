@@ -1,21 +1,84 @@
 #pragma once
 
 #include <vector>
-#include <fstream>
+#include <cstring>
 
-static std::vector<char> readFile(const std::string& filename)
+#include <MyMath.hpp>
+#include <MappedFile.hpp>
+
+// Maps the whole file, or finds it in a mounted archive. The contents are read
+// straight from the mapping and stay valid for as long as file is open.
+static void readFile(MappedFile& file, const std::string& filename)
 {
-	std::ifstream file(filename, std::ios::ate | std::ios::binary);
-    
-	if (!file.is_open())
+	if (!file.Open(filename, MAPPED_FILE_WILLNEED))
 		throw std::runtime_error("Failed to open file");
-    
-	size_t fileSize = (size_t)file.tellg();
-    
-	std::vector<char> buffer(fileSize);
-	file.seekg(0);
-	file.read(buffer.data(), fileSize);
-	file.close();
-    
-	return buffer;
+}
+
+static inline u64 rotl64(u64 x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+// XXH64, used to key caches on file contents and to hash vertices.
+static u64 Hash64(const void* input, size_t length, u64 seed = 0)
+{
+	const u64 prime1 = 0x9E3779B185EBCA87ULL;
+	const u64 prime2 = 0xC2B2AE3D27D4EB4FULL;
+	const u64 prime3 = 0x165667B19E3779F9ULL;
+	const u64 prime4 = 0x85EBCA77C2B2AE63ULL;
+	const u64 prime5 = 0x27D4EB2F165667C5ULL;
+
+	auto read64 = [](const unsigned char* p) { u64 v; memcpy(&v, p, sizeof(v)); return v; };
+	auto read32 = [](const unsigned char* p) { u32 v; memcpy(&v, p, sizeof(v)); return v; };
+	auto round = [&](u64 acc, u64 lane) { return rotl64(acc + lane * prime2, 31) * prime1; };
+	auto merge = [&](u64 acc, u64 v) { return (acc ^ round(0, v)) * prime1 + prime4; };
+
+	const unsigned char* p = static_cast<const unsigned char*>(input);
+	const unsigned char* end = p + length;
+	u64 h;
+
+	if (length >= 32)
+	{
+		u64 v1 = seed + prime1 + prime2;
+		u64 v2 = seed + prime2;
+		u64 v3 = seed;
+		u64 v4 = seed - prime1;
+
+		for (; p + 32 <= end; p += 32)
+		{
+			v1 = round(v1, read64(p));
+			v2 = round(v2, read64(p + 8));
+			v3 = round(v3, read64(p + 16));
+			v4 = round(v4, read64(p + 24));
+		}
+
+		h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+		h = merge(h, v1);
+		h = merge(h, v2);
+		h = merge(h, v3);
+		h = merge(h, v4);
+	}
+	else
+	{
+		h = seed + prime5;
+	}
+
+	h += static_cast<u64>(length);
+
+	for (; p + 8 <= end; p += 8)
+		h = rotl64(h ^ round(0, read64(p)), 27) * prime1 + prime4;
+	if (p + 4 <= end)
+	{
+		h = rotl64(h ^ (read32(p) * prime1), 23) * prime2 + prime3;
+		p += 4;
+	}
+	for (; p < end; p++)
+		h = rotl64(h ^ (*p * prime5), 11) * prime1;
+
+	h ^= h >> 33;
+	h *= prime2;
+	h ^= h >> 29;
+	h *= prime3;
+	h ^= h >> 32;
+	return h;
 }
\ No newline at end of file
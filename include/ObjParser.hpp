@@ -0,0 +1,70 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <MyMath.hpp>
+#include <ThreadPool.hpp>
+
+#define OBJ_NO_TEXCOORD 0xFFFFFFFF
+#define OBJ_STREAM_WINDOW_SIZE (4 * 1024 * 1024)
+#define OBJ_STREAM_BLOCK_VERTICES 0x10000
+
+typedef struct ObjCorner
+{
+    u32 position;
+    u32 texcoord;
+} ObjCorner;
+
+// The triangles of one object using one material.
+typedef struct ObjGroup
+{
+    u32 object;   // Into ObjData::objects
+    u32 material; // Into ObjData::materials
+    u32 firstCorner;
+    u32 cornerCount;
+} ObjGroup;
+
+typedef struct ObjData
+{
+    std::vector<float> positions;
+    std::vector<float> texcoords;
+    std::vector<ObjCorner> corners; // Three per triangle, contiguous per group
+
+    // Names from the o/g and usemtl records in first-use order. Faces before
+    // any of them go to an object or material with an empty name.
+    std::vector<std::string> objects;
+    std::vector<std::string> materials;
+    std::vector<ObjGroup> groups;
+} ObjData;
+
+// Parses the v/vt/f/o/g/usemtl records of an OBJ file on the pool. The text is
+// split in line aligned chunks whose results are merged back in file order, so
+// the output does not depend on the thread count. Polygons are triangulated the
+// way tinyobj does it: quads along their shortest diagonal, larger ones by ear
+// clipping. Triangles are then gathered per group, keeping file order within each.
+void ParseObj(ThreadPool& pool, const char* text, size_t size, ObjData& obj);
+
+// Expands the corners of a group into unique vertices, in first-seen order like
+// loadModel always did. Large groups are welded in parallel.
+void WeldObj(ThreadPool& pool, const ObjData& obj, const ObjGroup& group, std::vector<Vertex>& vertices, std::vector<u32>& indices);
+
+// Welded triangles of one object and material, from a streamed OBJ file.
+typedef struct ObjStreamBlock
+{
+    u32 object;
+    u32 material;
+    std::vector<Vertex> vertices;
+    std::vector<u32> indices;
+} ObjStreamBlock;
+
+// Maps the file and parses it OBJ_STREAM_WINDOW_SIZE bytes at a time, giving
+// each window's pages back once it is done, and hands the faces to emit in
+// file order in blocks of at most OBJ_STREAM_BLOCK_VERTICES vertices. Only the
+// v/vt records and the names are kept for the whole file, since faces may
+// refer back to any of them, so memory does not grow with the face count.
+// Vertices are welded within a block and repeated across blocks.
+// emit may modify the block, which is cleared afterwards.
+void StreamObj(const char* path, std::vector<std::string>& objects, std::vector<std::string>& materials,
+    const std::function<void(ObjStreamBlock&)>& emit);
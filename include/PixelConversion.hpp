@@ -0,0 +1,36 @@
+#pragma once
+
+#include <MyMath.hpp>
+
+// Instruction sets the conversions have paths for, each one needing the ones
+// before it. The best one the CPU has is used unless a lower one is set.
+#define PIXEL_CONVERSION_SCALAR 0
+#define PIXEL_CONVERSION_SSSE3 1
+#define PIXEL_CONVERSION_AVX2 2
+
+u32 GetSupportedPixelConversionLevel();
+u32 GetPixelConversionLevel();
+void SetPixelConversionLevel(u32 level);
+
+// Every path gives the same bytes. Conversions that keep the pixel size may
+// convert in place, the others need source and destination apart.
+void ExpandRgbToRgba(const u8* source, u8* destination, size_t pixelCount);
+void SwizzleRgbaToBgra(const u8* source, u8* destination, size_t pixelCount);
+
+// Multiplies the stored color by alpha, rounded to the nearest. sRGB textures
+// are premultiplied this way in their encoded values.
+void PremultiplyAlpha(const u8* source, u8* destination, size_t pixelCount);
+
+// Between RGBA8 sRGB and linear RGBA floats. Alpha is linear in both and
+// scaled to [0, 1]; encoding clamps to it first.
+void DecodeSrgb(const u8* source, float* destination, size_t pixelCount);
+void EncodeSrgb(const float* source, u8* destination, size_t pixelCount);
+
+// Linear value of every sRGB byte.
+const float* GetSrgbDecodeTable();
+
+#ifdef PIXEL_CONVERSION_BENCHMARK
+// Times every conversion at every level the CPU has on a copy of the pixels
+// and checks each path against the scalar one.
+void BenchmarkPixelConversion(const u8* pixels, size_t pixelCount);
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+
+#include <MyMath.hpp>
+#include <AssetDependencies.hpp>
+#include <MappedFile.hpp>
+
+#define TEXTURE_CACHE_MAGIC 0x52584554 // "TEXR"
+#define TEXTURE_CACHE_VERSION 1
+
+typedef struct TextureCacheHeader
+{
+    u32 magic;
+    u32 version;
+    u32 format;
+    u32 width;
+    u32 height;
+    u32 mipCount;
+    AssetDependencies dependencies;
+    u64 dataSize;
+} TextureCacheHeader;
+
+// Texture written by the cooker as "<source>.cooked", in the format it is
+// uploaded in. Its mip levels follow the header back to back, largest first,
+// and are copied straight out of the mapping.
+class TextureCache
+{
+public:
+    TextureCache() = default;
+
+    // Bytes in the given level, 0 for formats the cache can't hold.
+    static u64 GetMipSize(VkFormat format, u32 width, u32 height, u32 level);
+    static bool Write(const std::string& cachePath, const AssetDependencies& dependencies,
+        VkFormat format, u32 width, u32 height, u32 mipCount, const u8* data, size_t size);
+
+    // Checks everything but the file size, for headers read without mapping
+    // the file.
+    static bool IsValidHeader(const TextureCacheHeader& header);
+
+    bool Open(const std::string& cachePath);
+    void Close();
+
+    const AssetDependencies& GetDependencies() const;
+    VkFormat GetFormat() const;
+    u32 GetWidth() const;
+    u32 GetHeight() const;
+    u32 GetMipCount() const;
+    const u8* GetData() const;
+    size_t GetDataSize() const;
+
+private:
+    MappedFile m_file;
+    const TextureCacheHeader* m_header = nullptr;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <MyMath.hpp>
+#include <AssetLoader.hpp>
+#include <ThreadPool.hpp>
+
+// Texels of edge repeated around every atlased texture, so filtering and the
+// first few mip levels don't bleed into its neighbours.
+#define TEXTURE_ATLAS_PADDING 8
+
+// Where a packed texture ended up: its layer of the array and the rectangle of
+// the layer its UVs map to. Also the fragment shader's push constants.
+typedef struct TextureRegion
+{
+    float offset[2];
+    float scale[2];
+    u32 layer;
+} TextureRegion;
+
+typedef struct PackedTextures
+{
+    std::unique_ptr<TextureAsset> texture;
+    std::vector<TextureRegion> regions;
+} PackedTextures;
+
+// Packs textures into the layers of one texture array, regions[i] locating
+// textures[i]. Textures of the same size and format are stacked as they are,
+// block-compressed ones included. Otherwise every layer is as large as the
+// largest texture on each side, textures that fill one get a layer of their
+// own and smaller ones share atlas layers, packed on shelves by height. Those
+// need RGBA8 sRGB, their layers are filtered down to a full chain on the pool.
+// The array is laid out level by level, each with every layer in order.
+std::unique_ptr<PackedTextures> PackTextures(ThreadPool& pool, const std::vector<const TextureAsset*>& textures);
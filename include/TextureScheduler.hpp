@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <MyMath.hpp>
+#include <AssetLoader.hpp>
+#include <AsyncIo.hpp>
+#include <ThreadPool.hpp>
+
+// A texture load that finished, texture is null when it failed.
+typedef struct ScheduledTexture
+{
+    std::string path;
+    std::unique_ptr<TextureAsset> texture;
+
+    // Reading and decoding, then everything from the request until it was
+    // polled, queueing on the pool included.
+    double loadMilliseconds;
+    double totalMilliseconds;
+} ScheduledTexture;
+
+// Runs any number of texture loads at once, each on its own pool job or io
+// read, and hands every one over on the first poll after it finishes instead
+// of after the whole batch. Each load is logged with its timings, and every
+// batch, loads requested while others were still in flight, with its overall
+// time.
+class TextureScheduler
+{
+public:
+    TextureScheduler() = default;
+
+    TextureScheduler(const TextureScheduler&) = delete;
+    TextureScheduler& operator=(const TextureScheduler&) = delete;
+
+    // The staging allocator is used for every cooked texture read through io.
+    void Create(ThreadPool& pool, AsyncIo& io, const StagingAllocator& staging);
+
+    // Unstaged loads keep their pixels in host memory, for textures that are
+    // processed further before they go up.
+    void Load(const std::string& path, bool preferCooked = PREFER_COOKED_ASSETS, bool buildMips = false,
+        VkFormat format = VK_FORMAT_R8G8B8A8_SRGB, bool staged = true);
+
+    bool IsLoading(const std::string& path) const;
+    u32 GetPendingCount() const;
+
+    // Appends the loads that finished since the last call.
+    void Poll(std::vector<ScheduledTexture>& finished);
+
+private:
+    typedef struct PendingTexture
+    {
+        std::string path;
+        AssetHandle<TextureAsset> handle;
+        std::chrono::high_resolution_clock::time_point start;
+    } PendingTexture;
+
+    ThreadPool* m_pool = nullptr;
+    AsyncIo* m_io = nullptr;
+    StagingAllocator m_staging;
+
+    std::vector<PendingTexture> m_pending;
+    std::chrono::high_resolution_clock::time_point m_batchStart;
+    u32 m_batchSize = 0;
+    double m_batchLoadMilliseconds = 0.0;
+};
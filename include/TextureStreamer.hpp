@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include <MyMath.hpp>
+
+// Device memory the levels of every streamed texture may take together.
+#define TEXTURE_MEMORY_BUDGET (128ull << 20)
+
+// Levels no larger than this on either side go up with the texture and stay.
+#define TEXTURE_STREAMING_TAIL_SIZE 128
+
+// Finer levels uploaded in one frame at most, though always at least one.
+#define TEXTURE_STREAMING_FRAME_BYTES (8ull << 20)
+
+#define TEXTURE_STREAMING_NONE 0xFFFFFFFF
+
+// Levels a streamed texture's image should hold from firstLevel on, of which
+// those from residentLevel on are filled and sampled.
+typedef struct TextureStreamingUpdate
+{
+    u32 texture;
+    u32 firstLevel;
+    u32 residentLevel;
+} TextureStreamingUpdate;
+
+// Decides the levels of every streamed texture on the device. Each starts
+// with only its tail of small levels, then the level its draws ask for is
+// streamed in one level at a time, coarse to fine, the most covered textures
+// first. Textures keep the finer levels they no longer ask for until the
+// budget runs out, then the least covered ones lose theirs first. Nothing here
+// touches the device, the owner reallocates and uploads.
+class TextureStreamer
+{
+public:
+    TextureStreamer() = default;
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // Whether the texture has levels above its tail to stream at all.
+    static bool IsStreamable(u32 width, u32 height, u32 mipCount);
+
+    u32 Add(VkFormat format, u32 width, u32 height, u32 mipCount, u32 layerCount);
+    void Remove(u32 texture);
+
+    // The tail until the first update.
+    u32 GetFirstLevel(u32 texture) const;
+    u64 GetUsedBytes() const;
+
+    // The finest level the texture's draws need and the share of the screen
+    // they cover, which ranks it against the others.
+    void Request(u32 texture, u32 level, float coverage);
+
+    // Appends the textures whose levels changed since the last call.
+    void Update(std::vector<TextureStreamingUpdate>& updates);
+
+private:
+    typedef struct StreamedTexture
+    {
+        bool used;
+        u32 tailLevel;
+        u32 wantedLevel;
+        float coverage;
+        u32 firstLevel;
+        u32 residentLevel;
+
+        // Every layer of each level.
+        std::vector<u64> levelSizes;
+    } StreamedTexture;
+
+    std::vector<StreamedTexture> m_textures;
+    std::vector<u32> m_freeTextures;
+    u64 m_usedBytes = 0;
+
+    static u64 getSize(const StreamedTexture& texture, u32 firstLevel);
+};
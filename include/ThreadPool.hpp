@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <MyMath.hpp>
+
+class ThreadPool
+{
+public:
+    ThreadPool() = default;
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // threadCount == 0 uses every hardware thread but the caller's.
+    void Create(u32 threadCount = 0);
+    void Destroy();
+
+    u32 GetThreadCount() const;
+
+    template<typename Function>
+    auto Submit(Function&& function) -> std::future<decltype(function())>
+    {
+        using Result = decltype(function());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+        std::future<Result> future = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return future;
+    }
+
+    // Runs body(i) for i in [0, count). The calling thread takes part, so this
+    // is safe to call from inside a job. The first exception thrown by body is
+    // rethrown here once every index has run.
+    void ParallelFor(u32 count, const std::function<void(u32)>& body);
+
+private:
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stopping = false;
+
+    void enqueue(std::function<void()> job);
+    void workerLoop();
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+
+#include <MyMath.hpp>
+#include <AssetDependencies.hpp>
+#include <MappedFile.hpp>
+#include <ThreadPool.hpp>
+
+#define TILED_TEXTURE_MAGIC 0x454C4954 // "TILE"
+#define TILED_TEXTURE_VERSION 1
+#define TILED_TEXTURE_EXTENSION ".tiles"
+#define TILED_TEXTURE_NO_PAGE 0xFFFFFFFF
+#define TILED_TEXTURE_MAX_LEVELS 15
+
+// Pages are VIRTUAL_PAGE_SIZE texels square plus a border on every side that
+// repeats their neighbours', so bilinear filtering never reads past a page.
+#define VIRTUAL_PAGE_SIZE 128
+#define VIRTUAL_PAGE_BORDER 4
+#define VIRTUAL_PAGE_STRIDE (VIRTUAL_PAGE_SIZE + 2 * VIRTUAL_PAGE_BORDER)
+#define VIRTUAL_PAGE_BYTES (VIRTUAL_PAGE_STRIDE * VIRTUAL_PAGE_STRIDE * 4)
+
+typedef struct TiledTextureHeader
+{
+    u32 magic;
+    u32 version;
+    u32 width;
+    u32 height;
+    u32 levelCount;
+    u32 pageCount;
+    AssetDependencies dependencies;
+    u64 dataOffset;
+} TiledTextureHeader;
+
+// Virtual textures written by the cooker next to large sources.
+static inline std::string GetTiledTexturePath(const char* sourcePath)
+{
+    return std::string(sourcePath) + TILED_TEXTURE_EXTENSION;
+}
+
+// RGBA8 sRGB mip chain cut into pages for virtual texturing, written by the
+// cooker as "<source>.tiles". The image sits in the corner of a square grid of
+// pages, a power of two on a side, that halves with every level down to one
+// page. The header is followed by the page number of every grid cell, level 0
+// first and row by row, or TILED_TEXTURE_NO_PAGE for cells past the image, and
+// then by the pages themselves. Pages are read one at a time, straight into
+// upload memory.
+class TiledTexture
+{
+public:
+    TiledTexture() = default;
+
+    // Levels of the page grid for an image of the given size, and the cells of
+    // all levels before the given one.
+    static u32 GetLevelCount(u32 width, u32 height);
+    static u32 GetGridOffset(u32 levelCount, u32 level);
+
+    // chain holds at least GetLevelCount levels laid out as BuildMipChain
+    // writes them. Pages are cut on the pool one level at a time.
+    static bool Write(ThreadPool& pool, const std::string& path, const AssetDependencies& dependencies,
+        u32 width, u32 height, const u8* chain, u32 mipCount);
+
+    bool Open(const std::string& path);
+    void Close();
+
+    const std::string& GetPath() const;
+    const AssetDependencies& GetDependencies() const;
+    u32 GetWidth() const;
+    u32 GetHeight() const;
+    u32 GetLevelCount() const;
+
+    // Pages on a side of the level 0 grid.
+    u32 GetGridSize() const;
+
+    // Where the page's VIRTUAL_PAGE_BYTES are in the file, 0 for cells past the
+    // image.
+    u64 GetPageOffset(u32 level, u32 x, u32 y) const;
+    const u8* GetFileData() const;
+
+private:
+    MappedFile m_file;
+    std::string m_path;
+    const TiledTextureHeader* m_header = nullptr;
+    const u32* m_pages = nullptr;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <functional>
+
+#include <MyMath.hpp>
+
+typedef struct VertexPackingOptions
+{
+    // Formats the device can fetch vertices from.
+    bool allowUnorm16Positions = true;
+    bool allowHalfTexCoords = true;
+
+    // Largest acceptable error, relative to the bounding box diagonal for
+    // positions and in UV units for texture coordinates.
+    float maxPositionError = 1.0f / 65536.0f;
+    float maxTexCoordError = 1.0f / 2048.0f;
+} VertexPackingOptions;
+
+// The layout matching Vertex itself, with 32 bit indices.
+VertexLayout GetFullPrecisionLayout();
+
+// Picks the smallest layout whose error stays within the options for this mesh:
+// 16 bit normalized positions, half float UVs, a constant color dropped from the
+// vertex stream and 16 bit indices when no draw reaches past indexedVertexCount
+// vertices from its vertex offset.
+VertexLayout ChooseVertexLayout(const Vertex* vertices, size_t vertexCount, size_t indexedVertexCount, const VertexPackingOptions& options);
+
+// For vertices that are not stored as a Vertex array, fetch(i) returns vertex i.
+VertexLayout ChooseVertexLayout(const std::function<Vertex(u32)>& fetch, size_t vertexCount, size_t indexedVertexCount, const VertexPackingOptions& options);
+
+// Bytes needed for the packed vertices, the constant color included, and
+// where that color starts.
+size_t GetPackedVertexSize(const VertexLayout& layout, size_t vertexCount);
+size_t GetConstantColorOffset(const VertexLayout& layout, size_t vertexCount);
+size_t GetPackedIndexSize(const VertexLayout& layout, size_t indexCount);
+
+void PackVertices(const VertexLayout& layout, const Vertex* vertices, size_t vertexCount, void* destination);
+void PackVertices(const VertexLayout& layout, const std::function<Vertex(u32)>& fetch, size_t vertexCount, void* destination);
+void PackIndices(const VertexLayout& layout, const u32* indices, size_t indexCount, void* destination);
+
+// Transform to apply before the model matrix for quantized positions.
+glm::mat4 GetDequantizeMatrix(const VertexLayout& layout);
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <MyMath.hpp>
+#include <ThreadPool.hpp>
+
+// Open addressing table deduplicating vertices by their bytes. Each slot keeps
+// the upper hash bits next to the vertex index so most probes never touch the
+// vertex array, and an insert is a single probe sequence.
+class VertexWelder
+{
+public:
+    VertexWelder() = default;
+
+    void Reserve(size_t expectedVertexCount);
+
+    // Returns the index of the vertex equal to this one, adding it when new.
+    u32 Insert(const Vertex& vertex);
+
+    std::vector<Vertex>& GetVertices();
+
+    // Welds count vertices produced by fetch in parallel. Vertices are sharded by
+    // hash and each shard is deduplicated on its own worker, then indices are
+    // handed out in first-seen order so the result is the same as Insert's.
+    static void WeldParallel(ThreadPool& pool, u32 count,
+        const std::function<Vertex(u32)>& fetch,
+        std::vector<Vertex>& vertices, std::vector<u32>& indices);
+
+private:
+    typedef struct Slot
+    {
+        u32 tag;
+        u32 index;
+    } Slot;
+
+    std::vector<Slot> m_slots;
+    std::vector<Vertex> m_vertices;
+    u32 m_mask = 0;
+
+    void rehash(size_t slotCount);
+};
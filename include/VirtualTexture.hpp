@@ -0,0 +1,119 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <MyMath.hpp>
+#include <AsyncIo.hpp>
+#include <ThreadPool.hpp>
+#include <TiledTexture.hpp>
+
+#define VIRTUAL_TEXTURE_CACHE_SIZE 16
+#define VIRTUAL_TEXTURE_UPLOAD_PAGES 32
+#define VIRTUAL_TEXTURE_FEEDBACK_SCALE 8
+
+// Pages as the feedback pass writes them, VIRTUAL_PAGE_NONE where nothing
+// virtually textured was drawn. Must match the shaders.
+#define VIRTUAL_PAGE_KEY(level, x, y) (((level) << 28) | ((y) << 14) | (x))
+#define VIRTUAL_PAGE_NONE 0xFFFFFFFF
+
+// Push constants of the virtual texturing shaders.
+typedef struct VirtualTextureParameters
+{
+    float scale[2];
+    float size;
+    float maxLevel;
+    float lodBias;
+    float cacheSize;
+} VirtualTextureParameters;
+
+// A page to copy from its upload slot into its cache slot.
+typedef struct VirtualPageUpload
+{
+    u32 uploadSlot;
+    u32 cacheX;
+    u32 cacheY;
+} VirtualPageUpload;
+
+// Residency of a tiled texture's pages in a square cache of page slots. The
+// feedback of every finished frame requests the pages it sampled and their
+// coarser ancestors, and the missing ones are read in the background into
+// upload slots, coarsest first. Finished pages take the least recently
+// requested cache slot, except for the single top level page, which stays.
+// The page table maps every page to the closest resident one covering it.
+// Nothing here touches the device, the owner does the copies.
+class VirtualTexture
+{
+public:
+    VirtualTexture() = default;
+
+    VirtualTexture(const VirtualTexture&) = delete;
+    VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+    bool Open(const std::string& path);
+
+    // uploadMemory holds VIRTUAL_TEXTURE_UPLOAD_PAGES pages of
+    // VIRTUAL_PAGE_BYTES for the loads to land in.
+    void Create(ThreadPool& pool, AsyncIo& io, u8* uploadMemory, u32 cacheSize);
+
+    // The pool and io must be done with the loads already.
+    void Destroy();
+
+    const TiledTexture& GetFile() const;
+    u32 GetCacheSize() const;
+    u32 GetPageTableEntryCount() const;
+    VirtualTextureParameters GetParameters(float lodBias) const;
+
+    void RequestPages(const u32* feedback, size_t count, u64 frame);
+
+    // Maps the pages that finished loading for frame to copy. Upload slots
+    // copied by frames up to completedFrame are reused.
+    void CollectUploads(u64 frame, u64 completedFrame, std::vector<VirtualPageUpload>& uploads);
+
+    // Every level of the page table back to back, one RGBA8 entry per page:
+    // the cache slot's x and y, the level of the page in it and 1 once the
+    // top level page is in.
+    bool IsPageTableDirty() const;
+    void WritePageTable(u32* entries);
+
+private:
+    typedef struct LoadedPage
+    {
+        u32 key;
+        u32 uploadSlot;
+        bool success;
+    } LoadedPage;
+
+    TiledTexture m_file;
+    bool m_archived = false;
+    ThreadPool* m_pool = nullptr;
+    AsyncIo* m_io = nullptr;
+    u8* m_uploadMemory = nullptr;
+
+    u32 m_cacheSize = 0;
+    u32 m_gridSize = 0;
+    u32 m_levelCount = 0;
+    u64 m_frame = 0;
+    std::vector<u32> m_levelOffsets;
+
+    // By page table entry, and by cache slot.
+    std::vector<u32> m_pageSlots;
+    std::vector<u32> m_slotPages;
+    std::vector<u64> m_slotFrames;
+
+    std::unordered_set<u32> m_loading;
+    std::vector<u32> m_requests;
+    std::vector<u32> m_freeUploads;
+    std::deque<std::pair<u64, u32>> m_copiedUploads;
+    bool m_dirty = false;
+
+    std::mutex m_loadedMutex;
+    std::vector<LoadedPage> m_loaded;
+
+    u32 getEntry(u32 key) const;
+    void load(u32 key);
+    u32 findCacheSlot() const;
+};
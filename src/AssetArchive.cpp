@@ -0,0 +1,377 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+
+#include <Lz4.hpp>
+#include <AssetArchive.hpp>
+
+typedef struct MountedArchive
+{
+    std::unique_ptr<AssetArchive> archive;
+    ThreadPool* pool;
+} MountedArchive;
+
+static std::vector<MountedArchive> mountedArchives;
+static std::mutex mountedArchivesMutex;
+
+static u64 alignOffset(u64 offset)
+{
+    return (offset + ARCHIVE_ALIGNMENT - 1) & ~u64(ARCHIVE_ALIGNMENT - 1);
+}
+
+static u32 getBlockCount(u64 size)
+{
+    return static_cast<u32>((size + ARCHIVE_BLOCK_SIZE - 1) / ARCHIVE_BLOCK_SIZE);
+}
+
+std::string AssetArchive::NormalizePath(const std::string& path)
+{
+    std::string normalized = path;
+    std::replace(normalized.begin(), normalized.end(), '\\', '/');
+    while (normalized.compare(0, 2, "./") == 0)
+        normalized.erase(0, 2);
+    return normalized;
+}
+
+bool AssetArchive::Write(const std::string& archivePath, const std::vector<std::string>& paths, ThreadPool& pool)
+{
+    std::vector<std::string> names;
+    for (const std::string& path : paths)
+        names.push_back(NormalizePath(path));
+
+    std::vector<u32> order(paths.size());
+    for (u32 i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](u32 a, u32 b) { return names[a] < names[b]; });
+    for (size_t i = 1; i < order.size(); i++)
+        if (names[order[i]] == names[order[i - 1]])
+            throw std::runtime_error("Duplicate archive path " + names[order[i]]);
+
+    std::vector<std::unique_ptr<MappedFile>> files;
+    std::vector<u32> firstBlocks;
+    u32 blockCount = 0;
+    for (u32 i : order)
+    {
+        files.push_back(std::make_unique<MappedFile>());
+        if (!files.back()->Open(paths[i], MAPPED_FILE_WILLNEED))
+            throw std::runtime_error("Failed to open " + paths[i]);
+        firstBlocks.push_back(blockCount);
+        blockCount += getBlockCount(files.back()->GetSize());
+    }
+
+    // Every block of every file is compressed at once, blocks that don't shrink
+    // come back empty and are stored.
+    std::vector<std::vector<u8>> compressed(blockCount);
+    std::vector<u32> blockFiles(blockCount);
+    for (u32 i = 0; i < files.size(); i++)
+        std::fill(blockFiles.begin() + firstBlocks[i], blockFiles.begin() + firstBlocks[i] + getBlockCount(files[i]->GetSize()), i);
+
+    pool.ParallelFor(blockCount, [&](u32 block)
+    {
+        const MappedFile& file = *files[blockFiles[block]];
+        u64 start = static_cast<u64>(block - firstBlocks[blockFiles[block]]) * ARCHIVE_BLOCK_SIZE;
+        size_t size = static_cast<size_t>(std::min<u64>(ARCHIVE_BLOCK_SIZE, file.GetSize() - start));
+
+        std::vector<u8>& output = compressed[block];
+        output.resize(Lz4CompressBound(size));
+        size_t compressedSize = Lz4Compress(reinterpret_cast<const u8*>(file.GetData()) + start, size, output.data(), size - 1);
+        output.resize(compressedSize);
+    });
+
+    std::vector<ArchiveEntry> entries(files.size());
+    std::vector<ArchiveBlock> blocks;
+    std::string nameTable;
+    for (u32 i = 0; i < files.size(); i++)
+    {
+        ArchiveEntry& entry = entries[i];
+        const std::string& name = names[order[i]];
+        entry.nameOffset = static_cast<u32>(nameTable.size());
+        entry.nameLength = static_cast<u32>(name.size());
+        entry.size = files[i]->GetSize();
+        nameTable += name;
+
+        u64 packedSize = 0;
+        u32 fileBlocks = getBlockCount(entry.size);
+        for (u32 block = firstBlocks[i]; block < firstBlocks[i] + fileBlocks; block++)
+            packedSize += compressed[block].empty() ? std::min<u64>(ARCHIVE_BLOCK_SIZE, entry.size - (block - firstBlocks[i]) * u64(ARCHIVE_BLOCK_SIZE)) : compressed[block].size();
+
+        // Entries that barely shrink stay contiguous, so they can be used from
+        // the mapping without a copy.
+        if (packedSize < entry.size - entry.size / 16)
+        {
+            entry.flags = ARCHIVE_ENTRY_COMPRESSED;
+            entry.firstBlock = static_cast<u32>(blocks.size());
+            entry.blockCount = fileBlocks;
+            for (u32 block = 0; block < fileBlocks; block++)
+                blocks.push_back({ 0, 0, static_cast<u32>(std::min<u64>(ARCHIVE_BLOCK_SIZE, entry.size - block * u64(ARCHIVE_BLOCK_SIZE))) });
+        }
+    }
+
+    ArchiveHeader header{};
+    header.magic = ARCHIVE_MAGIC;
+    header.version = ARCHIVE_VERSION;
+    header.entryCount = static_cast<u32>(entries.size());
+    header.blockCount = static_cast<u32>(blocks.size());
+    header.namesSize = nameTable.size();
+    header.dataOffset = alignOffset(sizeof(ArchiveHeader) + sizeof(ArchiveEntry) * entries.size() +
+        sizeof(ArchiveBlock) * blocks.size() + nameTable.size());
+
+    u64 offset = header.dataOffset;
+    for (u32 i = 0; i < files.size(); i++)
+    {
+        ArchiveEntry& entry = entries[i];
+        if (!(entry.flags & ARCHIVE_ENTRY_COMPRESSED))
+        {
+            offset = alignOffset(offset);
+            entry.offset = offset;
+            offset += entry.size;
+            continue;
+        }
+
+        for (u32 block = 0; block < entry.blockCount; block++)
+        {
+            ArchiveBlock& archiveBlock = blocks[entry.firstBlock + block];
+            const std::vector<u8>& data = compressed[firstBlocks[i] + block];
+            archiveBlock.offset = offset;
+            archiveBlock.compressedSize = data.empty() ? archiveBlock.size : static_cast<u32>(data.size());
+            offset += archiveBlock.compressedSize;
+        }
+    }
+
+    std::string tempPath = archivePath + ".tmp";
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    const char padding[ARCHIVE_ALIGNMENT] = {};
+    auto pad = [&](u64 to) { file.write(padding, static_cast<std::streamsize>(to - static_cast<u64>(file.tellp()))); };
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()), sizeof(ArchiveEntry) * entries.size());
+    file.write(reinterpret_cast<const char*>(blocks.data()), sizeof(ArchiveBlock) * blocks.size());
+    file.write(nameTable.data(), nameTable.size());
+
+    for (u32 i = 0; i < files.size() && file; i++)
+    {
+        const ArchiveEntry& entry = entries[i];
+        const char* data = files[i]->GetData();
+        if (!(entry.flags & ARCHIVE_ENTRY_COMPRESSED))
+        {
+            pad(entry.offset);
+            file.write(data, entry.size);
+            continue;
+        }
+
+        pad(blocks[entry.firstBlock].offset);
+        for (u32 block = 0; block < entry.blockCount; block++)
+        {
+            const std::vector<u8>& packed = compressed[firstBlocks[i] + block];
+            if (packed.empty())
+                file.write(data + block * u64(ARCHIVE_BLOCK_SIZE), blocks[entry.firstBlock + block].size);
+            else
+                file.write(reinterpret_cast<const char*>(packed.data()), packed.size());
+        }
+    }
+    pad(alignOffset(offset));
+    file.close();
+
+    std::remove(archivePath.c_str());
+    if (!file || std::rename(tempPath.c_str(), archivePath.c_str()) != 0)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool AssetArchive::Open(const std::string& archivePath)
+{
+    Close();
+
+    if (!m_file.Open(archivePath) || m_file.GetSize() < sizeof(ArchiveHeader))
+    {
+        Close();
+        return false;
+    }
+
+    const ArchiveHeader* header = reinterpret_cast<const ArchiveHeader*>(m_file.GetData());
+    u64 fileSize = m_file.GetSize();
+    u64 tablesSize = sizeof(ArchiveHeader) + sizeof(ArchiveEntry) * u64(header->entryCount) +
+        sizeof(ArchiveBlock) * u64(header->blockCount) + header->namesSize;
+
+    if (header->magic != ARCHIVE_MAGIC ||
+        header->version != ARCHIVE_VERSION ||
+        tablesSize > header->dataOffset ||
+        header->dataOffset > fileSize)
+    {
+        Close();
+        return false;
+    }
+
+    const ArchiveEntry* entries = reinterpret_cast<const ArchiveEntry*>(header + 1);
+    const ArchiveBlock* blocks = reinterpret_cast<const ArchiveBlock*>(entries + header->entryCount);
+    const char* names = reinterpret_cast<const char*>(blocks + header->blockCount);
+
+    bool valid = true;
+    for (u32 i = 0; i < header->blockCount && valid; i++)
+        valid = blocks[i].size <= ARCHIVE_BLOCK_SIZE && blocks[i].compressedSize <= blocks[i].size &&
+            blocks[i].offset >= header->dataOffset && blocks[i].offset + blocks[i].compressedSize <= fileSize;
+
+    for (u32 i = 0; i < header->entryCount && valid; i++)
+    {
+        const ArchiveEntry& entry = entries[i];
+        valid = u64(entry.nameOffset) + entry.nameLength <= header->namesSize;
+        if (valid && i > 0)
+            valid = std::string_view(names + entries[i - 1].nameOffset, entries[i - 1].nameLength) <
+                std::string_view(names + entry.nameOffset, entry.nameLength);
+
+        if (!valid)
+            break;
+
+        if (!(entry.flags & ARCHIVE_ENTRY_COMPRESSED))
+        {
+            valid = entry.offset >= header->dataOffset && entry.offset <= fileSize && entry.size <= fileSize - entry.offset;
+            continue;
+        }
+
+        valid = u64(entry.firstBlock) + entry.blockCount <= header->blockCount && entry.blockCount == getBlockCount(entry.size);
+        for (u32 block = 0; block < entry.blockCount && valid; block++)
+            valid = blocks[entry.firstBlock + block].size == std::min<u64>(ARCHIVE_BLOCK_SIZE, entry.size - block * u64(ARCHIVE_BLOCK_SIZE));
+    }
+
+    if (!valid)
+    {
+        Close();
+        return false;
+    }
+
+    m_header = header;
+    m_entries = entries;
+    m_blocks = blocks;
+    m_names = names;
+    return true;
+}
+
+void AssetArchive::Close()
+{
+    m_file.Close();
+    m_header = nullptr;
+    m_entries = nullptr;
+    m_blocks = nullptr;
+    m_names = nullptr;
+}
+
+const ArchiveEntry* AssetArchive::Find(const std::string& path) const
+{
+    if (!m_header)
+        return nullptr;
+
+    std::string name = NormalizePath(path);
+    const ArchiveEntry* end = m_entries + m_header->entryCount;
+    const ArchiveEntry* entry = std::lower_bound(m_entries, end, std::string_view(name),
+        [this](const ArchiveEntry& e, std::string_view value) { return std::string_view(m_names + e.nameOffset, e.nameLength) < value; });
+
+    if (entry == end || std::string_view(m_names + entry->nameOffset, entry->nameLength) != name)
+        return nullptr;
+    return entry;
+}
+
+u32 AssetArchive::GetEntryCount() const
+{
+    return m_header ? m_header->entryCount : 0;
+}
+
+const char* AssetArchive::GetStoredData(const ArchiveEntry& entry) const
+{
+    return entry.flags & ARCHIVE_ENTRY_COMPRESSED ? nullptr : m_file.GetData() + entry.offset;
+}
+
+void AssetArchive::Read(const ArchiveEntry& entry, ThreadPool* pool, void* destination) const
+{
+    if (!(entry.flags & ARCHIVE_ENTRY_COMPRESSED))
+    {
+        memcpy(destination, GetStoredData(entry), static_cast<size_t>(entry.size));
+        return;
+    }
+
+    // The blocks are decoded out of order, so they are all asked for up front.
+    const ArchiveBlock& first = m_blocks[entry.firstBlock];
+    const ArchiveBlock& last = m_blocks[entry.firstBlock + entry.blockCount - 1];
+    m_file.Advise(static_cast<size_t>(first.offset), static_cast<size_t>(last.offset + last.compressedSize - first.offset), MAPPED_FILE_WILLNEED);
+
+    auto decode = [&](u32 index)
+    {
+        const ArchiveBlock& block = m_blocks[entry.firstBlock + index];
+        const u8* source = reinterpret_cast<const u8*>(m_file.GetData() + block.offset);
+        u8* output = static_cast<u8*>(destination) + index * u64(ARCHIVE_BLOCK_SIZE);
+
+        if (block.compressedSize == block.size)
+            memcpy(output, source, block.size);
+        else if (!Lz4Decompress(source, block.compressedSize, output, block.size))
+            throw std::runtime_error("Corrupt block in archive");
+    };
+
+    if (pool)
+        pool->ParallelFor(entry.blockCount, decode);
+    else
+        for (u32 i = 0; i < entry.blockCount; i++)
+            decode(i);
+}
+
+bool MountArchive(const std::string& archivePath, ThreadPool* pool)
+{
+    std::unique_ptr<AssetArchive> archive = std::make_unique<AssetArchive>();
+    if (!archive->Open(archivePath))
+        return false;
+
+    std::lock_guard<std::mutex> lock(mountedArchivesMutex);
+    mountedArchives.push_back({ std::move(archive), pool });
+    return true;
+}
+
+void UnmountArchives()
+{
+    std::lock_guard<std::mutex> lock(mountedArchivesMutex);
+    mountedArchives.clear();
+}
+
+bool ReadArchivedFile(const std::string& path, const char*& data, size_t& size, std::unique_ptr<char[]>& buffer)
+{
+    const AssetArchive* archive = nullptr;
+    const ArchiveEntry* entry = nullptr;
+    ThreadPool* pool = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mountedArchivesMutex);
+        for (auto mounted = mountedArchives.rbegin(); mounted != mountedArchives.rend() && !entry; ++mounted)
+        {
+            entry = mounted->archive->Find(path);
+            archive = mounted->archive.get();
+            pool = mounted->pool;
+        }
+    }
+    if (!entry)
+        return false;
+
+    size = static_cast<size_t>(entry->size);
+    data = archive->GetStoredData(*entry);
+    if (data)
+        return true;
+
+    buffer.reset(new char[size]);
+    archive->Read(*entry, pool, buffer.get());
+    data = buffer.get();
+    return true;
+}
+
+bool IsArchivedFile(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(mountedArchivesMutex);
+    for (const auto& mounted : mountedArchives)
+        if (mounted.archive->Find(path))
+            return true;
+    return false;
+}
@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+#include <MyUtils.hpp>
+#include <AssetArchive.hpp>
+#include <AssetLoader.hpp>
+#include <BlockCompressor.hpp>
+#include <MipGenerator.hpp>
+#include <TiledTexture.hpp>
+
+// Offline build of everything LoadModel and LoadTexture convert at launch.
+// Every OBJ and PNG found is cooked into "<source>.cooked" next to it: OBJs
+// welded, optimized and split into LODs and meshlets like the mesh cache,
+// PNGs decoded with their full mip chain in the upload format. PNGs are also
+// block-compressed into "<source>.<format>.ktx2" for each format asked for,
+// BC7 by default. PNGs at least VIRTUAL_TEXTURE_MIN_SIZE on a side are
+// additionally cut into the pages of "<source>.tiles" for virtual texturing.
+// The runtime maps those instead of the sources. Outputs whose
+// recorded dependencies still match are skipped, and assets are cooked in
+// parallel on the pool. With -p everything under the inputs is then packed
+// into one archive, the cooked files in place of their sources.
+
+#define VIRTUAL_TEXTURE_MIN_SIZE 4096
+
+static const char* usage =
+    "Usage: AssetCooker [-f] [-j threads] [-c formats] [-v size] [-p archive] [files or directories...]\n"
+    "  Cooks every .obj and .png given or found below the directories, data by default.\n"
+    "  -f  cook even when the output is up to date\n"
+    "  -j  worker threads, every hardware thread by default\n"
+    "  -c  comma separated block-compressed texture formats out of bc1, bc3 and bc7,\n"
+    "      bc7 by default, none for only the uncompressed ones\n"
+    "  -v  tile textures this large on either side for virtual texturing, 4096 by default\n"
+    "  -p  pack the cooked assets and every other file into an archive\n";
+
+static bool isCookable(const std::string& extension)
+{
+    return extension == ".obj" || extension == ".png";
+}
+
+static std::string getExtension(const std::filesystem::path& path)
+{
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+        [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+    return extension;
+}
+
+// 0 stands for a missing file, so the output is rebuilt once it shows up.
+static u64 hashFile(const std::string& path, u64 seed)
+{
+    MappedFile file;
+    if (!file.Open(path, MAPPED_FILE_SEQUENTIAL))
+        return 0;
+    return Hash64(file.GetData(), file.GetSize(), seed);
+}
+
+// Paths of the mtllib statements, relative to the OBJ.
+static std::vector<std::string> getMaterialLibraries(const char* path, const char* data, size_t size)
+{
+    std::vector<std::string> libraries;
+    std::filesystem::path directory = std::filesystem::path(path).parent_path();
+
+    const char* end = data + size;
+    for (const char* line = data; line < end;)
+    {
+        const char* lineEnd = static_cast<const char*>(memchr(line, '\n', end - line));
+        if (!lineEnd)
+            lineEnd = end;
+
+        while (line < lineEnd && (*line == ' ' || *line == '\t'))
+            line++;
+        if (lineEnd - line > 6 && strncmp(line, "mtllib", 6) == 0 && (line[6] == ' ' || line[6] == '\t'))
+        {
+            for (const char* name = line + 7; name < lineEnd;)
+            {
+                while (name < lineEnd && isspace(static_cast<unsigned char>(*name)))
+                    name++;
+                const char* nameEnd = name;
+                while (nameEnd < lineEnd && !isspace(static_cast<unsigned char>(*nameEnd)))
+                    nameEnd++;
+                if (nameEnd > name)
+                    libraries.push_back((directory / std::string(name, nameEnd)).string());
+                name = nameEnd;
+            }
+        }
+
+        line = lineEnd + 1;
+    }
+    return libraries;
+}
+
+// Returns false when the cooked model is up to date.
+static bool cookModel(ThreadPool& pool, const std::string& path, bool force)
+{
+    MappedFile source;
+    if (!source.Open(path, MAPPED_FILE_WILLNEED))
+        throw std::runtime_error("Failed to open " + path);
+
+    AssetDependencies dependencies{};
+    dependencies.hashes[dependencies.count++] = MeshCache::HashSource(source.GetData(), source.GetSize());
+    for (const std::string& library : getMaterialLibraries(path.c_str(), source.GetData(), source.GetSize()))
+    {
+        if (dependencies.count == MAX_ASSET_DEPENDENCIES)
+            throw std::runtime_error(path + " has too many material libraries");
+        dependencies.hashes[dependencies.count++] = hashFile(library, MESH_CACHE_VERSION);
+    }
+
+    std::string cookedPath = GetCookedPath(path.c_str());
+    if (!force)
+    {
+        MeshCache cooked;
+        if (cooked.Open(cookedPath, MODEL_CACHE_FLAGS) && SameDependencies(cooked.GetDependencies(), dependencies))
+            return false;
+    }
+
+    std::unique_ptr<ModelAsset> model = BuildObjModel(pool, path.c_str(), source.GetData(), source.GetSize());
+    if (!MeshCache::Write(cookedPath, dependencies, MODEL_CACHE_FLAGS,
+        model->submeshes.data(), model->submeshes.size(),
+        model->lods.data(), model->lods.size(), model->meshlets,
+        model->vertices.data(), model->vertices.size(), model->indices.data(), model->indices.size()))
+        throw std::runtime_error("Failed to write " + cookedPath);
+    return true;
+}
+
+// Returns false when the cooked texture and all its KTX2 and tiled files are
+// up to date.
+static bool cookTexture(ThreadPool& pool, const std::string& path, const std::vector<VkFormat>& blockFormats, u32 virtualSize, bool force)
+{
+    MappedFile source;
+    if (!source.Open(path, MAPPED_FILE_SEQUENTIAL))
+        throw std::runtime_error("Failed to open " + path);
+
+    const VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+    AssetDependencies dependencies{};
+    dependencies.hashes[dependencies.count++] = Hash64(source.GetData(), source.GetSize(), TEXTURE_CACHE_VERSION);
+
+    // The header is enough to tell whether the texture is tiled.
+    u32 width = 0, height = 0;
+    if (!GetTextureSize(source.GetData(), source.GetSize(), width, height))
+        throw std::runtime_error("Failed to read the size of " + path);
+    bool tiled = std::max(width, height) >= virtualSize;
+    std::string tiledPath = GetTiledTexturePath(path.c_str());
+
+    std::string cookedPath = GetCookedPath(path.c_str());
+    if (!force)
+    {
+        TextureCache cooked;
+        bool upToDate = cooked.Open(cookedPath) && cooked.GetFormat() == format && SameDependencies(cooked.GetDependencies(), dependencies);
+        for (VkFormat blockFormat : blockFormats)
+        {
+            Ktx2File compressed;
+            upToDate = upToDate && compressed.Open(GetKtx2Path(path.c_str(), GetBlockFormatName(blockFormat))) &&
+                compressed.GetFormat() == blockFormat && SameDependencies(compressed.GetDependencies(), dependencies);
+        }
+        TiledTexture tiles;
+        upToDate = upToDate && (!tiled || (tiles.Open(tiledPath) && SameDependencies(tiles.GetDependencies(), dependencies)));
+        if (upToDate)
+            return false;
+    }
+
+    std::unique_ptr<TextureAsset> texture = DecodeTexture(path.c_str(), source.GetData(), source.GetSize());
+    u32 mipCount = GetMipCount(texture->width, texture->height);
+
+    std::vector<u8> chain;
+    BuildMipChain(pool, texture->pixelData, texture->width, texture->height, mipCount, chain);
+    if (!TextureCache::Write(cookedPath, dependencies, format, texture->width, texture->height, mipCount, chain.data(), chain.size()))
+        throw std::runtime_error("Failed to write " + cookedPath);
+
+    for (VkFormat blockFormat : blockFormats)
+    {
+        std::vector<u8> blocks;
+        CompressMipChain(pool, blockFormat, chain.data(), texture->width, texture->height, mipCount, blocks);
+        std::string compressedPath = GetKtx2Path(path.c_str(), GetBlockFormatName(blockFormat));
+        if (!Ktx2File::Write(compressedPath, dependencies, blockFormat, texture->width, texture->height, mipCount, blocks.data(), blocks.size()))
+            throw std::runtime_error("Failed to write " + compressedPath);
+    }
+
+    if (tiled && !TiledTexture::Write(pool, tiledPath, dependencies, texture->width, texture->height, chain.data(), mipCount))
+        throw std::runtime_error("Failed to write " + tiledPath);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    bool force = false;
+    u32 threadCount = 0;
+    u32 virtualSize = VIRTUAL_TEXTURE_MIN_SIZE;
+    std::string archivePath;
+    std::vector<VkFormat> blockFormats = { VK_FORMAT_BC7_SRGB_BLOCK };
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "-f")
+        {
+            force = true;
+        }
+        else if (argument == "-j" && i + 1 < argc)
+        {
+            threadCount = static_cast<u32>(std::max(atoi(argv[++i]), 1));
+        }
+        else if (argument == "-c" && i + 1 < argc)
+        {
+            blockFormats.clear();
+            std::string list = argv[++i];
+            for (size_t start = 0; list != "none" && start <= list.size();)
+            {
+                size_t end = std::min(list.find(',', start), list.size());
+                VkFormat blockFormat = GetBlockFormat(list.substr(start, end - start).c_str());
+                if (blockFormat == VK_FORMAT_UNDEFINED)
+                {
+                    std::cerr << usage;
+                    return 2;
+                }
+                if (std::find(blockFormats.begin(), blockFormats.end(), blockFormat) == blockFormats.end())
+                    blockFormats.push_back(blockFormat);
+                start = end + 1;
+            }
+        }
+        else if (argument == "-v" && i + 1 < argc)
+        {
+            virtualSize = static_cast<u32>(std::max(atoi(argv[++i]), 1));
+        }
+        else if (argument == "-p" && i + 1 < argc)
+        {
+            archivePath = argv[++i];
+        }
+        else if (argument[0] == '-')
+        {
+            std::cerr << usage;
+            return 2;
+        }
+        else
+        {
+            inputs.push_back(argument);
+        }
+    }
+    if (inputs.empty())
+        inputs.push_back("data");
+
+    std::vector<std::string> files;
+    for (const std::string& input : inputs)
+    {
+        std::error_code error;
+        if (!std::filesystem::is_directory(input, error))
+        {
+            files.push_back(input);
+            continue;
+        }
+
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(input, error))
+            if (entry.is_regular_file())
+                files.push_back(entry.path().string());
+    }
+    std::sort(files.begin(), files.end());
+    files.erase(std::unique(files.begin(), files.end()), files.end());
+
+    std::vector<std::string> sources;
+    for (const std::string& file : files)
+        if (isCookable(getExtension(file)))
+            sources.push_back(file);
+
+    ThreadPool pool;
+    pool.Create(threadCount);
+
+    // One job per asset, models also spread their own parsing and welding over
+    // the pool through ParallelFor.
+    std::vector<std::future<bool>> jobs;
+    std::vector<double> times(sources.size());
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        ThreadPool* workers = &pool;
+        const std::vector<VkFormat>* formats = &blockFormats;
+        std::string path = sources[i];
+        double* time = &times[i];
+        jobs.push_back(pool.Submit([workers, formats, path, virtualSize, force, time]()
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            bool cooked = getExtension(path) == ".obj" ? cookModel(*workers, path, force) : cookTexture(*workers, path, *formats, virtualSize, force);
+            *time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            return cooked;
+        }));
+    }
+
+    u32 cooked = 0, upToDate = 0, failed = 0;
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        try
+        {
+            if (jobs[i].get())
+            {
+                std::cout << "cooked     " << sources[i] << " (" << times[i] << " ms)" << std::endl;
+                cooked++;
+            }
+            else
+            {
+                std::cout << "up to date " << sources[i] << std::endl;
+                upToDate++;
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "failed     " << sources[i] << ": " << e.what() << std::endl;
+            failed++;
+        }
+    }
+
+    std::cout << cooked << " cooked, " << upToDate << " up to date, " << failed << " failed" << std::endl;
+    if (failed)
+        return 1;
+
+    // Caches, leftovers and cooked files whose source is gone stay out.
+    if (!archivePath.empty())
+    {
+        std::vector<std::string> packed;
+        std::string archiveName = AssetArchive::NormalizePath(archivePath);
+        for (const std::string& file : files)
+        {
+            std::string extension = getExtension(file);
+            if (extension == ".cooked" || extension == ".ktx2" || extension == TILED_TEXTURE_EXTENSION || extension == ".meshcache" || extension == ".tmp" ||
+                AssetArchive::NormalizePath(file) == archiveName)
+                continue;
+            packed.push_back(isCookable(extension) ? GetCookedPath(file.c_str()) : file);
+            if (extension == ".png")
+            {
+                for (VkFormat blockFormat : blockFormats)
+                    packed.push_back(GetKtx2Path(file.c_str(), GetBlockFormatName(blockFormat)));
+                std::error_code error;
+                if (std::filesystem::exists(GetTiledTexturePath(file.c_str()), error))
+                    packed.push_back(GetTiledTexturePath(file.c_str()));
+            }
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        if (!AssetArchive::Write(archivePath, packed, pool))
+        {
+            std::cerr << "Failed to write " << archivePath << std::endl;
+            return 1;
+        }
+
+        AssetArchive archive;
+        archive.Open(archivePath);
+        std::cout << "packed " << archive.GetEntryCount() << " files into " << archivePath << " ("
+            << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms)" << std::endl;
+    }
+
+    pool.Destroy();
+    return 0;
+}
@@ -0,0 +1,855 @@
+#include <stb-master/stb_image.h>
+#include <tiny_obj_loader.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <MyUtils.hpp>
+#include <AssetArchive.hpp>
+#include <BlockCompressor.hpp>
+#include <MappedFile.hpp>
+#include <MipGenerator.hpp>
+#include <ObjParser.hpp>
+#include <PixelConversion.hpp>
+#include <MeshOptimizer.hpp>
+#include <VertexWelder.hpp>
+#include <AssetLoader.hpp>
+
+#define PLACEHOLDER_MODEL_SIZE 4.0f
+
+#ifdef OBJ_PARSER_BENCHMARK
+// Times the parallel parser against the tinyobj path loadModel used to take
+// and checks that both produce the same vertices and indices. Files with several
+// objects or materials have their triangles regrouped and won't match.
+static void benchmarkObjParser(ThreadPool& pool, const char* path, const char* text, size_t size)
+{
+    auto tinyobjStart = std::chrono::high_resolution_clock::now();
+
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path))
+        throw std::runtime_error(warn + err);
+
+    std::unordered_map<Vertex, u32> uniqueVertices{};
+    std::vector<Vertex> referenceVertices;
+    std::vector<u32> referenceIndices;
+
+    for (const auto& shape : shapes)
+    {
+        for (const auto& index : shape.mesh.indices)
+        {
+            Vertex vertex{};
+
+            vertex.pos =
+            {
+                attrib.vertices[3 * index.vertex_index + 0],
+                attrib.vertices[3 * index.vertex_index + 1],
+                attrib.vertices[3 * index.vertex_index + 2]
+            };
+
+            if (index.texcoord_index >= 0)
+            {
+                vertex.texCoord =
+                {
+                    attrib.texcoords[2 * index.texcoord_index + 0],
+                    1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+                };
+            }
+
+            vertex.color = { 1.0f, 1.0f, 1.0f };
+
+            if (uniqueVertices.count(vertex) == 0)
+            {
+                uniqueVertices[vertex] = static_cast<u32>(referenceVertices.size());
+                referenceVertices.push_back(vertex);
+            }
+
+            referenceIndices.push_back(uniqueVertices[vertex]);
+        }
+    }
+
+    auto parserStart = std::chrono::high_resolution_clock::now();
+
+    ObjData obj;
+    std::vector<Vertex> vertices;
+    std::vector<u32> indices;
+    ParseObj(pool, text, size, obj);
+    WeldObj(pool, obj, { 0, 0, 0, static_cast<u32>(obj.corners.size()) }, vertices, indices);
+
+    auto parserEnd = std::chrono::high_resolution_clock::now();
+
+    bool match = vertices.size() == referenceVertices.size() && indices == referenceIndices &&
+        memcmp(vertices.data(), referenceVertices.data(), sizeof(Vertex) * vertices.size()) == 0;
+
+    std::cout << "OBJ parser benchmark (" << path << ", " << pool.GetThreadCount() + 1 << " threads)\n"
+        << "  tinyobj  : " << std::chrono::duration<double, std::milli>(parserStart - tinyobjStart).count() << " ms\n"
+        << "  parallel : " << std::chrono::duration<double, std::milli>(parserEnd - parserStart).count() << " ms\n"
+        << "  output   : " << (match ? "identical" : "MISMATCH") << std::endl;
+}
+#endif
+
+static u32 getLargestSubmeshVertexCount(const ModelAsset& model)
+{
+    u32 largest = 0;
+    for (u32 i = 0; i < model.submeshCount; i++)
+        largest = std::max(largest, model.submeshData[i].vertexCount);
+    return largest;
+}
+
+// Points the model at its own vectors and picks the vertex format.
+static void finishModel(ModelAsset& model, const VertexPackingOptions& options)
+{
+    model.submeshData = model.submeshes.data();
+    model.submeshCount = static_cast<u32>(model.submeshes.size());
+    model.lodData = model.lods.data();
+    model.meshletData = model.meshlets.meshlets.data();
+    model.vertexData = model.vertices.data();
+    model.vertexCount = static_cast<u32>(model.vertices.size());
+    model.indexData = model.indices.data();
+    model.indexCount = static_cast<u32>(model.indices.size());
+
+    model.layout = ChooseVertexLayout(model.vertexData, model.vertexCount, getLargestSubmeshVertexCount(model), options);
+}
+
+static bool hasExtension(const char* path, const char* extension)
+{
+    size_t pathLength = strlen(path), extensionLength = strlen(extension);
+    if (pathLength < extensionLength)
+        return false;
+    for (size_t i = 0; i < extensionLength; i++)
+        if (tolower(path[pathLength - extensionLength + i]) != extension[i])
+            return false;
+    return true;
+}
+
+static Vertex fetchGlbModelVertex(const ModelAsset& model, u32 index)
+{
+    auto submesh = std::upper_bound(model.submeshes.begin(), model.submeshes.end(), index,
+        [](u32 value, const Submesh& s) { return value < static_cast<u32>(s.vertexOffset); }) - 1;
+    return FetchGlbVertex(model.primitives[submesh - model.submeshes.begin()], index - submesh->vertexOffset);
+}
+
+static BoundingSphere getGlbBounds(const GlbPrimitive& primitive)
+{
+    glm::vec3 minimum = primitive.position.minimum, maximum = primitive.position.maximum;
+    if (!primitive.position.hasBounds)
+    {
+        minimum = glm::vec3(FLT_MAX);
+        maximum = glm::vec3(-FLT_MAX);
+        for (u32 i = 0; i < primitive.position.count; i++)
+        {
+            glm::vec3 position = FetchGlbVertex(primitive, i).pos;
+            minimum = glm::min(minimum, position);
+            maximum = glm::max(maximum, position);
+        }
+    }
+    return { (minimum + maximum) * 0.5f, glm::length(maximum - minimum) * 0.5f };
+}
+
+// What a model load produces depends on the files it was built from and on the
+// layout options. The fields are hashed one by one, the struct has padding.
+static u64 getModelContentHash(const AssetDependencies& dependencies, const VertexPackingOptions& options)
+{
+    u64 hash = Hash64(dependencies.hashes, dependencies.count * sizeof(u64), dependencies.count);
+    float errors[2] = { options.maxPositionError, options.maxTexCoordError };
+    u8 formats[2] = { options.allowUnorm16Positions, options.allowHalfTexCoords };
+    hash = Hash64(errors, sizeof(errors), hash);
+    return Hash64(formats, sizeof(formats), hash);
+}
+
+// Cooked textures and ones decoded at load share the source hash but not the
+// format or mip chain. Files that don't record their sources are never shared.
+static u64 getTextureContentHash(const AssetDependencies& dependencies, VkFormat format, u32 mipCount)
+{
+    if (dependencies.count == 0)
+        return 0;
+    return Hash64(dependencies.hashes, dependencies.count * sizeof(u64), (static_cast<u64>(format) << 32) | mipCount);
+}
+
+// GLB primitives are drawn as stored: no welding when they are indexed and no
+// cache, vertex optimization, LODs or meshlets, since any of those would
+// rewrite the buffers that are meant to go to the GPU untouched.
+static std::unique_ptr<ModelAsset> loadGlbModel(ThreadPool& pool, const char* path, const VertexPackingOptions& options)
+{
+    std::unique_ptr<ModelAsset> model = std::make_unique<ModelAsset>();
+    if (!model->source.Open(path, MAPPED_FILE_WILLNEED))
+        throw std::runtime_error(std::string("Failed to open ") + path);
+
+    AssetDependencies dependencies{};
+    dependencies.hashes[dependencies.count++] = Hash64(model->source.GetData(), model->source.GetSize());
+    model->contentHash = getModelContentHash(dependencies, options);
+
+    GlbData glb;
+    ParseGlb(model->source.GetData(), model->source.GetSize(), glb);
+
+    model->primitives = glb.primitives;
+    std::stable_sort(model->primitives.begin(), model->primitives.end(),
+        [](const GlbPrimitive& a, const GlbPrimitive& b) { return a.material < b.material; });
+
+    u32 vertexCount = 0, indexCount = 0, weldedCount = 0;
+    for (GlbPrimitive& primitive : model->primitives)
+    {
+        if (!primitive.indices.data && primitive.position.count > 0)
+        {
+            std::vector<Vertex> vertices;
+            std::vector<u32> indices;
+            const GlbPrimitive source = primitive;
+            VertexWelder::WeldParallel(pool, source.position.count,
+                [&source](u32 i) { return FetchGlbVertex(source, i); }, vertices, indices);
+
+            primitive.position = { reinterpret_cast<const u8*>(&vertices[0].pos), static_cast<u32>(vertices.size()),
+                sizeof(Vertex), GLB_COMPONENT_FLOAT, 3, false, source.position.hasBounds, source.position.minimum, source.position.maximum };
+            primitive.color = { reinterpret_cast<const u8*>(&vertices[0].color), static_cast<u32>(vertices.size()),
+                sizeof(Vertex), GLB_COMPONENT_FLOAT, 3, false, false, {}, {} };
+            primitive.texCoord = { reinterpret_cast<const u8*>(&vertices[0].texCoord), static_cast<u32>(vertices.size()),
+                sizeof(Vertex), GLB_COMPONENT_FLOAT, 2, false, false, {}, {} };
+            primitive.indices = { reinterpret_cast<const u8*>(indices.data()), static_cast<u32>(indices.size()),
+                sizeof(u32), GLB_COMPONENT_UNSIGNED_INT, 1, false, false, {}, {} };
+
+            model->weldedVertices.push_back(std::move(vertices));
+            model->weldedIndices.push_back(std::move(indices));
+            weldedCount++;
+        }
+
+        Submesh submesh{};
+        submesh.firstLod = static_cast<u32>(model->lods.size());
+        submesh.lodCount = 1;
+        submesh.vertexOffset = static_cast<i32>(vertexCount);
+        submesh.vertexCount = primitive.position.count;
+        submesh.object = primitive.mesh;
+        submesh.material = primitive.material;
+        submesh.bounds = getGlbBounds(primitive);
+        model->submeshes.push_back(submesh);
+
+        model->lods.push_back({ indexCount, primitive.indices.count, 0, 0, 0.0f });
+
+        vertexCount += primitive.position.count;
+        indexCount += primitive.indices.count;
+    }
+
+    model->submeshData = model->submeshes.data();
+    model->submeshCount = static_cast<u32>(model->submeshes.size());
+    model->lodData = model->lods.data();
+    model->vertexCount = vertexCount;
+    model->indexCount = indexCount;
+
+    const ModelAsset* asset = model.get();
+    model->layout = ChooseVertexLayout([asset](u32 i) { return fetchGlbModelVertex(*asset, i); },
+        vertexCount, getLargestSubmeshVertexCount(*model), options);
+
+    std::cout << path << ": " << model->submeshCount << " primitives (" << weldedCount << " welded), "
+        << model->layout.stride << " bytes per vertex, "
+        << (model->layout.indexType == VK_INDEX_TYPE_UINT16 ? 16 : 32) << " bit indices" << std::endl;
+    return model;
+}
+
+// Sub-allocates the staged ranges of a streamed model from chunks of
+// STREAM_STAGING_CHUNK_SIZE bytes.
+typedef struct StagingWriter
+{
+    const StagingAllocator& allocate;
+    u32 buffer;
+    char* data;
+    u64 used;
+    u64 capacity;
+} StagingWriter;
+
+static char* stage(ModelAsset& model, StagingWriter& writer, u64 size, u64 destinationOffset, bool index)
+{
+    u64 aligned = (size + 3) & ~u64(3);
+    if (!writer.data || writer.used + aligned > writer.capacity)
+    {
+        writer.capacity = std::max<u64>(aligned, STREAM_STAGING_CHUNK_SIZE);
+        writer.data = static_cast<char*>(writer.allocate(static_cast<size_t>(writer.capacity), writer.buffer));
+        writer.used = 0;
+    }
+
+    model.stagedRanges.push_back({ writer.buffer, index, writer.used, destinationOffset, size });
+    char* result = writer.data + writer.used;
+    writer.used += aligned;
+    return result;
+}
+
+// Each block is optimized, split in meshlets and packed into staging memory as
+// soon as it is parsed, so nothing but the OBJ's v/vt records and the per
+// block records stays on the heap. The layout is fixed up front: full
+// precision, since the bounds are only known at the end, a constant white
+// color like every OBJ vertex has, and 16 bit indices since blocks never
+// exceed OBJ_STREAM_BLOCK_VERTICES.
+static std::unique_ptr<ModelAsset> streamObjModel(const char* path, const StagingAllocator& staging)
+{
+    std::unique_ptr<ModelAsset> model = std::make_unique<ModelAsset>();
+    model->layout = GetFullPrecisionLayout();
+    model->layout.constantColor = true;
+    model->layout.colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    model->layout.colorOffset = 0;
+    model->layout.texCoordOffset = sizeof(glm::vec3);
+    model->layout.stride = sizeof(glm::vec3) + sizeof(glm::vec2);
+    model->layout.indexType = VK_INDEX_TYPE_UINT16;
+
+    StagingWriter writer{ staging, 0, nullptr, 0, 0 };
+    MeshletData meshlets;
+    u64 vertexCount = 0, indexCount = 0;
+
+    std::vector<std::string> objects, materials;
+    StreamObj(path, objects, materials, [&](ObjStreamBlock& block)
+    {
+        if (OPTIMIZE_MESHES)
+            OptimizeMesh(block.vertices, block.indices);
+
+        // Checked before anything of the block is recorded, the vertex offset
+        // is signed and the first index of a LOD is 32 bit.
+        if (vertexCount + block.vertices.size() > 0x7FFFFFFFull)
+            throw std::runtime_error(std::string(path) + " has too many vertices");
+        if (indexCount + block.indices.size() > 0xFFFFFFFFull)
+            throw std::runtime_error(std::string(path) + " has too many triangles");
+
+        meshlets = MeshletData{};
+        BuildMeshlets(block.vertices.data(), block.vertices.size(), block.indices.data(), block.indices.size(), meshlets);
+
+        Submesh submesh{};
+        submesh.firstLod = static_cast<u32>(model->lods.size());
+        submesh.lodCount = 1;
+        submesh.vertexOffset = static_cast<i32>(vertexCount);
+        submesh.vertexCount = static_cast<u32>(block.vertices.size());
+        submesh.object = block.object;
+        submesh.material = block.material;
+        submesh.bounds = ComputeBoundingSphere(block.vertices.data(), block.vertices.size());
+        model->submeshes.push_back(submesh);
+
+        MeshLod lod{ static_cast<u32>(indexCount), static_cast<u32>(block.indices.size()),
+            static_cast<u32>(model->meshlets.meshlets.size()), static_cast<u32>(meshlets.meshlets.size()), 0.0f };
+        model->lods.push_back(lod);
+        for (Meshlet meshlet : meshlets.meshlets)
+        {
+            meshlet.vertexOffset = 0;
+            meshlet.triangleOffset += lod.firstIndex;
+            model->meshlets.meshlets.push_back(meshlet);
+        }
+
+        // PackVertices also writes the constant color after the vertices, that
+        // slot is staged but not copied.
+        u64 vertexSize = model->layout.stride * block.vertices.size();
+        char* vertices = stage(*model, writer, GetPackedVertexSize(model->layout, block.vertices.size()), vertexCount * model->layout.stride, false);
+        model->stagedRanges.back().size = vertexSize;
+        PackVertices(model->layout, block.vertices.data(), block.vertices.size(), vertices);
+
+        char* indices = stage(*model, writer, GetPackedIndexSize(model->layout, block.indices.size()), indexCount * sizeof(u16), true);
+        PackIndices(model->layout, block.indices.data(), block.indices.size(), indices);
+
+        vertexCount += block.vertices.size();
+        indexCount += block.indices.size();
+    });
+
+    if (vertexCount > 0)
+    {
+        u8 white[4] = { 255, 255, 255, 255 };
+        memcpy(stage(*model, writer, sizeof(white), GetConstantColorOffset(model->layout, vertexCount), false), white, sizeof(white));
+    }
+
+    model->submeshData = model->submeshes.data();
+    model->submeshCount = static_cast<u32>(model->submeshes.size());
+    model->lodData = model->lods.data();
+    model->meshletData = model->meshlets.meshlets.data();
+    model->vertexCount = static_cast<u32>(vertexCount);
+    model->indexCount = static_cast<u32>(indexCount);
+
+    std::cout << path << ": streamed " << model->submeshCount << " blocks, " << vertexCount << " vertices, "
+        << indexCount / 3 << " triangles" << std::endl;
+    return model;
+}
+
+// Maps a mesh cache or cooked model, a cache is only used when it was built
+// from the expected dependencies.
+static bool openModelCache(ModelAsset& model, const std::string& cachePath, const AssetDependencies* expected,
+    const VertexPackingOptions& options)
+{
+    if (!model.cache.Open(cachePath, MODEL_CACHE_FLAGS))
+        return false;
+
+    if (expected && !SameDependencies(model.cache.GetDependencies(), *expected))
+    {
+        model.cache.Close();
+        return false;
+    }
+
+    model.submeshData = model.cache.GetSubmeshes();
+    model.submeshCount = model.cache.GetSubmeshCount();
+    model.lodData = model.cache.GetLods();
+    model.meshletData = model.cache.GetMeshlets();
+    model.vertexData = model.cache.GetVertices();
+    model.vertexCount = model.cache.GetVertexCount();
+    model.indexData = model.cache.GetIndices();
+    model.indexCount = model.cache.GetIndexCount();
+    model.layout = ChooseVertexLayout(model.vertexData, model.vertexCount, getLargestSubmeshVertexCount(model), options);
+    model.contentHash = getModelContentHash(model.cache.GetDependencies(), options);
+    return true;
+}
+
+std::unique_ptr<ModelAsset> LoadModel(ThreadPool& pool, const char* path, const VertexPackingOptions& options,
+    const StagingAllocator& staging, bool preferCooked)
+{
+    std::unique_ptr<ModelAsset> model = std::make_unique<ModelAsset>();
+    if (preferCooked && openModelCache(*model, GetCookedPath(path), nullptr, options))
+        return model;
+
+    if (hasExtension(path, ".glb"))
+        return loadGlbModel(pool, path, options);
+
+    // Mapped without prefetching until it is known not to be streamed, a
+    // streamed file is read in bounded windows and must not be pulled in whole.
+    MappedFile source;
+    if (!source.Open(path))
+        throw std::runtime_error(std::string("Failed to open ") + path);
+
+    if (staging && source.GetSize() >= OBJ_STREAM_THRESHOLD)
+    {
+        source.Close();
+        return streamObjModel(path, staging);
+    }
+    source.Advise(0, source.GetSize(), MAPPED_FILE_WILLNEED);
+
+    AssetDependencies dependencies{};
+    dependencies.count = 1;
+    dependencies.hashes[0] = MeshCache::HashSource(source.GetData(), source.GetSize());
+    if (openModelCache(*model, MeshCache::GetCachePath(path), &dependencies, options))
+        return model;
+
+    model = BuildObjModel(pool, path, source.GetData(), source.GetSize());
+
+    MeshCache::Write(MeshCache::GetCachePath(path), dependencies, MODEL_CACHE_FLAGS,
+        model->submeshes.data(), model->submeshes.size(),
+        model->lods.data(), model->lods.size(), model->meshlets,
+        model->vertices.data(), model->vertices.size(), model->indices.data(), model->indices.size());
+
+    finishModel(*model, options);
+    model->contentHash = getModelContentHash(dependencies, options);
+    std::cout << path << ": " << model->layout.stride << " bytes per vertex, "
+        << (model->layout.indexType == VK_INDEX_TYPE_UINT16 ? 16 : 32) << " bit indices, "
+        << "position error " << model->layout.positionError << ", UV error " << model->layout.texCoordError << std::endl;
+    return model;
+}
+
+std::unique_ptr<ModelAsset> BuildObjModel(ThreadPool& pool, const char* path, const char* data, size_t size)
+{
+    std::unique_ptr<ModelAsset> model = std::make_unique<ModelAsset>();
+
+#ifdef OBJ_PARSER_BENCHMARK
+    benchmarkObjParser(pool, path, data, size);
+#endif
+
+    ObjData obj;
+    ParseObj(pool, data, size, obj);
+
+    // Every object/material pair is welded, optimized and simplified on its own
+    // then appended to the shared buffers, with indices relative to its vertices.
+    std::vector<ObjGroup> groups = obj.groups;
+    std::stable_sort(groups.begin(), groups.end(),
+        [](const ObjGroup& a, const ObjGroup& b) { return a.material < b.material; });
+
+    std::vector<Vertex> vertices;
+    std::vector<u32> indices;
+    std::vector<MeshLod> lods;
+    double missesBefore = 0.0, missesAfter = 0.0;
+    size_t triangles = 0, verticesBefore = 0, verticesAfter = 0;
+
+    for (const ObjGroup& group : groups)
+    {
+        WeldObj(pool, obj, group, vertices, indices);
+
+        if (OPTIMIZE_MESHES)
+        {
+            triangles += indices.size() / 3;
+            verticesBefore += vertices.size();
+            missesBefore += AnalyzeVertexCache(indices.data(), indices.size(), vertices.size()).acmr * (indices.size() / 3);
+            OptimizeMesh(vertices, indices);
+            verticesAfter += vertices.size();
+            missesAfter += AnalyzeVertexCache(indices.data(), indices.size(), vertices.size()).acmr * (indices.size() / 3);
+        }
+
+        if (GENERATE_MESH_LODS)
+        {
+            BuildLodChain(vertices, indices, lods);
+
+            std::cout << path << " " << obj.objects[group.object] << "/" << obj.materials[group.material] << ":";
+            for (const MeshLod& lod : lods)
+                std::cout << " " << lod.indexCount / 3 << " (" << lod.error << ")";
+            std::cout << " triangles per LOD" << std::endl;
+        }
+        else
+        {
+            lods.assign(1, { 0, static_cast<u32>(indices.size()), 0, 0, 0.0f });
+        }
+
+        Submesh submesh{};
+        submesh.firstLod = static_cast<u32>(model->lods.size());
+        submesh.lodCount = static_cast<u32>(lods.size());
+        submesh.vertexOffset = static_cast<i32>(model->vertices.size());
+        submesh.vertexCount = static_cast<u32>(vertices.size());
+        submesh.object = group.object;
+        submesh.material = group.material;
+        submesh.bounds = ComputeBoundingSphere(vertices.data(), vertices.size());
+        model->submeshes.push_back(submesh);
+
+        u32 indexBase = static_cast<u32>(model->indices.size());
+        for (MeshLod& lod : lods)
+        {
+            lod.firstMeshlet = static_cast<u32>(model->meshlets.meshlets.size());
+            BuildMeshlets(vertices.data(), vertices.size(), indices.data() + lod.firstIndex, lod.indexCount, model->meshlets);
+            lod.meshletCount = static_cast<u32>(model->meshlets.meshlets.size()) - lod.firstMeshlet;
+            lod.firstIndex += indexBase;
+        }
+
+        model->lods.insert(model->lods.end(), lods.begin(), lods.end());
+        model->vertices.insert(model->vertices.end(), vertices.begin(), vertices.end());
+        model->indices.insert(model->indices.end(), indices.begin(), indices.end());
+    }
+
+    // Only LOD0 counts, the coarser levels follow it in model->indices.
+    if (OPTIMIZE_MESHES && triangles > 0)
+    {
+        std::cout << path << ": " << model->submeshes.size() << " submeshes, ACMR "
+            << missesBefore / triangles << " -> " << missesAfter / triangles
+            << ", ATVR " << missesBefore / verticesBefore << " -> " << missesAfter / verticesAfter << std::endl;
+    }
+
+    return model;
+}
+
+std::unique_ptr<TextureAsset> LoadTexture(const char* path, bool preferCooked, ThreadPool* mipPool, VkFormat format,
+    const StagingAllocator& staging)
+{
+    std::unique_ptr<TextureAsset> texture = std::make_unique<TextureAsset>();
+    const char* formatName = GetBlockFormatName(format);
+    if (preferCooked && formatName && texture->ktx2.Open(GetKtx2Path(path, formatName)) && texture->ktx2.GetFormat() == format)
+    {
+        texture->format = format;
+        texture->width = texture->ktx2.GetWidth();
+        texture->height = texture->ktx2.GetHeight();
+        texture->mipCount = texture->ktx2.GetMipCount();
+        texture->pixelData = texture->ktx2.GetData();
+        texture->pixelSize = texture->ktx2.GetDataSize();
+        for (u32 level = 0; level < texture->mipCount; level++)
+            texture->mipOffsets.push_back(texture->ktx2.GetMipOffset(level));
+        texture->contentHash = getTextureContentHash(texture->ktx2.GetDependencies(), texture->format, texture->mipCount);
+        return texture;
+    }
+
+    if (preferCooked && texture->cache.Open(GetCookedPath(path)) && texture->cache.GetFormat() == texture->format)
+    {
+        texture->width = texture->cache.GetWidth();
+        texture->height = texture->cache.GetHeight();
+        texture->mipCount = texture->cache.GetMipCount();
+        texture->pixelData = texture->cache.GetData();
+        texture->pixelSize = texture->cache.GetDataSize();
+        texture->contentHash = getTextureContentHash(texture->cache.GetDependencies(), texture->format, texture->mipCount);
+        return texture;
+    }
+
+    MappedFile source;
+    if (!source.Open(path, MAPPED_FILE_SEQUENTIAL))
+        throw std::runtime_error(std::string("Failed to open ") + path);
+
+    AssetDependencies dependencies{};
+    dependencies.hashes[dependencies.count++] = Hash64(source.GetData(), source.GetSize(), TEXTURE_CACHE_VERSION);
+    texture = DecodeTexture(path, source.GetData(), source.GetSize(), mipPool ? StagingAllocator() : staging);
+    if (mipPool)
+    {
+        texture->mipCount = GetMipCount(texture->width, texture->height);
+        std::vector<u8> chain;
+        BuildMipChain(*mipPool, texture->pixelData, texture->width, texture->height, texture->mipCount, chain);
+        texture->pixels = std::move(chain);
+        texture->pixelData = texture->pixels.data();
+        texture->pixelSize = texture->pixels.size();
+    }
+    texture->contentHash = getTextureContentHash(dependencies, texture->format, texture->mipCount);
+    return texture;
+}
+
+// Grey and grey-alpha images are rare enough to stay scalar.
+static void expandToRgba(const u8* source, u32 channels, u8* destination, size_t pixelCount)
+{
+    if (channels == 4)
+    {
+        memcpy(destination, source, pixelCount * 4);
+        return;
+    }
+    if (channels == 3)
+    {
+        ExpandRgbToRgba(source, destination, pixelCount);
+        return;
+    }
+
+    for (size_t i = 0; i < pixelCount; i++, source += channels, destination += 4)
+    {
+        destination[0] = destination[1] = destination[2] = source[0];
+        destination[3] = channels == 2 ? source[1] : 255;
+    }
+}
+
+// stb_image keeps the channels of the file, the conversion to RGBA8 writes
+// straight into staging memory when there is an allocator.
+std::unique_ptr<TextureAsset> DecodeTexture(const char* path, const char* data, size_t size, const StagingAllocator& staging)
+{
+    int texWidth, texHeight, texChannels;
+    stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(data), static_cast<int>(size),
+        &texWidth, &texHeight, &texChannels, 0);
+    if (!pixels) throw std::runtime_error(std::string("Failed to load texture image ") + path);
+
+    std::unique_ptr<TextureAsset> texture = std::make_unique<TextureAsset>();
+    texture->width = static_cast<u32>(texWidth);
+    texture->height = static_cast<u32>(texHeight);
+    texture->pixelSize = static_cast<size_t>(texWidth) * texHeight * 4;
+
+    u8* destination;
+    try
+    {
+        if (staging)
+        {
+            destination = static_cast<u8*>(staging(texture->pixelSize, texture->stagingBuffer));
+            texture->staged = true;
+        }
+        else
+        {
+            texture->pixels.resize(texture->pixelSize);
+            destination = texture->pixels.data();
+            texture->pixelData = destination;
+        }
+    }
+    catch (...)
+    {
+        stbi_image_free(pixels);
+        throw;
+    }
+
+    expandToRgba(pixels, static_cast<u32>(texChannels), destination, static_cast<size_t>(texWidth) * texHeight);
+    stbi_image_free(pixels);
+
+#ifdef PIXEL_CONVERSION_BENCHMARK
+    BenchmarkPixelConversion(destination, static_cast<size_t>(texWidth) * texHeight);
+#endif
+    return texture;
+}
+
+bool GetTextureSize(const char* data, size_t size, u32& width, u32& height)
+{
+    int texWidth, texHeight, texChannels;
+    if (!stbi_info_from_memory(reinterpret_cast<const stbi_uc*>(data), static_cast<int>(size), &texWidth, &texHeight, &texChannels))
+        return false;
+    width = static_cast<u32>(texWidth);
+    height = static_cast<u32>(texHeight);
+    return true;
+}
+
+AssetHandle<ModelAsset> LoadModelAsync(ThreadPool& pool, const std::string& path, const VertexPackingOptions& options,
+    const StagingAllocator& staging, bool preferCooked)
+{
+    ThreadPool* workers = &pool;
+    return AssetHandle<ModelAsset>(pool.Submit([workers, path, options, staging, preferCooked]()
+    {
+        return LoadModel(*workers, path.c_str(), options, staging, preferCooked);
+    }));
+}
+
+static double millisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+AssetHandle<TextureAsset> LoadTextureAsync(ThreadPool& pool, const std::string& path, bool preferCooked, bool buildMips, VkFormat format,
+    const StagingAllocator& staging)
+{
+    ThreadPool* mipPool = buildMips ? &pool : nullptr;
+    return AssetHandle<TextureAsset>(pool.Submit([path, preferCooked, mipPool, format, staging]()
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::unique_ptr<TextureAsset> texture = LoadTexture(path.c_str(), preferCooked, mipPool, format, staging);
+        texture->loadMilliseconds = millisecondsSince(start);
+        return texture;
+    }));
+}
+
+// State shared by the callbacks of one texture read.
+typedef struct TextureRead
+{
+    std::promise<std::unique_ptr<TextureAsset>> promise;
+    std::unique_ptr<TextureAsset> texture;
+    TextureCacheHeader header;
+    std::chrono::high_resolution_clock::time_point start;
+} TextureRead;
+
+// The time of the failed read counts towards the load.
+static void loadTextureOnPool(ThreadPool& pool, const std::string& path, bool buildMips, const std::shared_ptr<TextureRead>& read)
+{
+    ThreadPool* mipPool = buildMips ? &pool : nullptr;
+    pool.Submit([path, mipPool, read]()
+    {
+        try
+        {
+            std::unique_ptr<TextureAsset> texture = LoadTexture(path.c_str(), PREFER_COOKED_ASSETS, mipPool);
+            texture->loadMilliseconds = millisecondsSince(read->start);
+            read->promise.set_value(std::move(texture));
+        }
+        catch (...)
+        {
+            read->promise.set_exception(std::current_exception());
+        }
+    });
+}
+
+AssetHandle<TextureAsset> LoadTextureAsync(ThreadPool& pool, AsyncIo& io, const std::string& path,
+    const StagingAllocator& staging, bool preferCooked, bool buildMips, VkFormat format)
+{
+    // KTX2 files are mapped on the pool, with the fallbacks behind them.
+    std::string cookedPath = GetCookedPath(path.c_str());
+    if (!preferCooked || !staging || GetBlockFormatName(format) || IsArchivedFile(cookedPath))
+        return LoadTextureAsync(pool, path, preferCooked, buildMips, format, staging);
+
+    std::shared_ptr<TextureRead> read = std::make_shared<TextureRead>();
+    read->texture = std::make_unique<TextureAsset>();
+    read->start = std::chrono::high_resolution_clock::now();
+    AssetHandle<TextureAsset> handle(read->promise.get_future());
+
+    ThreadPool* workers = &pool;
+    AsyncIo* reader = &io;
+    io.Read(cookedPath, 0, sizeof(TextureCacheHeader), &read->header, [workers, reader, path, cookedPath, staging, buildMips, read](bool success)
+    {
+        TextureAsset& texture = *read->texture;
+        const TextureCacheHeader& header = read->header;
+        if (!success || !TextureCache::IsValidHeader(header) || static_cast<VkFormat>(header.format) != texture.format)
+        {
+            loadTextureOnPool(*workers, path, buildMips, read);
+            return;
+        }
+
+        texture.width = header.width;
+        texture.height = header.height;
+        texture.mipCount = header.mipCount;
+        texture.pixelSize = static_cast<size_t>(header.dataSize);
+        texture.contentHash = getTextureContentHash(header.dependencies, texture.format, header.mipCount);
+        texture.staged = true;
+
+        void* destination;
+        try
+        {
+            destination = staging(texture.pixelSize, texture.stagingBuffer);
+        }
+        catch (...)
+        {
+            read->promise.set_exception(std::current_exception());
+            return;
+        }
+
+        // A failed read leaves the staging buffer to be freed with the others.
+        reader->Read(cookedPath, sizeof(TextureCacheHeader), texture.pixelSize, destination, [workers, path, buildMips, read](bool success)
+        {
+            if (success)
+            {
+                read->texture->loadMilliseconds = millisecondsSince(read->start);
+                read->promise.set_value(std::move(read->texture));
+            }
+            else
+                loadTextureOnPool(*workers, path, buildMips, read);
+        });
+    });
+    return handle;
+}
+
+void PackModelVertices(const ModelAsset& model, void* destination)
+{
+    if (model.vertexData)
+        PackVertices(model.layout, model.vertexData, model.vertexCount, destination);
+    else
+        PackVertices(model.layout, [&model](u32 i) { return fetchGlbModelVertex(model, i); }, model.vertexCount, destination);
+}
+
+void PackModelIndices(const ModelAsset& model, void* destination)
+{
+    if (model.indexData)
+    {
+        PackIndices(model.layout, model.indexData, model.indexCount, destination);
+        return;
+    }
+
+    size_t indexSize = GetPackedIndexSize(model.layout, 1);
+    for (u32 i = 0; i < model.submeshCount; i++)
+    {
+        const MeshLod& lod = model.lodData[model.submeshData[i].firstLod];
+        CopyGlbIndices(model.primitives[i].indices, model.layout.indexType, static_cast<char*>(destination) + lod.firstIndex * indexSize);
+    }
+}
+
+// A cube with one quad per face, going through the same LOD and meshlet setup
+// as a real model so the renderer needs no special case for it.
+std::unique_ptr<ModelAsset> MakePlaceholderModel(const VertexPackingOptions& options)
+{
+    std::unique_ptr<ModelAsset> model = std::make_unique<ModelAsset>();
+    const float halfSize = PLACEHOLDER_MODEL_SIZE * 0.5f;
+
+    for (u32 axis = 0; axis < 3; axis++)
+    {
+        for (float sign : { -1.0f, 1.0f })
+        {
+            glm::vec3 normal(0.0f), u(0.0f), v(0.0f);
+            normal[axis] = sign * halfSize;
+            u[(axis + 1) % 3] = halfSize;
+            v[(axis + 2) % 3] = halfSize;
+
+            u32 base = static_cast<u32>(model->vertices.size());
+            const glm::vec2 corners[4] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+            for (const glm::vec2& corner : corners)
+            {
+                Vertex vertex{};
+                vertex.pos = normal + (corner.x * 2.0f - 1.0f) * u + (corner.y * 2.0f - 1.0f) * v;
+                vertex.color = { 1.0f, 1.0f, 1.0f };
+                vertex.texCoord = corner;
+                model->vertices.push_back(vertex);
+            }
+
+            // u x v points along +axis, so negative faces are wound the other way.
+            const u32 positive[6] = { 0, 1, 2, 0, 2, 3 };
+            const u32 negative[6] = { 0, 2, 1, 0, 3, 2 };
+            for (u32 i = 0; i < 6; i++)
+                model->indices.push_back(base + (sign > 0.0f ? positive[i] : negative[i]));
+        }
+    }
+
+    MeshLod lod{ 0, static_cast<u32>(model->indices.size()), 0, 0, 0.0f };
+    BuildMeshlets(model->vertices.data(), model->vertices.size(), model->indices.data(), lod.indexCount, model->meshlets);
+    lod.meshletCount = static_cast<u32>(model->meshlets.meshlets.size());
+    model->lods.push_back(lod);
+
+    Submesh submesh{};
+    submesh.firstLod = 0;
+    submesh.lodCount = 1;
+    submesh.vertexOffset = 0;
+    submesh.vertexCount = static_cast<u32>(model->vertices.size());
+    submesh.bounds = ComputeBoundingSphere(model->vertices.data(), model->vertices.size());
+    model->submeshes.push_back(submesh);
+
+    finishModel(*model, options);
+    return model;
+}
+
+std::unique_ptr<TextureAsset> MakePlaceholderTexture()
+{
+    std::unique_ptr<TextureAsset> texture = std::make_unique<TextureAsset>();
+    texture->width = 2;
+    texture->height = 2;
+    texture->pixels =
+    {
+        160, 160, 160, 255,  96,  96,  96, 255,
+         96,  96,  96, 255, 160, 160, 160, 255,
+    };
+    texture->pixelData = texture->pixels.data();
+    texture->pixelSize = texture->pixels.size();
+    return texture;
+}
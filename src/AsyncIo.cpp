@@ -0,0 +1,483 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <cerrno>
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include <AsyncIo.hpp>
+
+#ifdef _WIN32
+typedef HANDLE FileHandle;
+static const FileHandle invalidFile = INVALID_HANDLE_VALUE;
+#else
+typedef int FileHandle;
+static const FileHandle invalidFile = -1;
+#endif
+
+struct AsyncRead
+{
+    FileHandle file;
+    std::atomic<u32> remaining;
+    std::atomic<bool> failed;
+    ReadCallback done;
+};
+
+static FileHandle openForRead(const std::string& path)
+{
+#ifdef _WIN32
+    return CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+    return open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+}
+
+static void closeFile(FileHandle file)
+{
+#ifdef _WIN32
+    CloseHandle(file);
+#else
+    close(file);
+#endif
+}
+
+// Blocking read of a whole piece, false when the file ends before it.
+static bool readAt(FileHandle file, u64 offset, size_t size, char* destination)
+{
+    while (size > 0)
+    {
+#ifdef _WIN32
+        OVERLAPPED overlapped{};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD bytesRead = 0;
+        if (!ReadFile(file, destination, static_cast<DWORD>(size), &bytesRead, &overlapped) || bytesRead == 0)
+            return false;
+#else
+        ssize_t bytesRead = pread(file, destination, size, static_cast<off_t>(offset));
+        if (bytesRead < 0 && errno == EINTR)
+            continue;
+        if (bytesRead <= 0)
+            return false;
+#endif
+        offset += bytesRead;
+        destination += bytesRead;
+        size -= bytesRead;
+    }
+    return true;
+}
+
+#ifdef __linux__
+// The rings shared with the kernel. Only the ring thread touches them, other
+// threads hand it pieces through m_pending and wake it through the eventfd,
+// which always has a read queued on the ring.
+struct IoUring
+{
+    int ring = -1;
+    int wake = -1;
+    u64 wakeValue = 0;
+    bool buffers = false;
+    u32 capacity = 0;
+    u32 inFlight = 0;
+
+    void* sqRing = MAP_FAILED;
+    size_t sqRingSize = 0;
+    void* cqRing = MAP_FAILED;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesSize = 0;
+
+    u32* sqHead;
+    u32* sqTail;
+    u32 sqMask;
+    u32* sqArray;
+    u32* cqHead;
+    u32* cqTail;
+    u32 cqMask;
+    io_uring_cqe* cqes;
+};
+
+static void queueEntry(IoUring& ring, u8 opcode, int file, void* destination, u32 size, u64 offset, u64 userData, i32 buffer)
+{
+    u32 tail = *ring.sqTail;
+    u32 index = tail & ring.sqMask;
+
+    io_uring_sqe& entry = ring.sqes[index];
+    memset(&entry, 0, sizeof(entry));
+    entry.opcode = opcode;
+    entry.fd = file;
+    entry.addr = reinterpret_cast<u64>(destination);
+    entry.len = size;
+    entry.off = offset;
+    entry.user_data = userData;
+    if (buffer >= 0)
+        entry.buf_index = static_cast<u16>(buffer);
+
+    ring.sqArray[index] = index;
+    __atomic_store_n(ring.sqTail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static void wakeRing(IoUring& ring)
+{
+    u64 value = 1;
+    while (write(ring.wake, &value, sizeof(value)) < 0 && errno == EINTR)
+        ;
+}
+#endif
+
+AsyncIo::~AsyncIo()
+{
+    Destroy();
+}
+
+void AsyncIo::Create(ThreadPool& pool, u32 queueDepth)
+{
+    Destroy();
+
+    m_pool = &pool;
+    m_stopping = false;
+    if (createRing(std::max(queueDepth, 1u)))
+        m_thread = std::thread(&AsyncIo::ringLoop, this);
+}
+
+void AsyncIo::Destroy()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle.wait(lock, [this]() { return m_outstanding == 0; });
+        m_stopping = true;
+    }
+
+#ifdef __linux__
+    if (m_thread.joinable())
+    {
+        wakeRing(*m_ring);
+        m_thread.join();
+    }
+#endif
+    destroyRing();
+    m_pool = nullptr;
+}
+
+bool AsyncIo::IsUringBacked() const
+{
+    return m_ring != nullptr;
+}
+
+bool AsyncIo::RegisterBuffer(void* data, size_t size)
+{
+#ifdef __linux__
+    if (!m_ring || !m_ring->buffers || !data || size == 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_buffersMutex);
+    auto slot = std::find_if(m_buffers.begin(), m_buffers.end(), [](const RegisteredBuffer& buffer) { return !buffer.data; });
+    if (slot == m_buffers.end())
+        return false;
+
+    iovec vector{ data, size };
+    io_uring_rsrc_update2 update{};
+    update.offset = static_cast<u32>(slot - m_buffers.begin());
+    update.data = reinterpret_cast<u64>(&vector);
+    update.nr = 1;
+    if (syscall(__NR_io_uring_register, m_ring->ring, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update)) != 1)
+        return false;
+
+    *slot = { static_cast<char*>(data), size };
+    return true;
+#else
+    (void)data;
+    (void)size;
+    return false;
+#endif
+}
+
+void AsyncIo::UnregisterBuffer(void* data)
+{
+#ifdef __linux__
+    if (!m_ring || !data)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_buffersMutex);
+    auto slot = std::find_if(m_buffers.begin(), m_buffers.end(), [data](const RegisteredBuffer& buffer) { return buffer.data == data; });
+    if (slot == m_buffers.end())
+        return;
+
+    iovec vector{ nullptr, 0 };
+    io_uring_rsrc_update2 update{};
+    update.offset = static_cast<u32>(slot - m_buffers.begin());
+    update.data = reinterpret_cast<u64>(&vector);
+    update.nr = 1;
+    syscall(__NR_io_uring_register, m_ring->ring, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update));
+    *slot = {};
+#else
+    (void)data;
+#endif
+}
+
+void AsyncIo::Read(const std::string& path, u64 offset, size_t size, void* destination, ReadCallback done)
+{
+    FileHandle file = openForRead(path);
+    if (file == invalidFile)
+    {
+        done(false);
+        return;
+    }
+    if (size == 0)
+    {
+        closeFile(file);
+        done(true);
+        return;
+    }
+
+    u32 pieceCount = static_cast<u32>((size + ASYNC_IO_MAX_READ_SIZE - 1) / ASYNC_IO_MAX_READ_SIZE);
+    AsyncRead* read = new AsyncRead{ file, { pieceCount }, { false }, std::move(done) };
+
+    std::vector<ReadPiece> pieces(pieceCount);
+    for (u32 i = 0; i < pieceCount; i++)
+    {
+        size_t pieceOffset = static_cast<size_t>(i) * ASYNC_IO_MAX_READ_SIZE;
+        pieces[i] = { read, offset + pieceOffset, std::min<size_t>(size - pieceOffset, ASYNC_IO_MAX_READ_SIZE),
+            static_cast<char*>(destination) + pieceOffset };
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_outstanding++;
+        if (m_ring)
+            m_pending.insert(m_pending.end(), pieces.begin(), pieces.end());
+    }
+
+#ifdef __linux__
+    if (m_ring)
+    {
+        wakeRing(*m_ring);
+        return;
+    }
+#endif
+    for (const ReadPiece& piece : pieces)
+        m_pool->Submit([this, piece]() { readPiece(piece); });
+}
+
+bool AsyncIo::createRing(u32 queueDepth)
+{
+#ifdef __linux__
+    IoUring* ring = new IoUring();
+    m_ring = ring;
+
+    // One entry more for the eventfd read. The completion ring is twice the
+    // size, so holding capacity reads in flight can never overflow it.
+    io_uring_params params{};
+    ring->ring = static_cast<int>(syscall(__NR_io_uring_setup, queueDepth + 1, &params));
+    ring->wake = eventfd(0, EFD_CLOEXEC);
+    if (ring->ring < 0 || ring->wake < 0)
+    {
+        destroyRing();
+        return false;
+    }
+
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(u32);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        ring->sqRingSize = ring->cqRingSize = std::max(ring->sqRingSize, ring->cqRingSize);
+
+    ring->sqRing = mmap(nullptr, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring, IORING_OFF_SQ_RING);
+    if (ring->sqRing != MAP_FAILED && !(params.features & IORING_FEAT_SINGLE_MMAP))
+        ring->cqRing = mmap(nullptr, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring, IORING_OFF_CQ_RING);
+    ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    ring->sqes = static_cast<io_uring_sqe*>(mmap(nullptr, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring, IORING_OFF_SQES));
+
+    char* cq = static_cast<char*>(params.features & IORING_FEAT_SINGLE_MMAP ? ring->sqRing : ring->cqRing);
+    if (ring->sqRing == MAP_FAILED || cq == MAP_FAILED || ring->sqes == MAP_FAILED)
+    {
+        destroyRing();
+        return false;
+    }
+
+    char* sq = static_cast<char*>(ring->sqRing);
+    ring->sqHead = reinterpret_cast<u32*>(sq + params.sq_off.head);
+    ring->sqTail = reinterpret_cast<u32*>(sq + params.sq_off.tail);
+    ring->sqMask = *reinterpret_cast<u32*>(sq + params.sq_off.ring_mask);
+    ring->sqArray = reinterpret_cast<u32*>(sq + params.sq_off.array);
+    ring->cqHead = reinterpret_cast<u32*>(cq + params.cq_off.head);
+    ring->cqTail = reinterpret_cast<u32*>(cq + params.cq_off.tail);
+    ring->cqMask = *reinterpret_cast<u32*>(cq + params.cq_off.ring_mask);
+    ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    ring->capacity = std::min(params.sq_entries - 1, params.cq_entries / 2);
+
+    // An empty table that RegisterBuffer fills in slot by slot, older kernels
+    // just read without registered buffers.
+    io_uring_rsrc_register registration{};
+    registration.nr = ASYNC_IO_MAX_BUFFERS;
+    registration.flags = IORING_RSRC_REGISTER_SPARSE;
+    ring->buffers = syscall(__NR_io_uring_register, ring->ring, IORING_REGISTER_BUFFERS2, &registration, sizeof(registration)) == 0;
+    m_buffers.assign(ring->buffers ? ASYNC_IO_MAX_BUFFERS : 0, RegisteredBuffer{});
+    return true;
+#else
+    (void)queueDepth;
+    return false;
+#endif
+}
+
+void AsyncIo::destroyRing()
+{
+#ifdef __linux__
+    if (!m_ring)
+        return;
+
+    if (m_ring->sqes != MAP_FAILED)
+        munmap(m_ring->sqes, m_ring->sqesSize);
+    if (m_ring->cqRing != MAP_FAILED)
+        munmap(m_ring->cqRing, m_ring->cqRingSize);
+    if (m_ring->sqRing != MAP_FAILED)
+        munmap(m_ring->sqRing, m_ring->sqRingSize);
+    if (m_ring->wake >= 0)
+        close(m_ring->wake);
+    if (m_ring->ring >= 0)
+        close(m_ring->ring);
+
+    delete m_ring;
+    m_ring = nullptr;
+    m_buffers.clear();
+#endif
+}
+
+void AsyncIo::ringLoop()
+{
+#ifdef __linux__
+    IoUring& ring = *m_ring;
+    bool wakeQueued = false;
+
+    while (true)
+    {
+        u32 submitCount = 0;
+        if (!wakeQueued)
+        {
+            queueEntry(ring, IORING_OP_READ, ring.wake, &ring.wakeValue, sizeof(ring.wakeValue), 0, 0, -1);
+            wakeQueued = true;
+            submitCount++;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopping)
+                break;
+
+            while (!m_pending.empty() && ring.inFlight < ring.capacity)
+            {
+                submitPiece(m_pending.front());
+                m_pending.pop_front();
+                submitCount++;
+            }
+        }
+
+        // Submits everything queued and sleeps until something completes.
+        while (syscall(__NR_io_uring_enter, ring.ring, submitCount, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno == EINTR)
+            ;
+
+        std::vector<std::pair<ReadPiece*, i32>> completions;
+        u32 head = *ring.cqHead;
+        u32 tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++)
+        {
+            const io_uring_cqe& completion = ring.cqes[head & ring.cqMask];
+            if (completion.user_data == 0)
+                wakeQueued = false;
+            else
+                completions.push_back({ reinterpret_cast<ReadPiece*>(completion.user_data), completion.res });
+        }
+        __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+
+        // Short and interrupted reads go back to the front of the queue for
+        // the rest of their range.
+        for (auto& completion : completions)
+        {
+            ReadPiece* piece = completion.first;
+            i32 result = completion.second;
+            ring.inFlight--;
+
+            bool retry = result == -EINTR || result == -EAGAIN;
+            if (result > 0 && static_cast<size_t>(result) < piece->size)
+            {
+                piece->offset += result;
+                piece->destination += result;
+                piece->size -= result;
+                retry = true;
+            }
+
+            if (retry)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_pending.push_front(*piece);
+            }
+            else
+            {
+                finishPiece(piece->read, result >= 0 && static_cast<size_t>(result) == piece->size);
+            }
+            delete piece;
+        }
+    }
+#endif
+}
+
+// Called with m_mutex held, from the ring thread.
+void AsyncIo::submitPiece(const ReadPiece& piece)
+{
+#ifdef __linux__
+    i32 buffer = -1;
+    {
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        for (size_t i = 0; i < m_buffers.size() && buffer < 0; i++)
+        {
+            const RegisteredBuffer& registered = m_buffers[i];
+            if (registered.data && piece.destination >= registered.data &&
+                piece.destination + piece.size <= registered.data + registered.size)
+                buffer = static_cast<i32>(i);
+        }
+    }
+
+    queueEntry(*m_ring, buffer >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ, piece.read->file, piece.destination,
+        static_cast<u32>(piece.size), piece.offset, reinterpret_cast<u64>(new ReadPiece(piece)), buffer);
+    m_ring->inFlight++;
+#else
+    (void)piece;
+#endif
+}
+
+void AsyncIo::finishPiece(AsyncRead* read, bool success)
+{
+    if (!success)
+        read->failed = true;
+    if (read->remaining.fetch_sub(1) != 1)
+        return;
+
+    closeFile(read->file);
+    read->done(!read->failed);
+    delete read;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_outstanding--;
+    }
+    m_idle.notify_all();
+}
+
+void AsyncIo::readPiece(const ReadPiece& piece)
+{
+    finishPiece(piece.read, readAt(piece.read->file, piece.offset, piece.size, piece.destination));
+}
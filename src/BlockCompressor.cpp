@@ -0,0 +1,488 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include <BlockCompressor.hpp>
+#include <TextureCache.hpp>
+
+// Weights of the second endpoint for BC1's 4 color mode and BC7's 4 bit
+// indices.
+static const float bc1Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+static const u32 bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+typedef struct BitWriter
+{
+    u8* data;
+    u32 position;
+} BitWriter;
+
+static void writeBits(BitWriter& writer, u32 value, u32 count)
+{
+    for (u32 i = 0; i < count; i++, writer.position++)
+        if ((value >> i) & 1)
+            writer.data[writer.position >> 3] |= static_cast<u8>(1u << (writer.position & 7));
+}
+
+u32 GetBlockSize(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        return 8;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+const char* GetBlockFormatName(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        return "bc1";
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+        return "bc3";
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return "bc7";
+    default:
+        return nullptr;
+    }
+}
+
+VkFormat GetBlockFormat(const char* name)
+{
+    for (VkFormat format : { VK_FORMAT_BC1_RGB_SRGB_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK })
+        if (strcmp(name, GetBlockFormatName(format)) == 0)
+            return format;
+    return VK_FORMAT_UNDEFINED;
+}
+
+static void fetchBlock(const u8* pixels, u32 width, u32 height, u32 blockX, u32 blockY, u8 block[64])
+{
+    for (u32 y = 0; y < 4; y++)
+    {
+        u32 sourceY = std::min(blockY * 4 + y, height - 1);
+        for (u32 x = 0; x < 4; x++)
+        {
+            u32 sourceX = std::min(blockX * 4 + x, width - 1);
+            memcpy(block + (y * 4 + x) * 4, pixels + (static_cast<size_t>(sourceY) * width + sourceX) * 4, 4);
+        }
+    }
+}
+
+// Ends of the segment through the block's first channelCount channels along
+// their principal axis, which a few power iterations on the covariance find.
+// A flat block gives two equal ends.
+static void getEndpoints(const u8 block[64], u32 channelCount, float endpoints[2][4])
+{
+    float mean[4] = {};
+    for (u32 i = 0; i < 16; i++)
+        for (u32 c = 0; c < channelCount; c++)
+            mean[c] += block[i * 4 + c] / 16.0f;
+
+    float covariance[4][4] = {};
+    for (u32 i = 0; i < 16; i++)
+        for (u32 a = 0; a < channelCount; a++)
+            for (u32 b = 0; b < channelCount; b++)
+                covariance[a][b] += (block[i * 4 + a] - mean[a]) * (block[i * 4 + b] - mean[b]);
+
+    u32 largest = 0;
+    for (u32 c = 1; c < channelCount; c++)
+        if (covariance[c][c] > covariance[largest][largest])
+            largest = c;
+
+    float axis[4] = {};
+    for (u32 c = 0; c < channelCount; c++)
+        axis[c] = covariance[largest][c];
+    for (u32 iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {};
+        float scale = 0.0f;
+        for (u32 a = 0; a < channelCount; a++)
+        {
+            for (u32 b = 0; b < channelCount; b++)
+                next[a] += covariance[a][b] * axis[b];
+            scale = std::max(scale, std::abs(next[a]));
+        }
+        if (scale == 0.0f)
+            break;
+        for (u32 c = 0; c < channelCount; c++)
+            axis[c] = next[c] / scale;
+    }
+
+    float length = 0.0f;
+    for (u32 c = 0; c < channelCount; c++)
+        length += axis[c] * axis[c];
+    length = std::sqrt(length);
+
+    float lowest = 0.0f, highest = 0.0f;
+    if (length > 0.0f)
+    {
+        for (u32 c = 0; c < channelCount; c++)
+            axis[c] /= length;
+
+        lowest = FLT_MAX;
+        highest = -FLT_MAX;
+        for (u32 i = 0; i < 16; i++)
+        {
+            float t = 0.0f;
+            for (u32 c = 0; c < channelCount; c++)
+                t += (block[i * 4 + c] - mean[c]) * axis[c];
+            lowest = std::min(lowest, t);
+            highest = std::max(highest, t);
+        }
+    }
+
+    for (u32 c = 0; c < channelCount; c++)
+    {
+        endpoints[0][c] = mean[c] + axis[c] * highest;
+        endpoints[1][c] = mean[c] + axis[c] * lowest;
+    }
+}
+
+// Least squares endpoints for the chosen indices, false when they all picked
+// the same weight and leave the endpoints undetermined.
+static bool solveEndpoints(const u8 block[64], u32 channelCount, const u8 indices[16], const float* weights, float endpoints[2][4])
+{
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = {}, bx[4] = {};
+    for (u32 i = 0; i < 16; i++)
+    {
+        float b = weights[indices[i]], a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (u32 c = 0; c < channelCount; c++)
+        {
+            ax[c] += a * block[i * 4 + c];
+            bx[c] += b * block[i * 4 + c];
+        }
+    }
+
+    float determinant = aa * bb - ab * ab;
+    if (std::abs(determinant) < 1e-6f)
+        return false;
+
+    for (u32 c = 0; c < channelCount; c++)
+    {
+        endpoints[0][c] = std::min(std::max((bb * ax[c] - ab * bx[c]) / determinant, 0.0f), 255.0f);
+        endpoints[1][c] = std::min(std::max((aa * bx[c] - ab * ax[c]) / determinant, 0.0f), 255.0f);
+    }
+    return true;
+}
+
+static u16 packRgb565(const float color[4])
+{
+    u32 r = static_cast<u32>(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    u32 g = static_cast<u32>(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+    u32 b = static_cast<u32>(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    return static_cast<u16>((r << 11) | (g << 5) | b);
+}
+
+static void unpackRgb565(u16 packed, i32 color[3])
+{
+    i32 r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// Picks the closest of the 4 color mode's palette for every texel and returns
+// the total squared error.
+static u32 fitColorIndices(const u8 block[64], u16 color0, u16 color1, u8 indices[16])
+{
+    i32 palette[4][3];
+    unpackRgb565(color0, palette[0]);
+    unpackRgb565(color1, palette[1]);
+    for (u32 c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    u32 error = 0;
+    for (u32 i = 0; i < 16; i++)
+    {
+        u32 best = UINT32_MAX;
+        for (u8 index = 0; index < 4; index++)
+        {
+            u32 distance = 0;
+            for (u32 c = 0; c < 3; c++)
+            {
+                i32 difference = block[i * 4 + c] - palette[index][c];
+                distance += static_cast<u32>(difference * difference);
+            }
+            if (distance < best)
+            {
+                best = distance;
+                indices[i] = index;
+            }
+        }
+        error += best;
+    }
+    return error;
+}
+
+// The 8 byte color block shared by BC1 and BC3, always in 4 color mode.
+static void encodeColorBlock(const u8 block[64], u8* output)
+{
+    float endpoints[2][4];
+    getEndpoints(block, 3, endpoints);
+    u16 color0 = packRgb565(endpoints[0]), color1 = packRgb565(endpoints[1]);
+
+    u8 indices[16];
+    u32 error = fitColorIndices(block, color0, color1, indices);
+    for (u32 iteration = 0; iteration < 2 && error > 0; iteration++)
+    {
+        if (!solveEndpoints(block, 3, indices, bc1Weights, endpoints))
+            break;
+
+        u16 refined0 = packRgb565(endpoints[0]), refined1 = packRgb565(endpoints[1]);
+        u8 refinedIndices[16];
+        u32 refinedError = fitColorIndices(block, refined0, refined1, refinedIndices);
+        if (refinedError >= error)
+            break;
+
+        color0 = refined0;
+        color1 = refined1;
+        error = refinedError;
+        memcpy(indices, refinedIndices, sizeof(indices));
+    }
+
+    // A first color that isn't larger selects the 3 color mode, equal colors
+    // need index 0 everywhere for it.
+    if (color0 < color1)
+    {
+        std::swap(color0, color1);
+        for (u8& index : indices)
+            index ^= 1;
+    }
+    else if (color0 == color1)
+    {
+        memset(indices, 0, sizeof(indices));
+    }
+
+    u32 bits = 0;
+    for (u32 i = 0; i < 16; i++)
+        bits |= static_cast<u32>(indices[i]) << (i * 2);
+
+    output[0] = static_cast<u8>(color0);
+    output[1] = static_cast<u8>(color0 >> 8);
+    output[2] = static_cast<u8>(color1);
+    output[3] = static_cast<u8>(color1 >> 8);
+    memcpy(output + 4, &bits, 4);
+}
+
+// BC3's alpha block in its 8 value mode, between the block's extremes.
+static void encodeAlphaBlock(const u8 block[64], u8* output)
+{
+    u8 lowest = 255, highest = 0;
+    for (u32 i = 0; i < 16; i++)
+    {
+        lowest = std::min(lowest, block[i * 4 + 3]);
+        highest = std::max(highest, block[i * 4 + 3]);
+    }
+
+    u64 bits = 0;
+    if (highest > lowest)
+    {
+        i32 palette[8] = { highest, lowest };
+        for (i32 i = 2; i < 8; i++)
+            palette[i] = ((8 - i) * highest + (i - 1) * lowest + 3) / 7;
+
+        for (u32 i = 0; i < 16; i++)
+        {
+            u32 best = 0;
+            for (u32 index = 1; index < 8; index++)
+                if (std::abs(block[i * 4 + 3] - palette[index]) < std::abs(block[i * 4 + 3] - palette[best]))
+                    best = index;
+            bits |= static_cast<u64>(best) << (i * 3);
+        }
+    }
+
+    output[0] = highest;
+    output[1] = lowest;
+    for (u32 i = 0; i < 6; i++)
+        output[2 + i] = static_cast<u8>(bits >> (i * 8));
+}
+
+// Endpoints of BC7 mode 6 are 7 bits per channel plus a shared lowest bit,
+// chosen per endpoint to fit all four channels best.
+static void quantizeBc7Endpoint(const float endpoint[4], u8 quantized[4], u32& pBit)
+{
+    float bestError = FLT_MAX;
+    for (u32 bit = 0; bit < 2; bit++)
+    {
+        u8 candidate[4];
+        float error = 0.0f;
+        for (u32 c = 0; c < 4; c++)
+        {
+            i32 value = static_cast<i32>((endpoint[c] - bit) * 0.5f + 0.5f);
+            candidate[c] = static_cast<u8>(std::min(std::max(value, 0), 127) * 2 + bit);
+            error += (candidate[c] - endpoint[c]) * (candidate[c] - endpoint[c]);
+        }
+        if (error < bestError)
+        {
+            bestError = error;
+            pBit = bit;
+            memcpy(quantized, candidate, 4);
+        }
+    }
+}
+
+static u32 fitBc7Indices(const u8 block[64], const u8 endpoints[2][4], u8 indices[16])
+{
+    i32 palette[16][4];
+    for (u32 index = 0; index < 16; index++)
+        for (u32 c = 0; c < 4; c++)
+            palette[index][c] = ((64 - bc7Weights[index]) * endpoints[0][c] + bc7Weights[index] * endpoints[1][c] + 32) >> 6;
+
+    u32 error = 0;
+    for (u32 i = 0; i < 16; i++)
+    {
+        u32 best = UINT32_MAX;
+        for (u8 index = 0; index < 16; index++)
+        {
+            u32 distance = 0;
+            for (u32 c = 0; c < 4; c++)
+            {
+                i32 difference = block[i * 4 + c] - palette[index][c];
+                distance += static_cast<u32>(difference * difference);
+            }
+            if (distance < best)
+            {
+                best = distance;
+                indices[i] = index;
+            }
+        }
+        error += best;
+    }
+    return error;
+}
+
+// Mode 6: one subset, RGBA endpoints and 4 bit indices.
+static void encodeBc7Block(const u8 block[64], u8* output)
+{
+    float weights[16];
+    for (u32 i = 0; i < 16; i++)
+        weights[i] = bc7Weights[i] / 64.0f;
+
+    float endpoints[2][4];
+    getEndpoints(block, 4, endpoints);
+
+    u8 quantized[2][4];
+    u32 pBits[2];
+    quantizeBc7Endpoint(endpoints[0], quantized[0], pBits[0]);
+    quantizeBc7Endpoint(endpoints[1], quantized[1], pBits[1]);
+
+    u8 indices[16];
+    u32 error = fitBc7Indices(block, quantized, indices);
+    for (u32 iteration = 0; iteration < 2 && error > 0; iteration++)
+    {
+        if (!solveEndpoints(block, 4, indices, weights, endpoints))
+            break;
+
+        u8 refined[2][4];
+        u32 refinedBits[2];
+        quantizeBc7Endpoint(endpoints[0], refined[0], refinedBits[0]);
+        quantizeBc7Endpoint(endpoints[1], refined[1], refinedBits[1]);
+        u8 refinedIndices[16];
+        u32 refinedError = fitBc7Indices(block, refined, refinedIndices);
+        if (refinedError >= error)
+            break;
+
+        memcpy(quantized, refined, sizeof(quantized));
+        memcpy(pBits, refinedBits, sizeof(pBits));
+        memcpy(indices, refinedIndices, sizeof(indices));
+        error = refinedError;
+    }
+
+    // The first index is stored without its top bit, which must be clear.
+    if (indices[0] & 8)
+    {
+        std::swap(quantized[0], quantized[1]);
+        std::swap(pBits[0], pBits[1]);
+        for (u8& index : indices)
+            index = 15 - index;
+    }
+
+    memset(output, 0, 16);
+    BitWriter writer{ output, 0 };
+    writeBits(writer, 1u << 6, 7);
+    for (u32 c = 0; c < 4; c++)
+    {
+        writeBits(writer, quantized[0][c] >> 1, 7);
+        writeBits(writer, quantized[1][c] >> 1, 7);
+    }
+    writeBits(writer, pBits[0], 1);
+    writeBits(writer, pBits[1], 1);
+    writeBits(writer, indices[0], 3);
+    for (u32 i = 1; i < 16; i++)
+        writeBits(writer, indices[i], 4);
+}
+
+void CompressImage(ThreadPool& pool, VkFormat format, const u8* pixels, u32 width, u32 height, u8* blocks)
+{
+    u32 blockSize = GetBlockSize(format);
+    if (blockSize == 0)
+        throw std::runtime_error("Unsupported block-compressed format");
+
+    bool bc3 = format == VK_FORMAT_BC3_UNORM_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK;
+    u32 blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    u32 jobCount = (blocksY + BLOCK_ROWS_PER_JOB - 1) / BLOCK_ROWS_PER_JOB;
+    pool.ParallelFor(jobCount, [&](u32 job)
+    {
+        u8 block[64];
+        u32 lastRow = std::min((job + 1) * BLOCK_ROWS_PER_JOB, blocksY);
+        for (u32 blockY = job * BLOCK_ROWS_PER_JOB; blockY < lastRow; blockY++)
+        {
+            for (u32 blockX = 0; blockX < blocksX; blockX++)
+            {
+                fetchBlock(pixels, width, height, blockX, blockY, block);
+                u8* output = blocks + (static_cast<size_t>(blockY) * blocksX + blockX) * blockSize;
+                if (blockSize == 8)
+                {
+                    encodeColorBlock(block, output);
+                }
+                else if (bc3)
+                {
+                    encodeAlphaBlock(block, output);
+                    encodeColorBlock(block, output + 8);
+                }
+                else
+                {
+                    encodeBc7Block(block, output);
+                }
+            }
+        }
+    });
+}
+
+void CompressMipChain(ThreadPool& pool, VkFormat format, const u8* chain, u32 width, u32 height, u32 mipCount,
+    std::vector<u8>& blocks)
+{
+    size_t size = 0;
+    for (u32 level = 0; level < mipCount; level++)
+        size += static_cast<size_t>(TextureCache::GetMipSize(format, width, height, level));
+    blocks.resize(size);
+
+    size_t sourceOffset = 0, blockOffset = 0;
+    for (u32 level = 0; level < mipCount; level++)
+    {
+        u32 mipWidth = std::max(width >> level, 1u), mipHeight = std::max(height >> level, 1u);
+        CompressImage(pool, format, chain + sourceOffset, mipWidth, mipHeight, blocks.data() + blockOffset);
+        sourceOffset += static_cast<size_t>(mipWidth) * mipHeight * 4;
+        blockOffset += static_cast<size_t>(TextureCache::GetMipSize(format, width, height, level));
+    }
+}
@@ -1,17 +1,28 @@
 #include <GLFW/glfw3.h>
 #include <GLFW/glfw3native.h>
-#include <stb-master/stb_image.h>
-#include <tiny_obj_loader.h>
 
 #include <chrono>
+#include <iostream>
 
 #include <MyMath.hpp>
 #include <MyUtils.hpp>
+#include <BlockCompressor.hpp>
+#include <MipGenerator.hpp>
 #include <Window.hpp>
 #include <Engine.hpp>
 
 void Engine::Create(Window* window)
 {
+    m_threadPool.Create();
+    m_io.Create(m_threadPool);
+    m_textureLoads.Create(m_threadPool, m_io, [this](size_t size, u32& buffer) { return allocateStreamingStaging(size, buffer); });
+
+    // Everything in the archive is read from it, anything else from data.
+    MountArchive(ASSET_ARCHIVE_PATH, &m_threadPool);
+
+    // A texture the cooker tiled is streamed in page by page instead.
+    m_virtualTexturing = VIRTUAL_TEXTURING && m_virtualTexture.Open(GetTiledTexturePath(TEXTURE_ASSET_PATH));
+
     createInstance();
     createSurface(window);
     pickPhysicalDevice();
@@ -20,31 +31,67 @@ void Engine::Create(Window* window)
     createImageViews();
     createRenderPass();
     createDescriptorSetLayout();
-    createGraphicsPipeline();
     createCommandPool();
     createDepthResources();
     createFramebuffers();
-    loadModel("data/potatOS.obj");
-    createTextureImage("data/potatOS.png");
-    createTextureImageView();
     createTextureSampler();
-    createVertexBuffer();
-    createIndexBuffer();
+    m_blitMips = supportsLinearBlit(VK_FORMAT_R8G8B8A8_SRGB);
+    m_textureFormat = findSupportedFormat(
+        { VK_FORMAT_BC7_SRGB_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK, VK_FORMAT_BC1_RGB_SRGB_BLOCK, VK_FORMAT_R8G8B8A8_SRGB },
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT
+    );
+    m_hostImageCopy = m_hostImageCopy && supportsHostImageCopy(m_textureFormat) && supportsHostImageCopy(VK_FORMAT_R8G8B8A8_SRGB);
+    std::cout << "Texture uploads: " << (m_hostImageCopy ? "host image copy" : "staging buffers") << std::endl;
+    if (m_virtualTexturing)
+        createVirtualTexture();
+
+    // The first frames draw placeholders, the real assets are parsed and
+    // decoded on the pool and swapped in by pollAssets once they are ready.
+    VertexPackingOptions packingOptions = getVertexPackingOptions();
+    uploadAssets("", MakePlaceholderModel(packingOptions), "", MakePlaceholderTexture());
+
     createUniformBuffers();
     createDescriptorPool();
     createDescriptorSets();
     createCommandBuffers();
     createSyncObjects();
+
+    loadModel(PREFER_COOKED_ASSETS);
+    m_materialTextures.resize(m_materialTexturePaths.size());
+    m_textureReloads.resize(m_materialTexturePaths.size());
+    for (u32 i = 0; i < m_materialTexturePaths.size() && !m_virtualTexturing; i++)
+        loadTexture(i, PREFER_COOKED_ASSETS);
+    if (HOT_RELOAD_ASSETS)
+        watchAssets();
 }
 
 void Engine::Destroy()
 {
+    // Loads still running may be allocating staging memory from the device.
+    m_watcher.Destroy();
+    m_io.Destroy();
+    m_threadPool.Destroy();
+    for (auto& staging : m_streamingStaging)
+    {
+        vkDestroyBuffer(m_logicalDevice, staging.second.buffer, nullptr);
+        vkFreeMemory(m_logicalDevice, staging.second.memory, nullptr);
+    }
+    m_streamingStaging.clear();
+
     cleanupSwapChain();
+    if (m_virtualTexturing)
+        destroyVirtualTexture();
 
     vkDestroySampler(m_logicalDevice, m_textureSampler, nullptr);
-    vkDestroyImageView(m_logicalDevice, m_textureImageView, nullptr);
-    vkDestroyImage(m_logicalDevice, m_textureImage, nullptr);
-    vkFreeMemory(m_logicalDevice, m_textureImageMemory, nullptr);
+
+    // Dropping the last handles retires the assets' resources as well.
+    m_texture.reset();
+    m_model.reset();
+    vkDestroyPipeline(m_logicalDevice, m_graphicsPipeline, nullptr);
+    vkDestroyPipeline(m_logicalDevice, m_feedbackPipeline, nullptr);
+    vkDestroyPipelineLayout(m_logicalDevice, m_pipelineLayout, nullptr);
+    destroyRetiredResources(UINT64_MAX);
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
@@ -55,15 +102,6 @@ void Engine::Destroy()
 
     vkDestroyDescriptorSetLayout(m_logicalDevice, m_descriptorSetLayout, nullptr);
 
-    vkDestroyBuffer(m_logicalDevice, m_indexBuffer, nullptr);
-    vkFreeMemory(m_logicalDevice, m_indexBufferMemory, nullptr);
-
-    vkDestroyBuffer(m_logicalDevice, m_vertexBuffer, nullptr);
-    vkFreeMemory(m_logicalDevice, m_vertexBufferMemory, nullptr);
-
-    vkDestroyPipeline(m_logicalDevice, m_graphicsPipeline, nullptr);
-    vkDestroyPipelineLayout(m_logicalDevice, m_pipelineLayout, nullptr);
-
     vkDestroyRenderPass(m_logicalDevice, m_renderPass, nullptr);
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
@@ -79,11 +117,24 @@ void Engine::Destroy()
 
     vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
     vkDestroyInstance(m_instance, nullptr);
+
+    UnmountArchives();
 }
 
 void Engine::Update(Window* window)
 {
-    vkWaitForFences(m_logicalDevice, 1, m_inFlightFences.data(), VK_TRUE, UINT64_MAX);
+    // Once this slot's last frame is done, so is everything submitted before it.
+    vkWaitForFences(m_logicalDevice, 1, &m_inFlightFences[m_currentFrame], VK_TRUE, UINT64_MAX);
+    m_completedFrames = std::max(m_completedFrames, m_slotFrames[m_currentFrame]);
+    destroyRetiredResources(m_completedFrames);
+
+    pollAssets();
+    streamTextures();
+    if (m_staleDescriptorSets & (1u << m_currentFrame))
+    {
+        updateDescriptorSet(m_currentFrame);
+        m_staleDescriptorSets &= ~(1u << m_currentFrame);
+    }
 
     VkResult result = vkAcquireNextImageKHR(m_logicalDevice, m_swapChain, UINT64_MAX, m_imageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE, &m_imageIndex);
 
@@ -102,12 +153,16 @@ void Engine::Update(Window* window)
     float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
     UniformBufferObject ubo{};
-    ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(25.0f), glm::vec3(1.0f, -1.0f, 1.0f));
+    ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(25.0f), glm::vec3(1.0f, -1.0f, 1.0f)) * GetDequantizeMatrix(m_model->asset->layout);
     ubo.view = glm::lookAt(glm::vec3(20.f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
     ubo.proj = glm::perspective(glm::radians(45.f), m_swapChainExtent.width / (float)m_swapChainExtent.height, 0.1f, 10000.0f);
     ubo.proj[1][1] *= -1;
 
     memcpy(m_uniformBuffersMapped[m_currentFrame], &ubo, sizeof(ubo));
+    m_ubo = ubo;
+
+    if (m_virtualTexturing)
+        updateVirtualTexture();
 
     vkResetFences(m_logicalDevice, 1, &m_inFlightFences[m_currentFrame]);
     vkResetCommandBuffer(m_commandBuffers[m_currentFrame], 0);
@@ -134,6 +189,7 @@ void Engine::Draw()
 
     if (vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_inFlightFences[m_currentFrame]) != VK_SUCCESS)
         throw std::runtime_error("Failed to submit draw command buffer");
+    m_slotFrames[m_currentFrame] = ++m_submittedFrames;
 
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -216,14 +272,24 @@ void Engine::createSurface(Window* window)
         throw std::runtime_error("Failed to create window surface");
 }
 
-bool Engine::isPhysicalDeviceSuitable(VkPhysicalDevice device)
+static u32 getPhysicalDeviceRank(VkPhysicalDeviceType type)
+{
+    switch (type)
+    {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 0;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 1;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return 2;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU: return 3;
+    default: return 4;
+    }
+}
+
+bool Engine::isPhysicalDeviceSuitable(VkPhysicalDevice device, QueueFamilyIndices& queueFamilies)
 {
     VkPhysicalDeviceProperties deviceProperties;
     vkGetPhysicalDeviceProperties(device, &deviceProperties);
 
-    bool validProperties =
-        deviceProperties.apiVersion >= m_appInfo.apiVersion &&
-        deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
+    bool validProperties = deviceProperties.apiVersion >= m_appInfo.apiVersion;
 
     VkPhysicalDeviceFeatures deviceFeatures;
     vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
@@ -232,18 +298,18 @@ bool Engine::isPhysicalDeviceSuitable(VkPhysicalDevice device)
 
     u32 queueFamilyCount = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
-    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+    std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilyProperties.data());
 
-    m_graphicsFamily = m_presentFamily = -1;
+    queueFamilies.graphicsFamily = queueFamilies.presentFamily = -1;
     for (u32 i = 0; i < queueFamilyCount; i++)
-        if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+        if (queueFamilyProperties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
         {
-            m_graphicsFamily = i;
+            queueFamilies.graphicsFamily = i;
 
             VkBool32 presentSupport = false;
             vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
-            if (presentSupport) m_presentFamily = i;
+            if (presentSupport) queueFamilies.presentFamily = i;
 
             break;
         }
@@ -263,16 +329,10 @@ bool Engine::isPhysicalDeviceSuitable(VkPhysicalDevice device)
     bool swapChainAdequate = false;
     if (extensionsSupported)
     {
-        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, m_surface, &m_supportedSurfaceCapabilities);
-
         u32 surfaceFormatCount = 0;
         vkGetPhysicalDeviceSurfaceFormatsKHR(device, m_surface, &surfaceFormatCount, nullptr);
-        m_supportedSurfaceFormats.resize(surfaceFormatCount);
-        vkGetPhysicalDeviceSurfaceFormatsKHR(device, m_surface, &surfaceFormatCount, m_supportedSurfaceFormats.data());
         u32 presentModeCount = 0;
         vkGetPhysicalDeviceSurfacePresentModesKHR(device, m_surface, &presentModeCount, nullptr);
-        m_supportedPresentModes.resize(presentModeCount);
-        vkGetPhysicalDeviceSurfacePresentModesKHR(device, m_surface, &presentModeCount, m_supportedPresentModes.data());
 
         swapChainAdequate = surfaceFormatCount != 0 && presentModeCount != 0;
     }
@@ -282,13 +342,28 @@ bool Engine::isPhysicalDeviceSuitable(VkPhysicalDevice device)
 
     return validProperties
         && requiredFeatures
-        && m_graphicsFamily != -1
-        && m_presentFamily != -1
+        && queueFamilies.graphicsFamily != -1
+        && queueFamilies.presentFamily != -1
         && extensionsSupported
         && swapChainAdequate
         && supportedFeatures.samplerAnisotropy;
 }
 
+// The surface capabilities, formats and present modes of the picked device.
+void Engine::querySurfaceSupport()
+{
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_physicalDevice, m_surface, &m_supportedSurfaceCapabilities);
+
+    u32 surfaceFormatCount = 0;
+    vkGetPhysicalDeviceSurfaceFormatsKHR(m_physicalDevice, m_surface, &surfaceFormatCount, nullptr);
+    m_supportedSurfaceFormats.resize(surfaceFormatCount);
+    vkGetPhysicalDeviceSurfaceFormatsKHR(m_physicalDevice, m_surface, &surfaceFormatCount, m_supportedSurfaceFormats.data());
+    u32 presentModeCount = 0;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(m_physicalDevice, m_surface, &presentModeCount, nullptr);
+    m_supportedPresentModes.resize(presentModeCount);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(m_physicalDevice, m_surface, &presentModeCount, m_supportedPresentModes.data());
+}
+
 void Engine::pickPhysicalDevice()
 {
     u32 deviceCount = 0;
@@ -298,17 +373,37 @@ void Engine::pickPhysicalDevice()
     std::vector<VkPhysicalDevice> devices(deviceCount);
     vkEnumeratePhysicalDevices(m_instance, &deviceCount, devices.data());
 
+    // Discrete GPUs first, CPU implementations such as lavapipe last, so the
+    // engine still runs on machines without a GPU.
+    u32 bestRank = UINT32_MAX;
+    QueueFamilyIndices bestQueueFamilies{};
     for (const VkPhysicalDevice& device : devices)
     {
-        if (isPhysicalDeviceSuitable(device))
+        QueueFamilyIndices queueFamilies;
+        if (!isPhysicalDeviceSuitable(device, queueFamilies))
+            continue;
+
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(device, &deviceProperties);
+        u32 rank = getPhysicalDeviceRank(deviceProperties.deviceType);
+        if (rank < bestRank)
         {
             m_physicalDevice = device;
-            break;
+            bestRank = rank;
+            bestQueueFamilies = queueFamilies;
         }
     }
 
     if (m_physicalDevice == VK_NULL_HANDLE)
         throw std::runtime_error("Failed to find a suitable GPU");
+
+    m_graphicsFamily = bestQueueFamilies.graphicsFamily;
+    m_presentFamily = bestQueueFamilies.presentFamily;
+    querySurfaceSupport();
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &deviceProperties);
+    std::cout << "Device: " << deviceProperties.deviceName << std::endl;
 }
 
 void Engine::createLogicalDevice()
@@ -330,24 +425,84 @@ void Engine::createLogicalDevice()
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(m_physicalDevice, &supportedFeatures);
+
     VkPhysicalDeviceFeatures deviceFeatures{};
+    deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+
+    std::vector<const char*> extensions = m_deviceExtensions;
+    m_hostImageCopy = HOST_IMAGE_COPY && supportsHostImageCopy(m_physicalDevice);
+    VkPhysicalDeviceHostImageCopyFeaturesEXT hostImageCopyFeatures{};
+    hostImageCopyFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT;
+    hostImageCopyFeatures.hostImageCopy = VK_TRUE;
+    if (m_hostImageCopy)
+        extensions.push_back(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME);
 
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = m_hostImageCopy ? &hostImageCopyFeatures : nullptr;
     createInfo.pQueueCreateInfos = &queueCreateInfo;
     createInfo.queueCreateInfoCount = 1;
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<u32>(m_deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = m_deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<u32>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
     createInfo.enabledLayerCount = 0;
 
     if (vkCreateDevice(m_physicalDevice, &createInfo, nullptr, &m_logicalDevice) != VK_SUCCESS)
         throw std::runtime_error("Failed to create logical device");
 
+    if (m_hostImageCopy)
+    {
+        m_vkCopyMemoryToImage = reinterpret_cast<PFN_vkCopyMemoryToImageEXT>(
+            vkGetDeviceProcAddr(m_logicalDevice, "vkCopyMemoryToImageEXT"));
+        m_vkTransitionImageLayout = reinterpret_cast<PFN_vkTransitionImageLayoutEXT>(
+            vkGetDeviceProcAddr(m_logicalDevice, "vkTransitionImageLayoutEXT"));
+        m_hostImageCopy = m_vkCopyMemoryToImage && m_vkTransitionImageLayout;
+    }
+
     vkGetDeviceQueue(m_logicalDevice, m_graphicsFamily, 0, &m_graphicsQueue);
     vkGetDeviceQueue(m_logicalDevice, m_presentFamily, 0, &m_presentQueue);
 }
 
+// Textures are copied in the layout they are sampled in, which the device
+// has to list as a host copy destination.
+bool Engine::supportsHostImageCopy(VkPhysicalDevice device)
+{
+    u32 extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+
+    bool available = false;
+    for (const VkExtensionProperties& extension : extensions)
+        if (strcmp(extension.extensionName, VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME) == 0)
+            available = true;
+    if (!available)
+        return false;
+
+    VkPhysicalDeviceHostImageCopyFeaturesEXT hostImageCopyFeatures{};
+    hostImageCopyFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &hostImageCopyFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+    if (!hostImageCopyFeatures.hostImageCopy)
+        return false;
+
+    VkPhysicalDeviceHostImageCopyPropertiesEXT hostImageCopyProperties{};
+    hostImageCopyProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES_EXT;
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &hostImageCopyProperties;
+    vkGetPhysicalDeviceProperties2(device, &properties);
+
+    std::vector<VkImageLayout> layouts(hostImageCopyProperties.copyDstLayoutCount);
+    hostImageCopyProperties.pCopyDstLayouts = layouts.data();
+    vkGetPhysicalDeviceProperties2(device, &properties);
+    return std::find(layouts.begin(), layouts.end(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) != layouts.end();
+}
+
 void Engine::createSwapChain(Window* window)
 {
     VkSurfaceFormatKHR surfaceFormat{};
@@ -448,15 +603,15 @@ void Engine::createImageViews()
     m_swapChainImageViews.resize(m_swapChainImages.size());
 
     for (u32 i = 0; i < m_swapChainImages.size(); i++)
-        m_swapChainImageViews[i] = createImageView(m_swapChainImages[i], m_swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+        m_swapChainImageViews[i] = createImageView(m_swapChainImages[i], m_swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 }
 
-VkShaderModule Engine::createShaderModule(const std::vector<char>& code)
+VkShaderModule Engine::createShaderModule(FileSpan code)
 {
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size();
-    createInfo.pCode = reinterpret_cast<const u32*>(code.data());
+    createInfo.codeSize = code.size;
+    createInfo.pCode = reinterpret_cast<const u32*>(code.data);
 
     VkShaderModule shaderModule;
     if (vkCreateShaderModule(m_logicalDevice, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
@@ -480,7 +635,16 @@ void Engine::createDescriptorSetLayout()
     samplerLayoutBinding.pImmutableSamplers = nullptr;
     samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-    std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
+    std::vector<VkDescriptorSetLayoutBinding> bindings = { uboLayoutBinding, samplerLayoutBinding };
+    if (m_virtualTexturing)
+    {
+        VkDescriptorSetLayoutBinding pageLayoutBinding = samplerLayoutBinding;
+        pageLayoutBinding.binding = 2;
+        bindings.push_back(pageLayoutBinding);
+        pageLayoutBinding.binding = 3;
+        bindings.push_back(pageLayoutBinding);
+    }
+
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     layoutInfo.bindingCount = static_cast<u32>(bindings.size());
@@ -492,11 +656,12 @@ void Engine::createDescriptorSetLayout()
 
 void Engine::createGraphicsPipeline()
 {
-    std::vector<char> vertShaderCode = readFile("data/shaders/vertex_shader.spv");
-    std::vector<char> fragShaderCode = readFile("data/shaders/fragment_shader.spv");
+    MappedFile vertShaderCode, fragShaderCode;
+    readFile(vertShaderCode, "data/shaders/vertex_shader.spv");
+    readFile(fragShaderCode, m_virtualTexturing ? "data/shaders/virtual_fragment_shader.spv" : "data/shaders/fragment_shader.spv");
 
-    VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-    VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+    VkShaderModule vertShaderModule = createShaderModule(vertShaderCode.GetSpan());
+    VkShaderModule fragShaderModule = createShaderModule(fragShaderCode.GetSpan());
 
     VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
     vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -515,12 +680,12 @@ void Engine::createGraphicsPipeline()
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-    VkVertexInputBindingDescription bindingDescription = Vertex::getBindingDescription();
-    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = Vertex::getAttributeDescriptions();
+    std::array<VkVertexInputBindingDescription, 2> bindingDescriptions = Vertex::getBindingDescriptions(m_model->asset->layout);
+    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions = Vertex::getAttributeDescriptions(m_model->asset->layout);
 
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.vertexBindingDescriptionCount = m_model->asset->layout.constantColor ? 2 : 1;
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<u32>(attributeDescriptions.size());
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
     vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
@@ -590,6 +755,13 @@ void Engine::createGraphicsPipeline()
     pipelineLayoutInfo.setLayoutCount = 1;
     pipelineLayoutInfo.pSetLayouts = &m_descriptorSetLayout;
 
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = m_virtualTexturing ? sizeof(VirtualTextureParameters) : sizeof(TextureRegion);
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
     if (vkCreatePipelineLayout(m_logicalDevice, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS)
         throw std::runtime_error("Failed to create pipeline layout!");
 
@@ -613,9 +785,25 @@ void Engine::createGraphicsPipeline()
 
     if (vkCreateGraphicsPipelines(m_logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_graphicsPipeline) != VK_SUCCESS)
         throw std::runtime_error("Failed to create graphics pipeline");
+    vkDestroyShaderModule(m_logicalDevice, fragShaderModule, nullptr);
+
+    // The same geometry into the feedback target, which has a single integer
+    // channel and nothing to blend.
+    if (m_virtualTexturing)
+    {
+        MappedFile feedbackShaderCode;
+        readFile(feedbackShaderCode, "data/shaders/virtual_feedback_shader.spv");
+        shaderStages[1].module = createShaderModule(feedbackShaderCode.GetSpan());
+        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT;
+        pipelineInfo.renderPass = m_feedbackRenderPass;
+
+        VkResult result = vkCreateGraphicsPipelines(m_logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_feedbackPipeline);
+        vkDestroyShaderModule(m_logicalDevice, shaderStages[1].module, nullptr);
+        if (result != VK_SUCCESS)
+            throw std::runtime_error("Failed to create feedback pipeline");
+    }
 
     vkDestroyShaderModule(m_logicalDevice, vertShaderModule, nullptr);
-    vkDestroyShaderModule(m_logicalDevice, fragShaderModule, nullptr);
 }
 
 VkFormat Engine::findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features)
@@ -752,8 +940,8 @@ void Engine::createDepthResources()
 {
     VkFormat depthFormat = findDepthFormat();
 
-    createImage(m_swapChainExtent.width, m_swapChainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthImage, m_depthImageMemory);
-    m_depthImageView = createImageView(m_depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+    createImage(m_swapChainExtent.width, m_swapChainExtent.height, 1, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthImage, m_depthImageMemory);
+    m_depthImageView = createImageView(m_depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
 }
 
 void Engine::recordCommandBuffer(VkCommandBuffer commandBuffer, u32 imageIndex)
@@ -766,6 +954,12 @@ void Engine::recordCommandBuffer(VkCommandBuffer commandBuffer, u32 imageIndex)
     if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
         throw std::runtime_error("Failed to begin recording command buffer");
 
+    if (m_virtualTexturing)
+    {
+        recordPageUploads(commandBuffer);
+        recordFeedbackPass(commandBuffer);
+    }
+
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     renderPassInfo.renderPass = m_renderPass;
@@ -798,13 +992,71 @@ void Engine::recordCommandBuffer(VkCommandBuffer commandBuffer, u32 imageIndex)
     scissor.extent = m_swapChainExtent;
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    VkBuffer vertexBuffers[] = { m_vertexBuffer };
-    VkDeviceSize offsets[] = { 0 };
-    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    const ModelAsset& model = *m_model->asset;
+    VkBuffer vertexBuffers[] = { m_model->vertexBuffer, m_model->vertexBuffer };
+    VkDeviceSize offsets[] = { 0, GetConstantColorOffset(model.layout, model.vertexCount) };
+    vkCmdBindVertexBuffers(commandBuffer, 0, model.layout.constantColor ? 2 : 1, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, m_model->indexBuffer, 0, model.layout.indexType);
     vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSets[m_currentFrame], 0, nullptr);
+    if (m_virtualTexturing)
+    {
+        VirtualTextureParameters parameters = m_virtualTexture.GetParameters(0.0f);
+        vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(parameters), &parameters);
+    }
+
+    // LOD errors and meshlet bounds are in object space, the model matrix also
+    // dequantizes.
+    glm::mat4 objectToView = m_ubo.view * m_ubo.model * glm::inverse(GetDequantizeMatrix(model.layout));
+    glm::mat4 objectToClip = m_ubo.proj * objectToView;
+    glm::vec3 cameraPosition = glm::inverse(objectToView)[3];
 
-    vkCmdDrawIndexed(commandBuffer, static_cast<u32>(m_indices.size()), 1, 0, 0, 0);
+    // Submeshes are sorted by material and all live in the buffers bound above,
+    // so only the material's region changes between groups of draws.
+    m_meshletCullStats = MeshletCullStats{};
+    u32 drawCount = 0;
+    u32 material = UINT32_MAX;
+
+    for (u32 i = 0; i < model.submeshCount; i++)
+    {
+        const Submesh& submesh = model.submeshData[i];
+        if (!m_virtualTexturing && submesh.material != material)
+        {
+            material = submesh.material;
+            TextureRegion region = getMaterialRegion(material);
+            vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(region), &region);
+        }
+
+        const MeshLod& lod = model.lodData[submesh.firstLod + selectLod(submesh, objectToView, m_ubo.proj)];
+
+        if (!CULL_MESHLETS || lod.meshletCount == 0)
+        {
+            vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, lod.firstIndex, submesh.vertexOffset, 0);
+            continue;
+        }
+
+        MeshletCullStats stats = CullMeshlets(model.meshletData + lod.firstMeshlet, lod.meshletCount,
+            objectToClip, cameraPosition, m_meshletDraws);
+        m_meshletCullStats.visibleMeshlets += stats.visibleMeshlets;
+        m_meshletCullStats.visibleTriangles += stats.visibleTriangles;
+        m_meshletCullStats.frustumCulledTriangles += stats.frustumCulledTriangles;
+        m_meshletCullStats.coneCulledTriangles += stats.coneCulledTriangles;
+        drawCount += static_cast<u32>(m_meshletDraws.size());
+
+        for (const VkDrawIndexedIndirectCommand& draw : m_meshletDraws)
+            vkCmdDrawIndexed(commandBuffer, draw.indexCount, draw.instanceCount, draw.firstIndex, submesh.vertexOffset, draw.firstInstance);
+    }
+
+#ifdef MESHLET_CULL_STATS
+    static u32 frame = 0;
+    if (CULL_MESHLETS && frame++ % 120 == 0)
+    {
+        u32 triangles = m_meshletCullStats.visibleTriangles + m_meshletCullStats.frustumCulledTriangles + m_meshletCullStats.coneCulledTriangles;
+        std::cout << "Meshlets: " << m_meshletCullStats.visibleMeshlets << " visible in " << drawCount << " draws, "
+            << m_meshletCullStats.visibleTriangles << "/" << triangles << " triangles drawn, "
+            << m_meshletCullStats.frustumCulledTriangles << " frustum culled, "
+            << m_meshletCullStats.coneCulledTriangles << " backface culled" << std::endl;
+    }
+#endif
 
     vkCmdEndRenderPass(commandBuffer);
 
@@ -812,6 +1064,36 @@ void Engine::recordCommandBuffer(VkCommandBuffer commandBuffer, u32 imageIndex)
         throw std::runtime_error("Failed to record command buffer");
 }
 
+// The whole of the first layer until the material textures are in.
+TextureRegion Engine::getMaterialRegion(u32 material)
+{
+    if (m_materialRegions.empty())
+        return { { 0.0f, 0.0f }, { 1.0f, 1.0f }, 0 };
+    return m_materialRegions[std::min<size_t>(material, m_materialRegions.size() - 1)];
+}
+
+// Coarsest level of the submesh whose error still projects to under
+// LOD_PIXEL_ERROR pixels, measured at the point of its bounding sphere closest
+// to the camera.
+u32 Engine::selectLod(const Submesh& submesh, const glm::mat4& objectToView, const glm::mat4& proj)
+{
+    glm::vec3 center = objectToView * glm::vec4(submesh.bounds.center, 1.0f);
+    float scale = glm::max(glm::length(glm::vec3(objectToView[0])),
+        glm::max(glm::length(glm::vec3(objectToView[1])), glm::length(glm::vec3(objectToView[2]))));
+
+    float distance = -center.z - submesh.bounds.radius * scale;
+    if (distance <= 0.0f)
+        return 0;
+
+    float pixelsPerUnit = scale * glm::abs(proj[1][1]) * 0.5f * m_swapChainExtent.height / distance;
+
+    const MeshLod* lods = m_model->asset->lodData + submesh.firstLod;
+    u32 lod = 0;
+    while (lod + 1 < submesh.lodCount && lods[lod + 1].error * pixelsPerUnit <= LOD_PIXEL_ERROR)
+        lod++;
+    return lod;
+}
+
 u32 Engine::findMemoryType(u32 typeFilter, VkMemoryPropertyFlags properties)
 {
     VkPhysicalDeviceMemoryProperties memProperties;
@@ -869,6 +1151,7 @@ VkCommandBuffer Engine::beginSingleTimeCommands()
     return commandBuffer;
 }
 
+// Submits without waiting, the caller retires the command buffer.
 void Engine::endSingleTimeCommands(VkCommandBuffer commandBuffer)
 {
     vkEndCommandBuffer(commandBuffer);
@@ -878,28 +1161,20 @@ void Engine::endSingleTimeCommands(VkCommandBuffer commandBuffer)
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
-    vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(m_graphicsQueue);
-
-    vkFreeCommandBuffers(m_logicalDevice, m_commandPool, 1, &commandBuffer);
+    if (vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        throw std::runtime_error("Failed to submit upload command buffer");
 }
 
-void Engine::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+void Engine::copyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
 {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
     VkBufferCopy copyRegion{};
     copyRegion.size = size;
     vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-    endSingleTimeCommands(commandBuffer);
 }
 
-void Engine::transitionImageLayout(VkImage image, VkFormat format,
-    VkImageLayout oldLayout, VkImageLayout newLayout)
+void Engine::transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format,
+    VkImageLayout oldLayout, VkImageLayout newLayout, u32 mipLevels, u32 baseMipLevel)
 {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
     VkImageMemoryBarrier barrier{};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.oldLayout = oldLayout;
@@ -908,10 +1183,10 @@ void Engine::transitionImageLayout(VkImage image, VkFormat format,
     barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     barrier.image = image;
     barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseMipLevel = baseMipLevel;
+    barrier.subresourceRange.levelCount = mipLevels;
     barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
+    barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
 
     VkPipelineStageFlags sourceStage;
     VkPipelineStageFlags destinationStage;
@@ -946,42 +1221,190 @@ void Engine::transitionImageLayout(VkImage image, VkFormat format,
         sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
         destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
     }
+    else if (oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL &&
+        newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+    {
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        sourceStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+    else if (oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL &&
+        newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+    {
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        sourceStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
     else
     {
         throw std::invalid_argument("Unsupported layout transition");
     }
 
     vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
 
-    endSingleTimeCommands(commandBuffer);
+// The levels are read at mipOffsets when given, back to back from the start of
+// the buffer otherwise, each with all layers in order.
+void Engine::copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image,
+    VkFormat format, u32 width, u32 height, u32 mipLevels, const u64* mipOffsets, u32 layerCount)
+{
+    std::vector<VkBufferImageCopy> regions(mipLevels);
+    VkDeviceSize offset = 0;
+    for (u32 level = 0; level < mipLevels; level++)
+    {
+        VkBufferImageCopy& region = regions[level];
+        region.bufferOffset = mipOffsets ? mipOffsets[level] : offset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = level;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = layerCount;
+
+        region.imageOffset = { 0, 0, 0 };
+        region.imageExtent = { std::max(width >> level, 1u), std::max(height >> level, 1u), 1 };
+
+        offset += TextureCache::GetMipSize(format, width, height, level) * layerCount;
+    }
+
+    vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        static_cast<u32>(regions.size()), regions.data());
 }
 
-void Engine::copyBufferToImage(VkBuffer buffer, VkImage image, u32 width, u32 height)
+bool Engine::supportsHostImageCopy(VkFormat format)
 {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    VkFormatProperties3 properties3{};
+    properties3.sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_3;
+    VkFormatProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2;
+    properties.pNext = &properties3;
+    vkGetPhysicalDeviceFormatProperties2(m_physicalDevice, format, &properties);
+    return (properties3.optimalTilingFeatures & VK_FORMAT_FEATURE_2_HOST_IMAGE_TRANSFER_BIT_EXT) != 0;
+}
 
-    VkBufferImageCopy region{};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
+// Moves the whole image into the layout it is sampled in and writes every
+// level of every layer from the texture's pixels, all on the calling thread.
+// The copies are done before it returns, so any later submit sees them.
+void Engine::copyMemoryToImage(const TextureAsset& texture, VkImage image)
+{
+    VkHostImageLayoutTransitionInfoEXT transition{};
+    transition.sType = VK_STRUCTURE_TYPE_HOST_IMAGE_LAYOUT_TRANSITION_INFO_EXT;
+    transition.image = image;
+    transition.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    transition.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    transition.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipCount, 0, texture.layerCount };
+    if (m_vkTransitionImageLayout(m_logicalDevice, 1, &transition) != VK_SUCCESS)
+        throw std::runtime_error("Failed to transition texture image on the host");
+
+    std::vector<VkMemoryToImageCopyEXT> regions(texture.mipCount);
+    size_t offset = 0;
+    for (u32 level = 0; level < texture.mipCount; level++)
+    {
+        VkMemoryToImageCopyEXT& region = regions[level];
+        region.sType = VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT;
+        region.pHostPointer = texture.pixelData + (texture.mipOffsets.empty() ? offset : texture.mipOffsets[level]);
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, texture.layerCount };
+        region.imageOffset = { 0, 0, 0 };
+        region.imageExtent = { std::max(texture.width >> level, 1u), std::max(texture.height >> level, 1u), 1 };
+
+        offset += static_cast<size_t>(TextureCache::GetMipSize(texture.format, texture.width, texture.height, level)) * texture.layerCount;
+    }
 
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
+    VkCopyMemoryToImageInfoEXT copyInfo{};
+    copyInfo.sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT;
+    copyInfo.dstImage = image;
+    copyInfo.dstImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    copyInfo.regionCount = static_cast<u32>(regions.size());
+    copyInfo.pRegions = regions.data();
+    if (m_vkCopyMemoryToImage(m_logicalDevice, &copyInfo) != VK_SUCCESS)
+        throw std::runtime_error("Failed to copy texture to image on the host");
+}
+
+bool Engine::supportsLinearBlit(VkFormat format)
+{
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &properties);
 
-    region.imageOffset = { 0, 0, 0 };
-    region.imageExtent = { width, height, 1 };
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (properties.optimalTilingFeatures & required) == required;
+}
 
-    vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+// Each level is blitted from the one above it, which then moves on to be
+// sampled. Every level starts out as a transfer destination, the first one
+// already written.
+void Engine::generateMipmaps(VkCommandBuffer commandBuffer, VkImage image, u32 width, u32 height, u32 mipLevels)
+{
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
 
-    endSingleTimeCommands(commandBuffer);
+    i32 mipWidth = static_cast<i32>(width);
+    i32 mipHeight = static_cast<i32>(height);
+    for (u32 level = 1; level < mipLevels; level++)
+    {
+        barrier.subresourceRange.baseMipLevel = level - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        i32 nextWidth = std::max(mipWidth / 2, 1);
+        i32 nextHeight = std::max(mipHeight / 2, 1);
+
+        VkImageBlit blit{};
+        blit.srcOffsets[0] = { 0, 0, 0 };
+        blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel = level - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = 1;
+        blit.dstOffsets[0] = { 0, 0, 0 };
+        blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.dstSubresource.mipLevel = level;
+        blit.dstSubresource.baseArrayLayer = 0;
+        blit.dstSubresource.layerCount = 1;
+        vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        mipWidth = nextWidth;
+        mipHeight = nextHeight;
+    }
+
+    barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &barrier);
 }
 
-void Engine::createImage(u32 width, u32 height, VkFormat format,
+void Engine::createImage(u32 width, u32 height, u32 mipLevels, VkFormat format,
     VkImageTiling tiling, VkImageUsageFlags usage,
     VkMemoryPropertyFlags properties, VkImage& image,
-    VkDeviceMemory& imageMemory)
+    VkDeviceMemory& imageMemory, u32 arrayLayers)
 {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -989,8 +1412,8 @@ void Engine::createImage(u32 width, u32 height, VkFormat format,
     imageInfo.extent.width = width;
     imageInfo.extent.height = height;
     imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
+    imageInfo.mipLevels = mipLevels;
+    imageInfo.arrayLayers = arrayLayers;
     imageInfo.format = format;
     imageInfo.tiling = tiling;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -1015,52 +1438,77 @@ void Engine::createImage(u32 width, u32 height, VkFormat format,
     vkBindImageMemory(m_logicalDevice, image, imageMemory, 0);
 }
 
-void Engine::createTextureImage(const char* path)
+void Engine::createTextureImage(VkCommandBuffer commandBuffer, const TextureAsset& texture, TextureResource& resource)
 {
-    int texWidth, texHeight, texChannels;
-    stbi_uc* pixels = stbi_load(path, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    VkDeviceSize imageSize = texWidth * texHeight * 4;
-    if (!pixels) throw std::runtime_error("Failed to load texture image");
-
-    createBuffer(imageSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        m_stagingBuffer, m_stagingBufferMemory);
+    if (m_hostImageCopy && texture.pixelData && supportsHostImageCopy(texture.format))
+    {
+        resource.mipLevels = texture.mipCount;
+        createImage(texture.width, texture.height, resource.mipLevels,
+            texture.format,
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT |
+            VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            resource.image, resource.imageMemory, texture.layerCount);
+        copyMemoryToImage(texture, resource.image);
+        resource.imageView = createImageView(resource.image, texture.format, VK_IMAGE_ASPECT_COLOR_BIT, resource.mipLevels,
+            VK_IMAGE_VIEW_TYPE_2D_ARRAY, texture.layerCount);
+        return;
+    }
 
-    void* data; vkMapMemory(m_logicalDevice, m_stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vkUnmapMemory(m_logicalDevice, m_stagingBufferMemory);
-    stbi_image_free(pixels);
+    VkBuffer stagingBuffer;
+    if (texture.staged)
+    {
+        std::lock_guard<std::mutex> lock(m_streamingStagingMutex);
+        auto staging = m_streamingStaging.find(texture.stagingBuffer);
+        if (staging == m_streamingStaging.end())
+            throw std::runtime_error("Missing texture staging buffer");
+        stagingBuffer = staging->second.buffer;
+    }
+    else
+    {
+        void* data = createStagingBuffer(texture.pixelSize);
+        memcpy(data, texture.pixelData, texture.pixelSize);
+        stagingBuffer = m_stagingBuffers.back().buffer;
+    }
 
-    createImage(texWidth, texHeight,
-        VK_FORMAT_R8G8B8A8_SRGB,
+    // A single level is the base of a chain blitted from it, block-compressed
+    // textures and packed arrays always come with theirs.
+    bool blitMips = m_blitMips && texture.format == VK_FORMAT_R8G8B8A8_SRGB && texture.mipCount == 1 && texture.layerCount == 1;
+    resource.mipLevels = blitMips ? GetMipCount(texture.width, texture.height) : texture.mipCount;
+    createImage(texture.width, texture.height, resource.mipLevels,
+        texture.format,
         VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
         VK_IMAGE_USAGE_TRANSFER_DST_BIT |
         VK_IMAGE_USAGE_SAMPLED_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        m_textureImage, m_textureImageMemory);
-
-    transitionImageLayout(m_textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    copyBufferToImage(m_stagingBuffer, m_textureImage, static_cast<u32>(texWidth), static_cast<u32>(texHeight));
-    transitionImageLayout(m_textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        resource.image, resource.imageMemory, texture.layerCount);
 
-    vkDestroyBuffer(m_logicalDevice, m_stagingBuffer, nullptr);
-    vkFreeMemory(m_logicalDevice, m_stagingBufferMemory, nullptr);
+    transitionImageLayout(commandBuffer, resource.image, texture.format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, resource.mipLevels);
+    copyBufferToImage(commandBuffer, stagingBuffer, resource.image, texture.format, texture.width, texture.height, texture.mipCount,
+        texture.mipOffsets.empty() ? nullptr : texture.mipOffsets.data(), texture.layerCount);
+    if (blitMips)
+        generateMipmaps(commandBuffer, resource.image, texture.width, texture.height, resource.mipLevels);
+    else
+        transitionImageLayout(commandBuffer, resource.image, texture.format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, resource.mipLevels);
+    resource.imageView = createImageView(resource.image, texture.format, VK_IMAGE_ASPECT_COLOR_BIT, resource.mipLevels,
+        VK_IMAGE_VIEW_TYPE_2D_ARRAY, texture.layerCount);
 }
 
-VkImageView Engine::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
+VkImageView Engine::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, u32 mipLevels,
+    VkImageViewType viewType, u32 layerCount, u32 baseMipLevel)
 {
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.image = image;
-    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.viewType = viewType;
     viewInfo.format = format;
     viewInfo.subresourceRange.aspectMask = aspectFlags;
-    viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
+    viewInfo.subresourceRange.levelCount = mipLevels;
     viewInfo.subresourceRange.baseArrayLayer = 0;
-    viewInfo.subresourceRange.layerCount = 1;
+    viewInfo.subresourceRange.layerCount = layerCount;
 
     VkImageView imageView;
     if (vkCreateImageView(m_logicalDevice, &viewInfo, nullptr, &imageView) != VK_SUCCESS)
@@ -1069,9 +1517,191 @@ VkImageView Engine::createImageView(VkImage image, VkFormat format, VkImageAspec
     return imageView;
 }
 
-void Engine::createTextureImageView()
+static const u8* getLevelPixels(const TextureAsset& texture, u32 level)
+{
+    if (!texture.mipOffsets.empty())
+        return texture.pixelData + texture.mipOffsets[level];
+
+    const u8* data = texture.pixelData;
+    for (u32 i = 0; i < level; i++)
+        data += TextureCache::GetMipSize(texture.format, texture.width, texture.height, i) * texture.layerCount;
+    return data;
+}
+
+// Draws are taken to stretch their material's region over their bounding
+// sphere, so the texture needs the level closest to a texel per pixel across
+// the largest sphere on screen. Coverage adds up the spheres' share of the
+// screen. Both come from the previous frame's matrices.
+void Engine::requestTextureLevels()
+{
+    if (m_submittedFrames == 0 || m_texture->streamed == TEXTURE_STREAMING_NONE)
+        return;
+
+    const ModelAsset& model = *m_model->asset;
+    const TextureAsset& texture = *m_texture->asset;
+    glm::mat4 objectToView = m_ubo.view * m_ubo.model * glm::inverse(GetDequantizeMatrix(model.layout));
+    float scale = glm::max(glm::length(glm::vec3(objectToView[0])),
+        glm::max(glm::length(glm::vec3(objectToView[1])), glm::length(glm::vec3(objectToView[2]))));
+    float screenArea = static_cast<float>(m_swapChainExtent.width) * m_swapChainExtent.height;
+
+    u32 level = texture.mipCount - 1;
+    float coverage = 0.0f;
+    for (u32 i = 0; i < model.submeshCount; i++)
+    {
+        const Submesh& submesh = model.submeshData[i];
+        glm::vec3 center = objectToView * glm::vec4(submesh.bounds.center, 1.0f);
+        float radius = submesh.bounds.radius * scale;
+        if (center.z > radius)
+            continue;
+
+        TextureRegion region = getMaterialRegion(submesh.material);
+        float texels = glm::max(region.scale[0] * texture.width, region.scale[1] * texture.height);
+        float distance = -center.z - radius;
+        if (distance <= 0.0f)
+        {
+            level = 0;
+            coverage += 1.0f;
+            continue;
+        }
+
+        float pixels = 2.0f * radius * glm::abs(m_ubo.proj[1][1]) * 0.5f * m_swapChainExtent.height / distance;
+        if (pixels >= texels)
+            level = 0;
+        else
+            level = glm::min(level, static_cast<u32>(glm::log2(texels / pixels)));
+        coverage += glm::min(glm::pi<float>() * pixels * pixels * 0.25f / screenArea, 1.0f);
+    }
+    m_textureStreamer.Request(m_texture->streamed, level, coverage);
+}
+
+// Changed levels go up in one submission ahead of the frame, like loaded
+// assets, and every slot's descriptor set moves on to the new views.
+void Engine::streamTextures()
 {
-    m_textureImageView = createImageView(m_textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
+    requestTextureLevels();
+
+    std::vector<TextureStreamingUpdate> updates;
+    m_textureStreamer.Update(updates);
+    if (updates.empty())
+        return;
+
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    for (const TextureStreamingUpdate& update : updates)
+        updateStreamedTexture(commandBuffer, *m_streamedTextures.at(update.texture), update.firstLevel, update.residentLevel);
+    endSingleTimeCommands(commandBuffer);
+
+    RetiredResources retired{};
+    retired.frame = m_submittedFrames + 1;
+    retired.commandBuffers.push_back(commandBuffer);
+    retired.stagingBuffers = std::move(m_stagingBuffers);
+    m_stagingBuffers.clear();
+    m_retired.push_back(std::move(retired));
+    m_staleDescriptorSets = (1u << MAX_FRAMES_IN_FLIGHT) - 1;
+}
+
+// Moving firstLevel reallocates the image, the levels it keeps are copied
+// over from the previous one on the device. Newly resident levels are
+// uploaded from the texture's pixels. The view starts at residentLevel, so the
+// levels a grown image is still waiting for are never sampled.
+void Engine::updateStreamedTexture(VkCommandBuffer commandBuffer, TextureResource& resource, u32 firstLevel, u32 residentLevel)
+{
+    const TextureAsset& texture = *resource.asset;
+    u32 levelCount = texture.mipCount - firstLevel;
+    VkImage previousImage = resource.image;
+    VkDeviceMemory previousMemory = resource.imageMemory;
+    u32 previousFirstLevel = resource.firstLevel;
+
+    // Levels from keptLevel on are on the device already.
+    u32 keptLevel = previousImage != VK_NULL_HANDLE ? std::max(resource.residentLevel, residentLevel) : texture.mipCount;
+    bool reallocate = previousImage == VK_NULL_HANDLE || firstLevel != previousFirstLevel;
+
+    RetiredResources retired{};
+    retired.frame = m_submittedFrames + 1;
+    if (resource.imageView != VK_NULL_HANDLE)
+        retired.imageViews.push_back(resource.imageView);
+
+    if (reallocate)
+    {
+        createImage(std::max(texture.width >> firstLevel, 1u), std::max(texture.height >> firstLevel, 1u), levelCount,
+            texture.format,
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+            VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            resource.image, resource.imageMemory, texture.layerCount);
+        transitionImageLayout(commandBuffer, resource.image, texture.format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount);
+    }
+    else
+    {
+        transitionImageLayout(commandBuffer, resource.image, texture.format, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            keptLevel - residentLevel, residentLevel - firstLevel);
+    }
+
+    if (reallocate && previousImage != VK_NULL_HANDLE)
+    {
+        transitionImageLayout(commandBuffer, previousImage, texture.format, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            texture.mipCount - previousFirstLevel);
+
+        std::vector<VkImageCopy> regions;
+        for (u32 level = keptLevel; level < texture.mipCount; level++)
+        {
+            VkImageCopy region{};
+            region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - previousFirstLevel, 0, texture.layerCount };
+            region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - firstLevel, 0, texture.layerCount };
+            region.extent = { std::max(texture.width >> level, 1u), std::max(texture.height >> level, 1u), 1 };
+            regions.push_back(region);
+        }
+        vkCmdCopyImage(commandBuffer, previousImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, resource.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<u32>(regions.size()), regions.data());
+
+        retired.images.push_back(previousImage);
+        retired.memory.push_back(previousMemory);
+    }
+
+    if (residentLevel < keptLevel)
+    {
+        VkDeviceSize size = 0;
+        for (u32 level = residentLevel; level < keptLevel; level++)
+            size += TextureCache::GetMipSize(texture.format, texture.width, texture.height, level) * texture.layerCount;
+        u8* data = static_cast<u8*>(createStagingBuffer(size));
+
+        std::vector<VkBufferImageCopy> regions;
+        VkDeviceSize offset = 0;
+        for (u32 level = residentLevel; level < keptLevel; level++)
+        {
+            VkDeviceSize levelSize = TextureCache::GetMipSize(texture.format, texture.width, texture.height, level) * texture.layerCount;
+            memcpy(data + offset, getLevelPixels(texture, level), static_cast<size_t>(levelSize));
+
+            VkBufferImageCopy region{};
+            region.bufferOffset = offset;
+            region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - firstLevel, 0, texture.layerCount };
+            region.imageExtent = { std::max(texture.width >> level, 1u), std::max(texture.height >> level, 1u), 1 };
+            regions.push_back(region);
+            offset += levelSize;
+        }
+        vkCmdCopyBufferToImage(commandBuffer, m_stagingBuffers.back().buffer, resource.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<u32>(regions.size()), regions.data());
+    }
+
+    if (reallocate)
+    {
+        transitionImageLayout(commandBuffer, resource.image, texture.format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, levelCount);
+    }
+    else
+    {
+        transitionImageLayout(commandBuffer, resource.image, texture.format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            keptLevel - residentLevel, residentLevel - firstLevel);
+    }
+
+    resource.mipLevels = levelCount;
+    resource.firstLevel = firstLevel;
+    resource.residentLevel = residentLevel;
+    resource.imageView = createImageView(resource.image, texture.format, VK_IMAGE_ASPECT_COLOR_BIT, texture.mipCount - residentLevel,
+        VK_IMAGE_VIEW_TYPE_2D_ARRAY, texture.layerCount, residentLevel - firstLevel);
+
+    if (!retired.imageViews.empty())
+        m_retired.push_back(std::move(retired));
 }
 
 void Engine::createTextureSampler()
@@ -1093,111 +1723,816 @@ void Engine::createTextureSampler()
     samplerInfo.compareEnable = VK_FALSE;
     samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
     if (vkCreateSampler(m_logicalDevice, &samplerInfo, nullptr, &m_textureSampler) != VK_SUCCESS)
         throw std::runtime_error("Failed to create texture sampler");
 }
 
-void Engine::loadModel(const char* path)
+// As many page slots as the device's largest image holds, up to
+// VIRTUAL_TEXTURE_CACHE_SIZE on a side. Both images start out cleared, so
+// nothing is mapped until the top level page is in.
+void Engine::createVirtualTexture()
 {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+    u32 cacheSize = std::min<u32>(VIRTUAL_TEXTURE_CACHE_SIZE, properties.limits.maxImageDimension2D / VIRTUAL_PAGE_STRIDE);
+    u32 cacheTexels = cacheSize * VIRTUAL_PAGE_STRIDE;
+
+    const TiledTexture& file = m_virtualTexture.GetFile();
+    u32 levelCount = file.GetLevelCount();
+    createImage(file.GetGridSize(), file.GetGridSize(), levelCount, VK_FORMAT_R8G8B8A8_UINT, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_pageTableImage, m_pageTableMemory);
+    m_pageTableView = createImageView(m_pageTableImage, VK_FORMAT_R8G8B8A8_UINT, VK_IMAGE_ASPECT_COLOR_BIT, levelCount);
+    createImage(cacheTexels, cacheTexels, 1, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_pageCacheImage, m_pageCacheMemory);
+    m_pageCacheView = createImageView(m_pageCacheImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path))
-        throw std::runtime_error(warn + err);
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+    VkClearColorValue clearColor{};
+    VkImageSubresourceRange range{ VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1 };
+    transitionImageLayout(commandBuffer, m_pageTableImage, VK_FORMAT_R8G8B8A8_UINT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount);
+    vkCmdClearColorImage(commandBuffer, m_pageTableImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &range);
+    transitionImageLayout(commandBuffer, m_pageTableImage, VK_FORMAT_R8G8B8A8_UINT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, levelCount);
+    transitionImageLayout(commandBuffer, m_pageCacheImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1);
+    vkCmdClearColorImage(commandBuffer, m_pageCacheImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &range);
+    transitionImageLayout(commandBuffer, m_pageCacheImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1);
+    endSingleTimeCommands(commandBuffer);
 
-    std::unordered_map<Vertex, u32> uniqueVertices{};
+    RetiredResources retired{};
+    retired.frame = m_submittedFrames + 1;
+    retired.commandBuffers.push_back(commandBuffer);
+    m_retired.push_back(std::move(retired));
 
-    for (const auto& shape : shapes)
+    // Entries are looked up exactly, the cache is filtered within its pages.
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.maxLod = static_cast<float>(levelCount);
+    if (vkCreateSampler(m_logicalDevice, &samplerInfo, nullptr, &m_pageTableSampler) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create page table sampler");
+
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.maxLod = 0.0f;
+    if (vkCreateSampler(m_logicalDevice, &samplerInfo, nullptr, &m_pageCacheSampler) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create page cache sampler");
+
+    // Upload slots first, then a page table for every frame slot.
+    VkDeviceSize uploadSize = getPageTableStagingOffset(MAX_FRAMES_IN_FLIGHT);
+    createBuffer(uploadSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        m_virtualUploads.buffer, m_virtualUploads.memory);
+    vkMapMemory(m_logicalDevice, m_virtualUploads.memory, 0, uploadSize, 0, &m_virtualUploads.data);
+    m_io.RegisterBuffer(m_virtualUploads.data, uploadSize);
+
+    createFeedbackRenderPass();
+    createFeedbackResources();
+    m_virtualTexture.Create(m_threadPool, m_io, static_cast<u8*>(m_virtualUploads.data), cacheSize);
+}
+
+// After the pool and io, which may still be loading pages.
+void Engine::destroyVirtualTexture()
+{
+    m_virtualTexture.Destroy();
+
+    m_io.UnregisterBuffer(m_virtualUploads.data);
+    vkDestroyBuffer(m_logicalDevice, m_virtualUploads.buffer, nullptr);
+    vkFreeMemory(m_logicalDevice, m_virtualUploads.memory, nullptr);
+
+    vkDestroySampler(m_logicalDevice, m_pageCacheSampler, nullptr);
+    vkDestroyImageView(m_logicalDevice, m_pageCacheView, nullptr);
+    vkDestroyImage(m_logicalDevice, m_pageCacheImage, nullptr);
+    vkFreeMemory(m_logicalDevice, m_pageCacheMemory, nullptr);
+
+    vkDestroySampler(m_logicalDevice, m_pageTableSampler, nullptr);
+    vkDestroyImageView(m_logicalDevice, m_pageTableView, nullptr);
+    vkDestroyImage(m_logicalDevice, m_pageTableImage, nullptr);
+    vkFreeMemory(m_logicalDevice, m_pageTableMemory, nullptr);
+
+    vkDestroyRenderPass(m_logicalDevice, m_feedbackRenderPass, nullptr);
+}
+
+// Leaves the feedback ready to be copied out.
+void Engine::createFeedbackRenderPass()
+{
+    VkAttachmentDescription colorAttachment{};
+    colorAttachment.format = VK_FORMAT_R32_UINT;
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+    VkAttachmentDescription depthAttachment{};
+    depthAttachment.format = findDepthFormat();
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference colorAttachmentRef{};
+    colorAttachmentRef.attachment = 0;
+    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depthAttachmentRef{};
+    depthAttachmentRef.attachment = 1;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    std::array<VkSubpassDependency, 2> dependencies{};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[0].srcAccessMask = 0;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<u32>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = static_cast<u32>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
+
+    if (vkCreateRenderPass(m_logicalDevice, &renderPassInfo, nullptr, &m_feedbackRenderPass) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create feedback render pass");
+}
+
+// The readbacks start out requesting nothing.
+void Engine::createFeedbackResources()
+{
+    m_feedbackExtent.width = std::max(m_swapChainExtent.width / VIRTUAL_TEXTURE_FEEDBACK_SCALE, 1u);
+    m_feedbackExtent.height = std::max(m_swapChainExtent.height / VIRTUAL_TEXTURE_FEEDBACK_SCALE, 1u);
+
+    VkFormat depthFormat = findDepthFormat();
+    createImage(m_feedbackExtent.width, m_feedbackExtent.height, 1, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_feedbackDepthImage, m_feedbackDepthImageMemory);
+    m_feedbackDepthImageView = createImageView(m_feedbackDepthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+
+    VkDeviceSize readbackSize = static_cast<VkDeviceSize>(m_feedbackExtent.width) * m_feedbackExtent.height * sizeof(u32);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
-        for (const auto& index : shape.mesh.indices)
+        createImage(m_feedbackExtent.width, m_feedbackExtent.height, 1, VK_FORMAT_R32_UINT, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            m_feedbackImages[i], m_feedbackImagesMemory[i]);
+        m_feedbackImageViews[i] = createImageView(m_feedbackImages[i], VK_FORMAT_R32_UINT, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+
+        std::array<VkImageView, 2> attachments = { m_feedbackImageViews[i], m_feedbackDepthImageView };
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = m_feedbackRenderPass;
+        framebufferInfo.attachmentCount = static_cast<u32>(attachments.size());
+        framebufferInfo.pAttachments = attachments.data();
+        framebufferInfo.width = m_feedbackExtent.width;
+        framebufferInfo.height = m_feedbackExtent.height;
+        framebufferInfo.layers = 1;
+        if (vkCreateFramebuffer(m_logicalDevice, &framebufferInfo, nullptr, &m_feedbackFramebuffers[i]) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create feedback framebuffer");
+
+        StagingBuffer& readback = m_feedbackReadbacks[i];
+        createBuffer(readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            readback.buffer, readback.memory);
+        vkMapMemory(m_logicalDevice, readback.memory, 0, readbackSize, 0, &readback.data);
+        memset(readback.data, 0xFF, static_cast<size_t>(readbackSize));
+    }
+}
+
+void Engine::destroyFeedbackResources()
+{
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        vkDestroyBuffer(m_logicalDevice, m_feedbackReadbacks[i].buffer, nullptr);
+        vkFreeMemory(m_logicalDevice, m_feedbackReadbacks[i].memory, nullptr);
+        vkDestroyFramebuffer(m_logicalDevice, m_feedbackFramebuffers[i], nullptr);
+        vkDestroyImageView(m_logicalDevice, m_feedbackImageViews[i], nullptr);
+        vkDestroyImage(m_logicalDevice, m_feedbackImages[i], nullptr);
+        vkFreeMemory(m_logicalDevice, m_feedbackImagesMemory[i], nullptr);
+    }
+    m_feedbackReadbacks = {};
+    m_feedbackFramebuffers = {};
+    m_feedbackImageViews = {};
+    m_feedbackImages = {};
+    m_feedbackImagesMemory = {};
+
+    vkDestroyImageView(m_logicalDevice, m_feedbackDepthImageView, nullptr);
+    vkDestroyImage(m_logicalDevice, m_feedbackDepthImage, nullptr);
+    vkFreeMemory(m_logicalDevice, m_feedbackDepthImageMemory, nullptr);
+    m_feedbackDepthImageView = VK_NULL_HANDLE;
+    m_feedbackDepthImage = VK_NULL_HANDLE;
+    m_feedbackDepthImageMemory = VK_NULL_HANDLE;
+}
+
+// The slot's fence has been waited on, so its readback holds the feedback of
+// the frame it last drew.
+void Engine::updateVirtualTexture()
+{
+    u64 frame = m_submittedFrames + 1;
+    const u32* feedback = static_cast<const u32*>(m_feedbackReadbacks[m_currentFrame].data);
+    m_virtualTexture.RequestPages(feedback, static_cast<size_t>(m_feedbackExtent.width) * m_feedbackExtent.height, frame);
+
+    m_pageUploads.clear();
+    m_virtualTexture.CollectUploads(frame, m_completedFrames, m_pageUploads);
+
+    m_pageTableStale = m_virtualTexture.IsPageTableDirty();
+    if (m_pageTableStale)
+    {
+        u8* staging = static_cast<u8*>(m_virtualUploads.data) + getPageTableStagingOffset(m_currentFrame);
+        m_virtualTexture.WritePageTable(reinterpret_cast<u32*>(staging));
+    }
+}
+
+void Engine::recordPageUploads(VkCommandBuffer commandBuffer)
+{
+    if (!m_pageUploads.empty())
+    {
+        std::vector<VkBufferImageCopy> regions;
+        for (const VirtualPageUpload& upload : m_pageUploads)
         {
-            Vertex vertex{};
-
-            vertex.pos =
-            {
-                attrib.vertices[3 * index.vertex_index + 0],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2]
-            };
-
-            vertex.texCoord =
-            {
-                attrib.texcoords[2 * index.texcoord_index + 0],
-                1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-            };
-
-            vertex.color = { 1.0f, 1.0f, 1.0f };
-
-            if (uniqueVertices.count(vertex) == 0)
-            {
-                uniqueVertices[vertex] = static_cast<u32>(m_vertices.size());
-                m_vertices.push_back(vertex);
-            }
-
-            m_indices.push_back(uniqueVertices[vertex]);
+            VkBufferImageCopy region{};
+            region.bufferOffset = static_cast<VkDeviceSize>(upload.uploadSlot) * VIRTUAL_PAGE_BYTES;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = { static_cast<i32>(upload.cacheX * VIRTUAL_PAGE_STRIDE), static_cast<i32>(upload.cacheY * VIRTUAL_PAGE_STRIDE), 0 };
+            region.imageExtent = { VIRTUAL_PAGE_STRIDE, VIRTUAL_PAGE_STRIDE, 1 };
+            regions.push_back(region);
         }
+
+        transitionImageLayout(commandBuffer, m_pageCacheImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1);
+        vkCmdCopyBufferToImage(commandBuffer, m_virtualUploads.buffer, m_pageCacheImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<u32>(regions.size()), regions.data());
+        transitionImageLayout(commandBuffer, m_pageCacheImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1);
+    }
+
+    if (m_pageTableStale)
+    {
+        const TiledTexture& file = m_virtualTexture.GetFile();
+        u32 levelCount = file.GetLevelCount();
+        std::vector<VkBufferImageCopy> regions(levelCount);
+        for (u32 level = 0; level < levelCount; level++)
+        {
+            u32 side = file.GetGridSize() >> level;
+            regions[level].bufferOffset = getPageTableStagingOffset(m_currentFrame) + TiledTexture::GetGridOffset(levelCount, level) * sizeof(u32);
+            regions[level].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            regions[level].imageSubresource.mipLevel = level;
+            regions[level].imageSubresource.layerCount = 1;
+            regions[level].imageExtent = { side, side, 1 };
+        }
+
+        transitionImageLayout(commandBuffer, m_pageTableImage, VK_FORMAT_R8G8B8A8_UINT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount);
+        vkCmdCopyBufferToImage(commandBuffer, m_virtualUploads.buffer, m_pageTableImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            levelCount, regions.data());
+        transitionImageLayout(commandBuffer, m_pageTableImage, VK_FORMAT_R8G8B8A8_UINT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, levelCount);
+    }
+}
+
+// The LOD every submesh draws at, without meshlet culling, biased by the
+// feedback's lower resolution so it asks for the pages the frame samples.
+void Engine::recordFeedbackPass(VkCommandBuffer commandBuffer)
+{
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = m_feedbackRenderPass;
+    renderPassInfo.framebuffer = m_feedbackFramebuffers[m_currentFrame];
+    renderPassInfo.renderArea.offset = { 0, 0 };
+    renderPassInfo.renderArea.extent = m_feedbackExtent;
+
+    std::array<VkClearValue, 2> clearValues{};
+    clearValues[0].color.uint32[0] = VIRTUAL_PAGE_NONE;
+    clearValues[1].depthStencil = { 1.0f, 0 };
+    renderPassInfo.clearValueCount = static_cast<u32>(clearValues.size());
+    renderPassInfo.pClearValues = clearValues.data();
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_feedbackPipeline);
+
+    VkViewport viewport{};
+    viewport.width = static_cast<float>(m_feedbackExtent.width);
+    viewport.height = static_cast<float>(m_feedbackExtent.height);
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.extent = m_feedbackExtent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    const ModelAsset& model = *m_model->asset;
+    VkBuffer vertexBuffers[] = { m_model->vertexBuffer, m_model->vertexBuffer };
+    VkDeviceSize offsets[] = { 0, GetConstantColorOffset(model.layout, model.vertexCount) };
+    vkCmdBindVertexBuffers(commandBuffer, 0, model.layout.constantColor ? 2 : 1, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, m_model->indexBuffer, 0, model.layout.indexType);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSets[m_currentFrame], 0, nullptr);
+
+    VirtualTextureParameters parameters = m_virtualTexture.GetParameters(-std::log2(static_cast<float>(VIRTUAL_TEXTURE_FEEDBACK_SCALE)));
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(parameters), &parameters);
+
+    glm::mat4 objectToView = m_ubo.view * m_ubo.model * glm::inverse(GetDequantizeMatrix(model.layout));
+    for (u32 i = 0; i < model.submeshCount; i++)
+    {
+        const Submesh& submesh = model.submeshData[i];
+        const MeshLod& lod = model.lodData[submesh.firstLod + selectLod(submesh, objectToView, m_ubo.proj)];
+        vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, lod.firstIndex, submesh.vertexOffset, 0);
     }
+
+    vkCmdEndRenderPass(commandBuffer);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = { m_feedbackExtent.width, m_feedbackExtent.height, 1 };
+    vkCmdCopyImageToBuffer(commandBuffer, m_feedbackImages[m_currentFrame], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        m_feedbackReadbacks[m_currentFrame].buffer, 1, &region);
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = m_feedbackReadbacks[m_currentFrame].buffer;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 0, nullptr, 1, &barrier, 0, nullptr);
 }
 
-void Engine::createVertexBuffer()
+VkDeviceSize Engine::getPageTableStagingOffset(u32 frame)
 {
-    VkDeviceSize bufferSize = sizeof(m_vertices[0]) * m_vertices.size();
+    u32 levelCount = m_virtualTexture.GetFile().GetLevelCount();
+    VkDeviceSize pageTableSize = static_cast<VkDeviceSize>(TiledTexture::GetGridOffset(levelCount, levelCount)) * sizeof(u32);
+    return static_cast<VkDeviceSize>(VIRTUAL_TEXTURE_UPLOAD_PAGES) * VIRTUAL_PAGE_BYTES + frame * pageTableSize;
+}
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize,
+VertexPackingOptions Engine::getVertexPackingOptions()
+{
+    auto supportsVertexFetch = [&](VkFormat format)
+    {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &properties);
+        return (properties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT) != 0;
+    };
+
+    VertexPackingOptions options{};
+    options.allowUnorm16Positions = supportsVertexFetch(VK_FORMAT_R16G16B16A16_UNORM);
+    options.allowHalfTexCoords = supportsVertexFetch(VK_FORMAT_R16G16_SFLOAT);
+    return options;
+}
+
+// Only loose files are watched, edits can't reach the ones in the archive.
+void Engine::watchAssets()
+{
+    m_watcher.Create();
+    std::vector<std::string> paths = { MODEL_ASSET_PATH };
+    if (!m_virtualTexturing)
+        paths.insert(paths.end(), m_materialTexturePaths.begin(), m_materialTexturePaths.end());
+    for (const std::string& path : paths)
+    {
+        std::string cookedPath = GetCookedPath(path.c_str());
+        if (IsArchivedFile(path) || IsArchivedFile(cookedPath))
+            continue;
+        m_watcher.Watch(path);
+        m_watcher.Watch(cookedPath);
+    }
+
+    // Only a single material texture is loaded block-compressed.
+    const char* formatName = GetBlockFormatName(m_textureFormat);
+    if (formatName && !m_virtualTexturing && m_materialTexturePaths.size() == 1 && !IsArchivedFile(m_materialTexturePaths[0]))
+        m_watcher.Watch(GetKtx2Path(m_materialTexturePaths[0].c_str(), formatName));
+}
+
+void Engine::loadModel(bool preferCooked)
+{
+    m_modelHandle = LoadModelAsync(m_threadPool, MODEL_ASSET_PATH, getVertexPackingOptions(),
+        [this](size_t size, u32& buffer) { return allocateStreamingStaging(size, buffer); }, preferCooked);
+}
+
+// Textures that are packed together need their pixels on the host and in
+// RGBA8, the packer builds the chain of every layer it composes itself. Host
+// image copies and streamed levels are read from the host too, and need
+// their chain built as well.
+void Engine::loadTexture(u32 material, bool preferCooked)
+{
+    bool hostPixels = m_hostImageCopy || STREAM_TEXTURE_MIPS;
+    if (m_materialTexturePaths.size() == 1)
+        m_textureLoads.Load(m_materialTexturePaths[material], preferCooked, !m_blitMips || hostPixels, m_textureFormat, !hostPixels);
+    else
+        m_textureLoads.Load(m_materialTexturePaths[material], preferCooked, false, VK_FORMAT_R8G8B8A8_SRGB, false);
+}
+
+// A failed load keeps the current asset on screen, the next edit retries it.
+template<typename Asset>
+static std::unique_ptr<Asset> takeAsset(AssetHandle<Asset>& handle)
+{
+    if (!handle.IsReady())
+        return nullptr;
+
+    try
+    {
+        return handle.Take();
+    }
+    catch (const std::exception& exception)
+    {
+        std::cerr << exception.what() << std::endl;
+        return nullptr;
+    }
+}
+
+static bool isCookedFrom(const std::string& path, const char* source)
+{
+    size_t sourceLength = strlen(source);
+    return path.size() > sourceLength && path.compare(0, sourceLength, source) == 0 && path[sourceLength] == '.';
+}
+
+void Engine::pollAssets()
+{
+    // An edited source is loaded past its cooked files, which are stale until
+    // the cooker rewrites them; those writes reload the asset once more. Cooked
+    // files are named after their source with more extensions appended.
+    std::vector<std::string> changed;
+    m_watcher.Poll(changed);
+    for (const std::string& path : changed)
+    {
+        if (path == MODEL_ASSET_PATH || isCookedFrom(path, MODEL_ASSET_PATH))
+            m_modelReload = { true, isCookedFrom(path, MODEL_ASSET_PATH) };
+        for (u32 i = 0; i < m_materialTexturePaths.size(); i++)
+        {
+            const std::string& texturePath = m_materialTexturePaths[i];
+            if (path == texturePath || isCookedFrom(path, texturePath.c_str()))
+                m_textureReloads[i] = { true, isCookedFrom(path, texturePath.c_str()) };
+        }
+    }
+
+    // A reload waits for the load in flight, which may own staging memory.
+    if (m_modelReload.queued && !m_modelHandle.IsPending())
+    {
+        loadModel(m_modelReload.preferCooked);
+        m_modelReload.queued = false;
+    }
+    for (u32 i = 0; i < m_materialTexturePaths.size(); i++)
+    {
+        if (m_textureReloads[i].queued && !m_textureLoads.IsLoading(m_materialTexturePaths[i]))
+        {
+            loadTexture(i, m_textureReloads[i].preferCooked);
+            m_textureReloads[i].queued = false;
+        }
+    }
+
+    // Failed loads are already reported by the scheduler. A single material
+    // texture goes up as it is.
+    std::vector<ScheduledTexture> textures;
+    m_textureLoads.Poll(textures);
+    std::unique_ptr<TextureAsset> texture;
+    std::vector<TextureRegion> regions = { { { 0.0f, 0.0f }, { 1.0f, 1.0f }, 0 } };
+    for (ScheduledTexture& loaded : textures)
+    {
+        for (u32 i = 0; i < m_materialTexturePaths.size() && loaded.texture; i++)
+        {
+            if (loaded.path != m_materialTexturePaths[i])
+                continue;
+            if (m_materialTexturePaths.size() == 1)
+                texture = std::move(loaded.texture);
+            else
+                m_materialTextures[i] = std::move(loaded.texture);
+            m_repackTextures = m_materialTexturePaths.size() > 1;
+        }
+    }
+
+    // Several are packed on the pool once none of them is loading, and again
+    // after every reload.
+    bool complete = std::find(m_materialTextures.begin(), m_materialTextures.end(), nullptr) == m_materialTextures.end();
+    if (m_repackTextures && complete && !m_packedTextures.IsPending() && m_textureLoads.GetPendingCount() == 0)
+    {
+        ThreadPool* workers = &m_threadPool;
+        std::vector<std::shared_ptr<TextureAsset>> sources = m_materialTextures;
+        m_packedTextures = AssetHandle<PackedTextures>(m_threadPool.Submit([workers, sources]()
+        {
+            std::vector<const TextureAsset*> textures;
+            for (const std::shared_ptr<TextureAsset>& source : sources)
+                textures.push_back(source.get());
+            return PackTextures(*workers, textures);
+        }));
+        m_repackTextures = false;
+    }
+
+    std::unique_ptr<PackedTextures> packed = takeAsset(m_packedTextures);
+    if (packed)
+    {
+        texture = std::move(packed->texture);
+        regions = std::move(packed->regions);
+    }
+    if (texture)
+        m_materialRegions = std::move(regions);
+
+    std::string texturePath = m_materialTexturePaths.size() == 1 ? m_materialTexturePaths[0] : std::string(PACKED_TEXTURES_NAME);
+    uploadAssets(MODEL_ASSET_PATH, takeAsset(m_modelHandle), texturePath, std::move(texture));
+}
+
+// Everything that finished loading goes up in one submission ahead of the next
+// frame, which already draws with it. Content that is already on the device,
+// loaded from this path or another, is shared instead of uploaded again. The
+// resources it replaces may still be read by frames in flight, so their
+// handles retire them, and this upload's command and staging buffers, until
+// that next frame has finished. Placeholders have no path and aren't shared.
+void Engine::uploadAssets(const std::string& modelPath, std::unique_ptr<ModelAsset> model,
+    const std::string& texturePath, std::unique_ptr<TextureAsset> texture)
+{
+    if (!model && !texture)
+        return;
+
+    std::shared_ptr<ModelResource> modelResource;
+    std::shared_ptr<TextureResource> textureResource;
+    u64 modelHash = model ? model->contentHash : 0;
+    u64 textureHash = texture ? texture->contentHash : 0;
+    if (model && !modelPath.empty())
+        modelResource = m_models.Find(modelPath, modelHash);
+    if (texture && !texturePath.empty())
+        textureResource = m_textures.Find(texturePath, textureHash);
+
+    // Streamed staging buffers are released with this upload's own, even
+    // when their content turned out to be on the device already.
+    std::vector<u32> streamingStaging;
+    if (model)
+        for (const StagedRange& range : model->stagedRanges)
+            streamingStaging.push_back(range.buffer);
+    if (texture && texture->staged)
+        streamingStaging.push_back(texture->stagingBuffer);
+
+    RetiredResources retired{};
+    retired.frame = m_submittedFrames + 1;
+
+    bool uploadModel = model && !modelResource;
+    bool uploadTexture = texture && !textureResource;
+    if (uploadModel || uploadTexture)
+    {
+        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+        if (uploadModel)
+            modelResource = createModelResource(commandBuffer, std::move(model));
+        if (uploadTexture)
+            textureResource = createTextureResource(commandBuffer, std::move(texture));
+
+        // The texture's layout transition already makes its copies visible.
+        if (uploadModel)
+        {
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+        endSingleTimeCommands(commandBuffer);
+        retired.commandBuffers.push_back(commandBuffer);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_streamingStagingMutex);
+        for (u32 buffer : streamingStaging)
+        {
+            auto staging = m_streamingStaging.find(buffer);
+            if (staging == m_streamingStaging.end())
+                continue;
+            m_stagingBuffers.push_back(staging->second);
+            m_streamingStaging.erase(staging);
+        }
+    }
+    retired.stagingBuffers = std::move(m_stagingBuffers);
+    m_stagingBuffers.clear();
+
+    if (modelResource && !modelPath.empty())
+        m_models.Insert(modelPath, modelHash, modelResource);
+    if (textureResource && !texturePath.empty())
+        m_textures.Insert(texturePath, textureHash, textureResource);
+
+    // The vertex layout is part of the pipeline and changes with the model.
+    if (modelResource && modelResource != m_model)
+    {
+        retired.pipelines.push_back(m_graphicsPipeline);
+        if (m_feedbackPipeline != VK_NULL_HANDLE)
+            retired.pipelines.push_back(m_feedbackPipeline);
+        retired.pipelineLayouts.push_back(m_pipelineLayout);
+        m_model = std::move(modelResource);
+        createGraphicsPipeline();
+    }
+    if (textureResource && textureResource != m_texture)
+    {
+        m_texture = std::move(textureResource);
+        m_staleDescriptorSets = (1u << MAX_FRAMES_IN_FLIGHT) - 1;
+    }
+    m_retired.push_back(std::move(retired));
+}
+
+// The handles are only dropped on the main thread, their deleters retire the
+// device resources until the frames that may still read them have finished.
+std::shared_ptr<Engine::ModelResource> Engine::createModelResource(VkCommandBuffer commandBuffer, std::unique_ptr<ModelAsset> model)
+{
+    std::shared_ptr<ModelResource> resource(new ModelResource(), [this](ModelResource* resource)
+    {
+        RetiredResources retired{};
+        retired.frame = m_submittedFrames + 1;
+        retired.buffers = { resource->indexBuffer, resource->vertexBuffer };
+        retired.memory = { resource->indexBufferMemory, resource->vertexBufferMemory };
+        m_retired.push_back(std::move(retired));
+        delete resource;
+    });
+
+    resource->asset = std::move(model);
+    createVertexBuffer(commandBuffer, *resource);
+    createIndexBuffer(commandBuffer, *resource);
+    return resource;
+}
+
+std::shared_ptr<Engine::TextureResource> Engine::createTextureResource(VkCommandBuffer commandBuffer, std::unique_ptr<TextureAsset> texture)
+{
+    std::shared_ptr<TextureResource> resource(new TextureResource(), [this](TextureResource* resource)
+    {
+        RetiredResources retired{};
+        retired.frame = m_submittedFrames + 1;
+        retired.imageViews = { resource->imageView };
+        retired.images = { resource->image };
+        retired.memory = { resource->imageMemory };
+        m_retired.push_back(std::move(retired));
+        if (resource->streamed != TEXTURE_STREAMING_NONE)
+        {
+            m_textureStreamer.Remove(resource->streamed);
+            m_streamedTextures.erase(resource->streamed);
+        }
+        delete resource;
+    });
+
+    if (!STREAM_TEXTURE_MIPS || !texture->pixelData || !TextureStreamer::IsStreamable(texture->width, texture->height, texture->mipCount))
+    {
+        createTextureImage(commandBuffer, *texture, *resource);
+        return resource;
+    }
+
+    // Only the tail goes up with the texture.
+    resource->streamed = m_textureStreamer.Add(texture->format, texture->width, texture->height, texture->mipCount, texture->layerCount);
+    m_streamedTextures[resource->streamed] = resource.get();
+    resource->asset = std::move(texture);
+    u32 tailLevel = m_textureStreamer.GetFirstLevel(resource->streamed);
+    updateStreamedTexture(commandBuffer, *resource, tailLevel, tailLevel);
+    return resource;
+}
+
+// Returns a mapped, host coherent buffer that is released after the upload
+// that uses it has been submitted.
+void* Engine::createStagingBuffer(VkDeviceSize size)
+{
+    StagingBuffer staging{};
+    createBuffer(size,
         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        stagingBuffer, stagingBufferMemory);
+        staging.buffer, staging.memory);
+    m_stagingBuffers.push_back(staging);
 
     void* data;
-    vkMapMemory(m_logicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, m_vertices.data(), (size_t)bufferSize);
-    vkUnmapMemory(m_logicalDevice, stagingBufferMemory);
+    vkMapMemory(m_logicalDevice, staging.memory, 0, size, 0, &data);
+    return data;
+}
 
-    createBuffer(bufferSize,
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        m_vertexBuffer, m_vertexBufferMemory);
+// Called from pool threads while a model streams in, the buffer stays mapped
+// until the upload that copies from it frees it.
+void* Engine::allocateStreamingStaging(size_t size, u32& buffer)
+{
+    StagingBuffer staging{};
+    createBuffer(size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        staging.buffer, staging.memory);
+
+    vkMapMemory(m_logicalDevice, staging.memory, 0, size, 0, &staging.data);
 
-    copyBuffer(stagingBuffer, m_vertexBuffer, bufferSize);
+    // Texture reads land here, the pages are pinned for them once if the
+    // driver's mapping allows it.
+    m_io.RegisterBuffer(staging.data, size);
 
-    vkDestroyBuffer(m_logicalDevice, stagingBuffer, nullptr);
-    vkFreeMemory(m_logicalDevice, stagingBufferMemory, nullptr);
+    std::lock_guard<std::mutex> lock(m_streamingStagingMutex);
+    buffer = m_nextStreamingStaging++;
+    m_streamingStaging[buffer] = staging;
+    return staging.data;
 }
 
-void Engine::createIndexBuffer()
+void Engine::copyStagedRanges(VkCommandBuffer commandBuffer, const ModelAsset& model, bool index, VkBuffer destination)
 {
-    VkDeviceSize bufferSize = sizeof(m_indices[0]) * m_indices.size();
+    std::lock_guard<std::mutex> lock(m_streamingStagingMutex);
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
+    // Ranges are in allocation order, so one copy per staging buffer.
+    std::vector<VkBufferCopy> regions;
+    for (size_t i = 0; i < model.stagedRanges.size(); i++)
+    {
+        const StagedRange& range = model.stagedRanges[i];
+        if (range.index == index)
+            regions.push_back({ range.sourceOffset, range.destinationOffset, range.size });
+
+        bool last = i + 1 == model.stagedRanges.size() || model.stagedRanges[i + 1].buffer != range.buffer;
+        if (last && !regions.empty())
+        {
+            VkBuffer source = m_streamingStaging.at(range.buffer).buffer;
+            vkCmdCopyBuffer(commandBuffer, source, destination, static_cast<u32>(regions.size()), regions.data());
+            regions.clear();
+        }
+    }
+}
+
+// Retired batches are in frame order, so this stops at the first one still in use.
+void Engine::destroyRetiredResources(u64 completedFrame)
+{
+    while (!m_retired.empty() && m_retired.front().frame <= completedFrame)
+    {
+        RetiredResources& retired = m_retired.front();
+        for (VkPipeline pipeline : retired.pipelines)
+            vkDestroyPipeline(m_logicalDevice, pipeline, nullptr);
+        for (VkPipelineLayout layout : retired.pipelineLayouts)
+            vkDestroyPipelineLayout(m_logicalDevice, layout, nullptr);
+        for (VkImageView view : retired.imageViews)
+            vkDestroyImageView(m_logicalDevice, view, nullptr);
+        for (VkImage image : retired.images)
+            vkDestroyImage(m_logicalDevice, image, nullptr);
+        for (VkBuffer buffer : retired.buffers)
+            vkDestroyBuffer(m_logicalDevice, buffer, nullptr);
+        for (VkDeviceMemory memory : retired.memory)
+            vkFreeMemory(m_logicalDevice, memory, nullptr);
+
+        for (const StagingBuffer& staging : retired.stagingBuffers)
+        {
+            m_io.UnregisterBuffer(staging.data);
+            vkDestroyBuffer(m_logicalDevice, staging.buffer, nullptr);
+            vkFreeMemory(m_logicalDevice, staging.memory, nullptr);
+        }
+
+        if (!retired.commandBuffers.empty())
+            vkFreeCommandBuffers(m_logicalDevice, m_commandPool, static_cast<u32>(retired.commandBuffers.size()), retired.commandBuffers.data());
+        m_retired.pop_front();
+    }
+}
+
+void Engine::createVertexBuffer(VkCommandBuffer commandBuffer, ModelResource& model)
+{
+    const ModelAsset& asset = *model.asset;
+    VkDeviceSize bufferSize = GetPackedVertexSize(asset.layout, asset.vertexCount);
     createBuffer(bufferSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        stagingBuffer, stagingBufferMemory);
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        model.vertexBuffer, model.vertexBufferMemory);
 
-    void* data;
-    vkMapMemory(m_logicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, m_indices.data(), (size_t)bufferSize);
-    vkUnmapMemory(m_logicalDevice, stagingBufferMemory);
+    if (!asset.stagedRanges.empty())
+    {
+        copyStagedRanges(commandBuffer, asset, false, model.vertexBuffer);
+        return;
+    }
 
+    void* data = createStagingBuffer(bufferSize);
+    PackModelVertices(asset, data);
+    copyBuffer(commandBuffer, m_stagingBuffers.back().buffer, model.vertexBuffer, bufferSize);
+}
+
+void Engine::createIndexBuffer(VkCommandBuffer commandBuffer, ModelResource& model)
+{
+    const ModelAsset& asset = *model.asset;
+    VkDeviceSize bufferSize = GetPackedIndexSize(asset.layout, asset.indexCount);
     createBuffer(bufferSize,
         VK_BUFFER_USAGE_TRANSFER_DST_BIT |
         VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        m_indexBuffer, m_indexBufferMemory);
+        model.indexBuffer, model.indexBufferMemory);
 
-    copyBuffer(stagingBuffer, m_indexBuffer, bufferSize);
+    if (!asset.stagedRanges.empty())
+    {
+        copyStagedRanges(commandBuffer, asset, true, model.indexBuffer);
+        return;
+    }
 
-    vkDestroyBuffer(m_logicalDevice, stagingBuffer, nullptr);
-    vkFreeMemory(m_logicalDevice, stagingBufferMemory, nullptr);
+    void* data = createStagingBuffer(bufferSize);
+    PackModelIndices(asset, data);
+    copyBuffer(commandBuffer, m_stagingBuffers.back().buffer, model.indexBuffer, bufferSize);
 }
 
 void Engine::createUniformBuffers()
@@ -1225,7 +2560,7 @@ void Engine::createDescriptorPool()
     poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     poolSizes[0].descriptorCount = static_cast<u32>(MAX_FRAMES_IN_FLIGHT);
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSizes[1].descriptorCount = static_cast<u32>(MAX_FRAMES_IN_FLIGHT);
+    poolSizes[1].descriptorCount = static_cast<u32>(MAX_FRAMES_IN_FLIGHT) * (m_virtualTexturing ? 3 : 1);
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -1250,38 +2585,59 @@ void Engine::createDescriptorSets()
     if (vkAllocateDescriptorSets(m_logicalDevice, &allocInfo, m_descriptorSets.data()) != VK_SUCCESS)
         throw std::runtime_error("Failed to allocate descriptor sets");
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-    {
-        VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = m_uniformBuffers[i];
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeof(UniformBufferObject);
-
-        VkDescriptorImageInfo imageInfo{};
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = m_textureImageView;
-        imageInfo.sampler = m_textureSampler;
-
-        std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
-
-        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].dstSet = m_descriptorSets[i];
-        descriptorWrites[0].dstBinding = 0;
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pBufferInfo = &bufferInfo;
-
-        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[1].dstSet = m_descriptorSets[i];
-        descriptorWrites[1].dstBinding = 1;
-        descriptorWrites[1].dstArrayElement = 0;
-        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrites[1].descriptorCount = 1;
-        descriptorWrites[1].pImageInfo = &imageInfo;
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        updateDescriptorSet(i);
+}
 
-        vkUpdateDescriptorSets(m_logicalDevice, static_cast<u32>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-    }
+void Engine::updateDescriptorSet(u32 frame)
+{
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = m_uniformBuffers[frame];
+    bufferInfo.offset = 0;
+    bufferInfo.range = sizeof(UniformBufferObject);
+
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = m_texture->imageView;
+    imageInfo.sampler = m_textureSampler;
+
+    VkDescriptorImageInfo pageTableInfo{};
+    pageTableInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    pageTableInfo.imageView = m_virtualTexturing ? m_pageTableView : VK_NULL_HANDLE;
+    pageTableInfo.sampler = m_virtualTexturing ? m_pageTableSampler : VK_NULL_HANDLE;
+
+    VkDescriptorImageInfo pageCacheInfo{};
+    pageCacheInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    pageCacheInfo.imageView = m_virtualTexturing ? m_pageCacheView : VK_NULL_HANDLE;
+    pageCacheInfo.sampler = m_virtualTexturing ? m_pageCacheSampler : VK_NULL_HANDLE;
+
+    std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+
+    descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[0].dstSet = m_descriptorSets[frame];
+    descriptorWrites[0].dstBinding = 0;
+    descriptorWrites[0].dstArrayElement = 0;
+    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descriptorWrites[0].descriptorCount = 1;
+    descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+    descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[1].dstSet = m_descriptorSets[frame];
+    descriptorWrites[1].dstBinding = 1;
+    descriptorWrites[1].dstArrayElement = 0;
+    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrites[1].descriptorCount = 1;
+    descriptorWrites[1].pImageInfo = &imageInfo;
+
+    descriptorWrites[2] = descriptorWrites[1];
+    descriptorWrites[2].dstBinding = 2;
+    descriptorWrites[2].pImageInfo = &pageTableInfo;
+
+    descriptorWrites[3] = descriptorWrites[1];
+    descriptorWrites[3].dstBinding = 3;
+    descriptorWrites[3].pImageInfo = &pageCacheInfo;
+
+    vkUpdateDescriptorSets(m_logicalDevice, m_virtualTexturing ? 4 : 2, descriptorWrites.data(), 0, nullptr);
 }
 
 void Engine::createCommandBuffers()
@@ -1320,6 +2676,9 @@ void Engine::createSyncObjects()
 
 void Engine::cleanupSwapChain()
 {
+    if (m_virtualTexturing)
+        destroyFeedbackResources();
+
     vkDestroyImageView(m_logicalDevice, m_depthImageView, nullptr);
     vkDestroyImage(m_logicalDevice, m_depthImage, nullptr);
     vkFreeMemory(m_logicalDevice, m_depthImageMemory, nullptr);
@@ -1349,4 +2708,9 @@ void Engine::recreateSwapChain(Window* window)
     createImageViews();
     createDepthResources();
     createFramebuffers();
+    if (m_virtualTexturing)
+    {
+        destroyFeedbackResources();
+        createFeedbackResources();
+    }
 }
\ No newline at end of file
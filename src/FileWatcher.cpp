@@ -0,0 +1,131 @@
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+
+#include <FileWatcher.hpp>
+
+static std::string getKey(const std::filesystem::path& path)
+{
+    std::error_code error;
+    return std::filesystem::absolute(path, error).lexically_normal().generic_string();
+}
+
+FileWatcher::~FileWatcher()
+{
+    Destroy();
+}
+
+void FileWatcher::Create()
+{
+    Destroy();
+
+#ifdef __linux__
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+    m_lastPoll = std::chrono::steady_clock::now();
+}
+
+void FileWatcher::Destroy()
+{
+#ifdef __linux__
+    if (m_inotify >= 0)
+        close(m_inotify);
+#endif
+    m_inotify = -1;
+    m_paths.clear();
+    m_states.clear();
+    m_directories.clear();
+}
+
+void FileWatcher::Watch(const std::string& path)
+{
+    std::string key = getKey(path);
+    std::vector<std::string>& paths = m_paths[key];
+    if (std::find(paths.begin(), paths.end(), path) == paths.end())
+        paths.push_back(path);
+    m_states[key] = getState(path);
+
+#ifdef __linux__
+    if (m_inotify < 0)
+        return;
+
+    // One watch per directory, adding it again returns the same descriptor.
+    std::string directory = std::filesystem::path(key).parent_path().generic_string();
+    int watch = inotify_add_watch(m_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (watch >= 0)
+        m_directories[watch] = directory;
+#endif
+}
+
+void FileWatcher::Poll(std::vector<std::string>& changed)
+{
+    size_t first = changed.size();
+    if (m_inotify >= 0)
+    {
+        readEvents(changed);
+    }
+    else if (std::chrono::steady_clock::now() - m_lastPoll >= std::chrono::milliseconds(FILE_WATCHER_POLL_INTERVAL_MS))
+    {
+        m_lastPoll = std::chrono::steady_clock::now();
+        pollStates(changed);
+    }
+
+    std::sort(changed.begin() + first, changed.end());
+    changed.erase(std::unique(changed.begin() + first, changed.end()), changed.end());
+}
+
+FileWatcher::FileState FileWatcher::getState(const std::string& path)
+{
+    FileState state{};
+    std::error_code error;
+    state.writeTime = std::filesystem::last_write_time(path, error);
+    state.exists = !error;
+    if (state.exists)
+        state.size = static_cast<u64>(std::filesystem::file_size(path, error));
+    return state;
+}
+
+// A file that disappears isn't reported, only once it is back.
+void FileWatcher::pollStates(std::vector<std::string>& changed)
+{
+    for (const auto& path : m_paths)
+    {
+        FileState state = getState(path.first);
+        FileState& previous = m_states[path.first];
+        if (state.exists && (!previous.exists || state.writeTime != previous.writeTime || state.size != previous.size))
+            changed.insert(changed.end(), path.second.begin(), path.second.end());
+        previous = state;
+    }
+}
+
+void FileWatcher::readEvents(std::vector<std::string>& changed)
+{
+#ifdef __linux__
+    alignas(inotify_event) char buffer[4096];
+    while (true)
+    {
+        ssize_t size = read(m_inotify, buffer, sizeof(buffer));
+        if (size <= 0)
+            return;
+
+        for (ssize_t offset = 0; offset < size;)
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            auto directory = m_directories.find(event->wd);
+            if (directory == m_directories.end() || event->len == 0)
+                continue;
+
+            auto path = m_paths.find(getKey(std::filesystem::path(directory->second) / event->name));
+            if (path != m_paths.end())
+                changed.insert(changed.end(), path->second.begin(), path->second.end());
+        }
+    }
+#else
+    (void)changed;
+#endif
+}
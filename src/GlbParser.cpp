@@ -0,0 +1,511 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <GlbParser.hpp>
+
+#define GLB_MAGIC 0x46546C67
+#define GLB_CHUNK_JSON 0x4E4F534A
+#define GLB_CHUNK_BIN 0x004E4942
+#define GLB_MODE_TRIANGLES 4
+
+// Just enough of a JSON DOM for the glTF header chunk.
+typedef struct JsonValue
+{
+    enum Type { Null, Bool, Number, String, Array, Object } type = Null;
+    double number = 0.0;
+    std::string string;
+
+    // Array elements, or object members with their names in keys.
+    std::vector<JsonValue> values;
+    std::vector<std::string> keys;
+
+    const JsonValue* Find(const char* key) const
+    {
+        for (size_t i = 0; i < keys.size(); i++)
+            if (keys[i] == key)
+                return &values[i];
+        return nullptr;
+    }
+} JsonValue;
+
+typedef struct JsonReader
+{
+    const char* p;
+    const char* end;
+} JsonReader;
+
+static void jsonFail()
+{
+    throw std::runtime_error("Malformed GLB JSON chunk");
+}
+
+static void skipSpaces(JsonReader& reader)
+{
+    while (reader.p < reader.end && (*reader.p == ' ' || *reader.p == '\t' || *reader.p == '\n' || *reader.p == '\r'))
+        reader.p++;
+}
+
+static bool consume(JsonReader& reader, char c)
+{
+    skipSpaces(reader);
+    if (reader.p < reader.end && *reader.p == c)
+    {
+        reader.p++;
+        return true;
+    }
+    return false;
+}
+
+static void appendUtf8(std::string& output, u32 codepoint)
+{
+    if (codepoint < 0x80)
+    {
+        output += static_cast<char>(codepoint);
+    }
+    else if (codepoint < 0x800)
+    {
+        output += static_cast<char>(0xC0 | (codepoint >> 6));
+        output += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+    else
+    {
+        output += static_cast<char>(0xE0 | (codepoint >> 12));
+        output += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        output += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+}
+
+static std::string parseString(JsonReader& reader)
+{
+    if (!consume(reader, '"'))
+        jsonFail();
+
+    std::string result;
+    while (reader.p < reader.end && *reader.p != '"')
+    {
+        char c = *reader.p++;
+        if (c != '\\')
+        {
+            result += c;
+            continue;
+        }
+
+        if (reader.p >= reader.end)
+            jsonFail();
+        char escape = *reader.p++;
+        switch (escape)
+        {
+        case 'b': result += '\b'; break;
+        case 'f': result += '\f'; break;
+        case 'n': result += '\n'; break;
+        case 'r': result += '\r'; break;
+        case 't': result += '\t'; break;
+        case 'u':
+        {
+            if (reader.end - reader.p < 4)
+                jsonFail();
+            char hex[5] = { reader.p[0], reader.p[1], reader.p[2], reader.p[3], 0 };
+            appendUtf8(result, static_cast<u32>(strtoul(hex, nullptr, 16)));
+            reader.p += 4;
+            break;
+        }
+        default: result += escape; break;
+        }
+    }
+
+    if (reader.p >= reader.end)
+        jsonFail();
+    reader.p++;
+    return result;
+}
+
+static bool matchWord(JsonReader& reader, const char* word)
+{
+    size_t length = strlen(word);
+    if (static_cast<size_t>(reader.end - reader.p) < length || memcmp(reader.p, word, length) != 0)
+        return false;
+    reader.p += length;
+    return true;
+}
+
+static void parseValue(JsonReader& reader, JsonValue& value, u32 depth)
+{
+    if (depth > 64)
+        jsonFail();
+
+    skipSpaces(reader);
+    if (reader.p >= reader.end)
+        jsonFail();
+
+    char c = *reader.p;
+    if (c == '{')
+    {
+        reader.p++;
+        value.type = JsonValue::Object;
+        if (consume(reader, '}'))
+            return;
+        do
+        {
+            value.keys.push_back(parseString(reader));
+            if (!consume(reader, ':'))
+                jsonFail();
+            value.values.emplace_back();
+            parseValue(reader, value.values.back(), depth + 1);
+        } while (consume(reader, ','));
+        if (!consume(reader, '}'))
+            jsonFail();
+    }
+    else if (c == '[')
+    {
+        reader.p++;
+        value.type = JsonValue::Array;
+        if (consume(reader, ']'))
+            return;
+        do
+        {
+            value.values.emplace_back();
+            parseValue(reader, value.values.back(), depth + 1);
+        } while (consume(reader, ','));
+        if (!consume(reader, ']'))
+            jsonFail();
+    }
+    else if (c == '"')
+    {
+        value.type = JsonValue::String;
+        value.string = parseString(reader);
+    }
+    else if (matchWord(reader, "true"))
+    {
+        value.type = JsonValue::Bool;
+        value.number = 1.0;
+    }
+    else if (matchWord(reader, "false"))
+    {
+        value.type = JsonValue::Bool;
+    }
+    else if (matchWord(reader, "null"))
+    {
+        value.type = JsonValue::Null;
+    }
+    else
+    {
+        // The chunk is not null terminated, so copy the number out for strtod.
+        char buffer[64];
+        size_t length = 0;
+        while (reader.p + length < reader.end && length + 1 < sizeof(buffer) &&
+            reader.p[length] != 0 && strchr("+-0123456789.eE", reader.p[length]))
+            length++;
+        if (length == 0)
+            jsonFail();
+        memcpy(buffer, reader.p, length);
+        buffer[length] = 0;
+        value.type = JsonValue::Number;
+        value.number = strtod(buffer, nullptr);
+        reader.p += length;
+    }
+}
+
+static const JsonValue& member(const JsonValue& object, const char* key)
+{
+    const JsonValue* value = object.Find(key);
+    if (!value)
+        throw std::runtime_error(std::string("GLB is missing ") + key);
+    return *value;
+}
+
+static u32 memberU32(const JsonValue& object, const char* key, u32 fallback)
+{
+    const JsonValue* value = object.Find(key);
+    if (!value)
+        return fallback;
+    if (value->type != JsonValue::Number || value->number < 0.0 || value->number > 4294967295.0)
+        throw std::runtime_error(std::string("GLB has an invalid ") + key);
+    return static_cast<u32>(value->number);
+}
+
+static const JsonValue& element(const JsonValue& array, u32 index)
+{
+    if (array.type != JsonValue::Array || index >= array.values.size())
+        throw std::runtime_error("GLB references an element out of range");
+    return array.values[index];
+}
+
+static u32 componentSize(u32 componentType)
+{
+    switch (componentType)
+    {
+    case GLB_COMPONENT_BYTE:
+    case GLB_COMPONENT_UNSIGNED_BYTE: return 1;
+    case GLB_COMPONENT_SHORT:
+    case GLB_COMPONENT_UNSIGNED_SHORT: return 2;
+    case GLB_COMPONENT_UNSIGNED_INT:
+    case GLB_COMPONENT_FLOAT: return 4;
+    default: throw std::runtime_error("GLB accessor has an unsupported component type");
+    }
+}
+
+static u32 componentCount(const std::string& type)
+{
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    throw std::runtime_error("GLB accessor has an unsupported type " + type);
+}
+
+static GlbAccessor parseAccessor(const JsonValue& json, u32 index, const u8* bin, size_t binSize)
+{
+    const JsonValue& accessor = element(member(json, "accessors"), index);
+    if (accessor.Find("sparse"))
+        throw std::runtime_error("GLB sparse accessors are not supported");
+
+    GlbAccessor result{};
+    result.count = memberU32(accessor, "count", 0);
+    result.componentType = memberU32(accessor, "componentType", 0);
+    result.componentCount = componentCount(member(accessor, "type").string);
+    const JsonValue* normalized = accessor.Find("normalized");
+    result.normalized = normalized && normalized->number != 0.0;
+
+    const JsonValue& view = element(member(json, "bufferViews"), memberU32(accessor, "bufferView", ~0u));
+    if (memberU32(view, "buffer", 0) != 0)
+        throw std::runtime_error("GLB buffer views must reference the BIN chunk");
+
+    u32 elementSize = componentSize(result.componentType) * result.componentCount;
+    size_t viewOffset = memberU32(view, "byteOffset", 0);
+    size_t viewLength = memberU32(view, "byteLength", 0);
+    size_t accessorOffset = memberU32(accessor, "byteOffset", 0);
+    result.stride = memberU32(view, "byteStride", elementSize);
+
+    size_t extent = result.count == 0 ? 0 : accessorOffset + size_t(result.stride) * (result.count - 1) + elementSize;
+    if (viewOffset + viewLength > binSize || extent > viewLength)
+        throw std::runtime_error("GLB accessor reaches past its buffer view");
+    result.data = bin + viewOffset + accessorOffset;
+
+    const JsonValue* minimum = accessor.Find("min");
+    const JsonValue* maximum = accessor.Find("max");
+    if (minimum && maximum && minimum->values.size() >= 3 && maximum->values.size() >= 3)
+    {
+        result.hasBounds = true;
+        for (int c = 0; c < 3; c++)
+        {
+            result.minimum[c] = static_cast<float>(minimum->values[c].number);
+            result.maximum[c] = static_cast<float>(maximum->values[c].number);
+        }
+    }
+    return result;
+}
+
+void ParseGlb(const char* data, size_t size, GlbData& glb)
+{
+    u32 header[5];
+    if (size < sizeof(header))
+        throw std::runtime_error("GLB file is truncated");
+    memcpy(header, data, sizeof(header));
+    if (header[0] != GLB_MAGIC || header[1] != 2 || header[2] > size || header[4] != GLB_CHUNK_JSON)
+        throw std::runtime_error("Not a glTF 2.0 binary file");
+
+    size_t jsonLength = header[3];
+    size_t binOffset = sizeof(header) + ((jsonLength + 3) & ~size_t(3));
+    if (binOffset > header[2])
+        throw std::runtime_error("GLB file is truncated");
+
+    const u8* bin = nullptr;
+    size_t binSize = 0;
+    if (binOffset + 8 <= header[2])
+    {
+        u32 chunk[2];
+        memcpy(chunk, data + binOffset, sizeof(chunk));
+        if (chunk[1] == GLB_CHUNK_BIN && binOffset + 8 + chunk[0] <= header[2])
+        {
+            bin = reinterpret_cast<const u8*>(data + binOffset + 8);
+            binSize = chunk[0];
+        }
+    }
+
+    JsonValue json;
+    JsonReader reader{ data + sizeof(header), data + sizeof(header) + jsonLength };
+    parseValue(reader, json, 0);
+    if (json.type != JsonValue::Object)
+        jsonFail();
+
+    glb = GlbData{};
+
+    const JsonValue* materials = json.Find("materials");
+    if (materials)
+        for (size_t i = 0; i < materials->values.size(); i++)
+        {
+            const JsonValue* name = materials->values[i].Find("name");
+            glb.materials.push_back(name ? name->string : "material" + std::to_string(i));
+        }
+    u32 defaultMaterial = static_cast<u32>(glb.materials.size());
+    glb.materials.push_back("");
+
+    const JsonValue* meshes = json.Find("meshes");
+    if (!meshes)
+        return;
+
+    for (size_t m = 0; m < meshes->values.size(); m++)
+    {
+        const JsonValue& mesh = meshes->values[m];
+        const JsonValue* name = mesh.Find("name");
+        glb.meshes.push_back(name ? name->string : "mesh" + std::to_string(m));
+
+        for (const JsonValue& primitive : member(mesh, "primitives").values)
+        {
+            if (memberU32(primitive, "mode", GLB_MODE_TRIANGLES) != GLB_MODE_TRIANGLES)
+                continue;
+
+            const JsonValue& attributes = member(primitive, "attributes");
+            GlbPrimitive result{};
+            result.mesh = static_cast<u32>(m);
+            result.material = memberU32(primitive, "material", defaultMaterial);
+            if (result.material > defaultMaterial)
+                throw std::runtime_error("GLB primitive references a missing material");
+
+            result.position = parseAccessor(json, memberU32(attributes, "POSITION", ~0u), bin, binSize);
+            if (result.position.componentType != GLB_COMPONENT_FLOAT || result.position.componentCount != 3)
+                throw std::runtime_error("GLB positions must be float3");
+
+            if (attributes.Find("COLOR_0"))
+                result.color = parseAccessor(json, memberU32(attributes, "COLOR_0", 0), bin, binSize);
+            if (attributes.Find("TEXCOORD_0"))
+                result.texCoord = parseAccessor(json, memberU32(attributes, "TEXCOORD_0", 0), bin, binSize);
+            if (primitive.Find("indices"))
+            {
+                result.indices = parseAccessor(json, memberU32(primitive, "indices", 0), bin, binSize);
+                if (result.indices.componentCount != 1 || result.indices.componentType == GLB_COMPONENT_FLOAT)
+                    throw std::runtime_error("GLB indices must be unsigned integers");
+                for (u32 i = 0; i < result.indices.count; i++)
+                    if (FetchGlbIndex(result.indices, i) >= result.position.count)
+                        throw std::runtime_error("GLB index out of range");
+            }
+
+            if ((result.color.data && (result.color.count < result.position.count || result.color.componentCount < 3)) ||
+                (result.texCoord.data && (result.texCoord.count < result.position.count || result.texCoord.componentCount != 2)))
+                throw std::runtime_error("GLB primitive has mismatched attributes");
+
+            u32 cornerCount = result.indices.data ? result.indices.count : result.position.count;
+            if (cornerCount % 3 != 0)
+                throw std::runtime_error("GLB primitive has a partial triangle");
+
+            glb.primitives.push_back(result);
+        }
+    }
+}
+
+static float readComponent(const GlbAccessor& accessor, const u8* element, u32 component)
+{
+    switch (accessor.componentType)
+    {
+    case GLB_COMPONENT_FLOAT:
+    {
+        float value;
+        memcpy(&value, element + component * 4, sizeof(value));
+        return value;
+    }
+    case GLB_COMPONENT_UNSIGNED_BYTE:
+    {
+        float value = element[component];
+        return accessor.normalized ? value / 255.0f : value;
+    }
+    case GLB_COMPONENT_UNSIGNED_SHORT:
+    {
+        u16 value;
+        memcpy(&value, element + component * 2, sizeof(value));
+        return accessor.normalized ? value / 65535.0f : value;
+    }
+    case GLB_COMPONENT_BYTE:
+    {
+        float value = static_cast<int8_t>(element[component]);
+        return accessor.normalized ? std::max(value / 127.0f, -1.0f) : value;
+    }
+    case GLB_COMPONENT_SHORT:
+    {
+        int16_t value;
+        memcpy(&value, element + component * 2, sizeof(value));
+        return accessor.normalized ? std::max(value / 32767.0f, -1.0f) : value;
+    }
+    default:
+    {
+        u32 value;
+        memcpy(&value, element + component * 4, sizeof(value));
+        return static_cast<float>(value);
+    }
+    }
+}
+
+Vertex FetchGlbVertex(const GlbPrimitive& primitive, u32 index)
+{
+    Vertex vertex{};
+
+    const u8* position = primitive.position.data + size_t(primitive.position.stride) * index;
+    for (u32 c = 0; c < 3; c++)
+        vertex.pos[c] = readComponent(primitive.position, position, c);
+
+    vertex.color = { 1.0f, 1.0f, 1.0f };
+    if (primitive.color.data)
+    {
+        const u8* color = primitive.color.data + size_t(primitive.color.stride) * index;
+        for (u32 c = 0; c < 3; c++)
+            vertex.color[c] = readComponent(primitive.color, color, c);
+    }
+
+    if (primitive.texCoord.data)
+    {
+        const u8* texCoord = primitive.texCoord.data + size_t(primitive.texCoord.stride) * index;
+        for (u32 c = 0; c < 2; c++)
+            vertex.texCoord[c] = readComponent(primitive.texCoord, texCoord, c);
+    }
+
+    return vertex;
+}
+
+u32 FetchGlbIndex(const GlbAccessor& indices, u32 index)
+{
+    const u8* element = indices.data + size_t(indices.stride) * index;
+    switch (indices.componentType)
+    {
+    case GLB_COMPONENT_UNSIGNED_BYTE:
+        return element[0];
+    case GLB_COMPONENT_UNSIGNED_SHORT:
+    {
+        u16 value;
+        memcpy(&value, element, sizeof(value));
+        return value;
+    }
+    default:
+    {
+        u32 value;
+        memcpy(&value, element, sizeof(value));
+        return value;
+    }
+    }
+}
+
+void CopyGlbIndices(const GlbAccessor& indices, VkIndexType indexType, void* destination)
+{
+    u32 size = indexType == VK_INDEX_TYPE_UINT16 ? sizeof(u16) : sizeof(u32);
+    u32 componentType = indexType == VK_INDEX_TYPE_UINT16 ? GLB_COMPONENT_UNSIGNED_SHORT : GLB_COMPONENT_UNSIGNED_INT;
+
+    if (indices.componentType == componentType && indices.stride == size)
+    {
+        memcpy(destination, indices.data, size_t(indices.count) * size);
+        return;
+    }
+
+    if (indexType == VK_INDEX_TYPE_UINT16)
+    {
+        u16* output = static_cast<u16*>(destination);
+        for (u32 i = 0; i < indices.count; i++)
+            output[i] = static_cast<u16>(FetchGlbIndex(indices, i));
+    }
+    else
+    {
+        u32* output = static_cast<u32*>(destination);
+        for (u32 i = 0; i < indices.count; i++)
+            output[i] = FetchGlbIndex(indices, i);
+    }
+}
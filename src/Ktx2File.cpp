@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <Ktx2File.hpp>
+#include <TextureCache.hpp>
+
+// Values from the Khronos Data Format specification for the descriptor every
+// KTX2 file carries.
+#define KHR_DF_MODEL_RGBSDA 1
+#define KHR_DF_MODEL_BC1A 128
+#define KHR_DF_MODEL_BC3 130
+#define KHR_DF_MODEL_BC7 134
+#define KHR_DF_PRIMARIES_BT709 1
+#define KHR_DF_TRANSFER_LINEAR 1
+#define KHR_DF_TRANSFER_SRGB 2
+#define KHR_DF_CHANNEL_ALPHA 15
+#define KHR_DF_SAMPLE_DATATYPE_LINEAR 0x10
+
+static const u8 ktx2Identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+typedef struct DescriptorSample
+{
+    u32 bitOffset;
+    u32 bitLength;
+    u32 channel;
+    u32 upper;
+} DescriptorSample;
+
+static u64 alignUp(u64 value, u64 alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// The basic descriptor block with its total size in front, empty for formats
+// this can't describe. Alpha is never sRGB encoded, so its sample is marked
+// linear in sRGB formats.
+static std::vector<u32> getFormatDescriptor(VkFormat format)
+{
+    bool srgb = format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK ||
+        format == VK_FORMAT_BC3_SRGB_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK;
+    u32 alpha = KHR_DF_CHANNEL_ALPHA | (srgb ? KHR_DF_SAMPLE_DATATYPE_LINEAR : 0);
+
+    u32 model, blockSize = 4, bytesPlane0;
+    std::vector<DescriptorSample> samples;
+    switch (format)
+    {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        model = KHR_DF_MODEL_RGBSDA;
+        blockSize = 1;
+        bytesPlane0 = 4;
+        samples = { { 0, 8, 0, 255 }, { 8, 8, 1, 255 }, { 16, 8, 2, 255 }, { 24, 8, alpha, 255 } };
+        break;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        model = KHR_DF_MODEL_BC1A;
+        bytesPlane0 = 8;
+        samples = { { 0, 64, 0, UINT32_MAX } };
+        break;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+        model = KHR_DF_MODEL_BC3;
+        bytesPlane0 = 16;
+        samples = { { 0, 64, alpha, UINT32_MAX }, { 64, 64, 0, UINT32_MAX } };
+        break;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        model = KHR_DF_MODEL_BC7;
+        bytesPlane0 = 16;
+        samples = { { 0, 128, 0, UINT32_MAX } };
+        break;
+    default:
+        return {};
+    }
+
+    u32 descriptorBlockSize = 24 + 16 * static_cast<u32>(samples.size());
+    std::vector<u32> words =
+    {
+        4 + descriptorBlockSize,
+        0,
+        2 | (descriptorBlockSize << 16),
+        model | (KHR_DF_PRIMARIES_BT709 << 8) | ((srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16),
+        (blockSize - 1) | ((blockSize - 1) << 8),
+        bytesPlane0,
+        0,
+    };
+    for (const DescriptorSample& sample : samples)
+    {
+        words.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (sample.channel << 24));
+        words.push_back(0);
+        words.push_back(0);
+        words.push_back(sample.upper);
+    }
+    return words;
+}
+
+static void appendKeyValue(std::vector<u8>& data, const char* key, const void* value, size_t size)
+{
+    u32 length = static_cast<u32>(strlen(key) + 1 + size);
+    const u8* lengthBytes = reinterpret_cast<const u8*>(&length);
+    data.insert(data.end(), lengthBytes, lengthBytes + sizeof(length));
+    data.insert(data.end(), key, key + strlen(key) + 1);
+    data.insert(data.end(), static_cast<const u8*>(value), static_cast<const u8*>(value) + size);
+    data.resize(alignUp(data.size(), 4));
+}
+
+bool Ktx2File::Write(const std::string& path, const AssetDependencies& dependencies,
+    VkFormat format, u32 width, u32 height, u32 mipCount, const u8* data, size_t size)
+{
+    std::vector<u32> descriptor = getFormatDescriptor(format);
+    if (descriptor.empty() || mipCount == 0 || mipCount > 32)
+        return false;
+
+    // Keys are sorted.
+    const char* writer = "AssetCooker";
+    std::vector<u8> keyValues;
+    appendKeyValue(keyValues, "KTXwriter", writer, strlen(writer) + 1);
+    appendKeyValue(keyValues, KTX2_DEPENDENCIES_KEY, &dependencies, sizeof(dependencies));
+
+    Ktx2Header header{};
+    memcpy(header.identifier, ktx2Identifier, sizeof(ktx2Identifier));
+    header.vkFormat = static_cast<u32>(format);
+    header.typeSize = 1;
+    header.pixelWidth = width;
+    header.pixelHeight = height;
+    header.faceCount = 1;
+    header.levelCount = mipCount;
+    header.dfdByteOffset = static_cast<u32>(sizeof(Ktx2Header) + mipCount * sizeof(Ktx2Level));
+    header.dfdByteLength = static_cast<u32>(descriptor.size() * sizeof(u32));
+    header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+    header.kvdByteLength = static_cast<u32>(keyValues.size());
+
+    // Levels start on a multiple of the block size and of 4, smallest first.
+    std::vector<Ktx2Level> levels(mipCount);
+    std::vector<u64> sourceOffsets(mipCount);
+    u64 alignment = std::max<u64>(TextureCache::GetMipSize(format, 1, 1, 0), 4);
+    u64 dataOffset = alignUp(header.kvdByteOffset + header.kvdByteLength, alignment);
+    u64 sourceOffset = 0;
+    for (u32 level = 0; level < mipCount; level++)
+    {
+        levels[level].byteLength = levels[level].uncompressedByteLength = TextureCache::GetMipSize(format, width, height, level);
+        sourceOffsets[level] = sourceOffset;
+        sourceOffset += levels[level].byteLength;
+    }
+    if (sourceOffset != size)
+        return false;
+
+    u64 offset = dataOffset;
+    for (u32 level = mipCount; level-- > 0;)
+    {
+        levels[level].byteOffset = offset;
+        offset = alignUp(offset + levels[level].byteLength, alignment);
+    }
+
+    std::string tempPath = path + ".tmp";
+
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    std::vector<char> padding(static_cast<size_t>(alignment), 0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(levels.data()), levels.size() * sizeof(Ktx2Level));
+    file.write(reinterpret_cast<const char*>(descriptor.data()), header.dfdByteLength);
+    file.write(reinterpret_cast<const char*>(keyValues.data()), keyValues.size());
+    file.write(padding.data(), static_cast<std::streamsize>(dataOffset - header.kvdByteOffset - header.kvdByteLength));
+    for (u32 level = mipCount; level-- > 0;)
+    {
+        file.write(reinterpret_cast<const char*>(data + sourceOffsets[level]), levels[level].byteLength);
+        u64 end = levels[level].byteOffset + levels[level].byteLength;
+        file.write(padding.data(), static_cast<std::streamsize>(alignUp(end, alignment) - end));
+    }
+    file.close();
+
+    std::remove(path.c_str());
+    if (!file || std::rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool Ktx2File::Open(const std::string& path)
+{
+    Close();
+
+    if (!m_file.Open(path, MAPPED_FILE_WILLNEED) || m_file.GetSize() < sizeof(Ktx2Header))
+    {
+        Close();
+        return false;
+    }
+
+    u64 fileSize = m_file.GetSize();
+    const Ktx2Header* header = reinterpret_cast<const Ktx2Header*>(m_file.GetData());
+    VkFormat format = static_cast<VkFormat>(header->vkFormat);
+    bool valid = memcmp(header->identifier, ktx2Identifier, sizeof(ktx2Identifier)) == 0 &&
+        header->pixelWidth > 0 && header->pixelHeight > 0 && header->pixelDepth == 0 &&
+        header->layerCount == 0 && header->faceCount == 1 &&
+        header->levelCount > 0 && header->levelCount <= 32 &&
+        header->supercompressionScheme == 0 &&
+        sizeof(Ktx2Header) + header->levelCount * sizeof(Ktx2Level) <= fileSize &&
+        static_cast<u64>(header->kvdByteOffset) + header->kvdByteLength <= fileSize;
+
+    // Level offsets are kept relative to the first byte of the smallest level,
+    // so each has to keep the alignment a buffer to image copy needs.
+    const Ktx2Level* levels = reinterpret_cast<const Ktx2Level*>(m_file.GetData() + sizeof(Ktx2Header));
+    u64 alignment = std::max<u64>(TextureCache::GetMipSize(format, 1, 1, 0), 4);
+    u64 first = UINT64_MAX, end = 0;
+    for (u32 level = 0; valid && level < header->levelCount; level++)
+    {
+        u64 mipSize = TextureCache::GetMipSize(format, header->pixelWidth, header->pixelHeight, level);
+        valid = mipSize > 0 && levels[level].byteLength == mipSize &&
+            levels[level].byteOffset % alignment == 0 &&
+            levels[level].byteOffset <= fileSize && mipSize <= fileSize - levels[level].byteOffset;
+        first = std::min(first, levels[level].byteOffset);
+        end = std::max(end, levels[level].byteOffset + mipSize);
+    }
+
+    if (!valid)
+    {
+        Close();
+        return false;
+    }
+
+    m_header = header;
+    m_levels = levels;
+    m_dataOffset = first;
+    m_dataSize = end - first;
+    readDependencies();
+    return true;
+}
+
+void Ktx2File::Close()
+{
+    m_file.Close();
+    m_header = nullptr;
+    m_levels = nullptr;
+    m_dependencies = AssetDependencies{};
+    m_dataOffset = 0;
+    m_dataSize = 0;
+}
+
+void Ktx2File::readDependencies()
+{
+    const char* data = m_file.GetData() + m_header->kvdByteOffset;
+    u64 size = m_header->kvdByteLength;
+    for (u64 offset = 0; offset + sizeof(u32) <= size;)
+    {
+        u32 length;
+        memcpy(&length, data + offset, sizeof(length));
+        offset += sizeof(length);
+        if (length > size - offset)
+            return;
+
+        const char* key = data + offset;
+        size_t keyLength = strnlen(key, length);
+        if (keyLength < length && strcmp(key, KTX2_DEPENDENCIES_KEY) == 0 && length - keyLength - 1 == sizeof(AssetDependencies))
+        {
+            AssetDependencies dependencies;
+            memcpy(&dependencies, key + keyLength + 1, sizeof(dependencies));
+            if (dependencies.count <= MAX_ASSET_DEPENDENCIES)
+                m_dependencies = dependencies;
+            return;
+        }
+        offset = alignUp(offset + length, 4);
+    }
+}
+
+const AssetDependencies& Ktx2File::GetDependencies() const
+{
+    return m_dependencies;
+}
+
+VkFormat Ktx2File::GetFormat() const
+{
+    return m_header ? static_cast<VkFormat>(m_header->vkFormat) : VK_FORMAT_UNDEFINED;
+}
+
+u32 Ktx2File::GetWidth() const
+{
+    return m_header ? m_header->pixelWidth : 0;
+}
+
+u32 Ktx2File::GetHeight() const
+{
+    return m_header ? m_header->pixelHeight : 0;
+}
+
+u32 Ktx2File::GetMipCount() const
+{
+    return m_header ? m_header->levelCount : 0;
+}
+
+const u8* Ktx2File::GetData() const
+{
+    return reinterpret_cast<const u8*>(m_file.GetData() + m_dataOffset);
+}
+
+size_t Ktx2File::GetDataSize() const
+{
+    return static_cast<size_t>(m_dataSize);
+}
+
+u64 Ktx2File::GetMipOffset(u32 level) const
+{
+    return m_levels && level < m_header->levelCount ? m_levels[level].byteOffset - m_dataOffset : 0;
+}
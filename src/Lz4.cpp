@@ -0,0 +1,188 @@
+#include <cstring>
+
+#include <Lz4.hpp>
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MATCH_SEARCH_END 12
+#define LZ4_MAX_OFFSET 0xFFFF
+#define LZ4_HASH_BITS 12
+
+static u32 read32(const u8* p)
+{
+    u32 value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static u32 hashSequence(u32 sequence)
+{
+    return (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+static bool writeLength(u8*& out, const u8* outEnd, size_t length)
+{
+    for (; length >= 255; length -= 255)
+    {
+        if (out == outEnd)
+            return false;
+        *out++ = 255;
+    }
+    if (out == outEnd)
+        return false;
+    *out++ = static_cast<u8>(length);
+    return true;
+}
+
+// One token, its literals and, unless matchLength is 0, the match after them.
+static bool writeSequence(u8*& out, const u8* outEnd, const u8* literals, size_t literalLength, size_t offset, size_t matchLength)
+{
+    if (out == outEnd)
+        return false;
+
+    u8* token = out++;
+    *token = static_cast<u8>((literalLength < 15 ? literalLength : 15) << 4);
+    if (literalLength >= 15 && !writeLength(out, outEnd, literalLength - 15))
+        return false;
+
+    if (static_cast<size_t>(outEnd - out) < literalLength)
+        return false;
+    memcpy(out, literals, literalLength);
+    out += literalLength;
+
+    if (matchLength == 0)
+        return true;
+
+    if (outEnd - out < 2)
+        return false;
+    *out++ = static_cast<u8>(offset);
+    *out++ = static_cast<u8>(offset >> 8);
+
+    size_t length = matchLength - LZ4_MIN_MATCH;
+    *token |= static_cast<u8>(length < 15 ? length : 15);
+    return length < 15 || writeLength(out, outEnd, length - 15);
+}
+
+size_t Lz4CompressBound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+// Greedy single probe matcher. The format wants the last five bytes as
+// literals and no match starting in the last twelve.
+size_t Lz4Compress(const u8* source, size_t size, u8* destination, size_t capacity)
+{
+    u32 table[1 << LZ4_HASH_BITS] = {};
+
+    const u8* end = source + size;
+    const u8* matchLimit = size > LZ4_LAST_LITERALS ? end - LZ4_LAST_LITERALS : source;
+    const u8* searchLimit = size > LZ4_MATCH_SEARCH_END ? end - LZ4_MATCH_SEARCH_END : source;
+    const u8* anchor = source;
+    const u8* ip = source;
+    u8* out = destination;
+    const u8* outEnd = destination + capacity;
+
+    while (ip < searchLimit)
+    {
+        u32 sequence = read32(ip);
+        u32 hash = hashSequence(sequence);
+        const u8* candidate = source + table[hash];
+        table[hash] = static_cast<u32>(ip - source);
+
+        if (candidate >= ip || ip - candidate > LZ4_MAX_OFFSET || read32(candidate) != sequence)
+        {
+            // Step faster through data that doesn't compress.
+            ip += 1 + ((ip - anchor) >> 6);
+            continue;
+        }
+
+        while (ip > anchor && candidate > source && ip[-1] == candidate[-1])
+        {
+            ip--;
+            candidate--;
+        }
+
+        const u8* matchEnd = ip + LZ4_MIN_MATCH;
+        const u8* reference = candidate + LZ4_MIN_MATCH;
+        while (matchEnd < matchLimit && *matchEnd == *reference)
+        {
+            matchEnd++;
+            reference++;
+        }
+
+        if (!writeSequence(out, outEnd, anchor, ip - anchor, ip - candidate, matchEnd - ip))
+            return 0;
+        ip = anchor = matchEnd;
+    }
+
+    if (!writeSequence(out, outEnd, anchor, end - anchor, 0, 0))
+        return 0;
+    return out - destination;
+}
+
+static bool readLength(const u8*& ip, const u8* ipEnd, size_t& length)
+{
+    u8 byte;
+    do
+    {
+        if (ip == ipEnd)
+            return false;
+        byte = *ip++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+bool Lz4Decompress(const u8* source, size_t sourceSize, u8* destination, size_t size)
+{
+    const u8* ip = source;
+    const u8* ipEnd = source + sourceSize;
+    u8* op = destination;
+    u8* opEnd = destination + size;
+
+    for (;;)
+    {
+        if (ip == ipEnd)
+            return false;
+        u8 token = *ip++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(ip, ipEnd, literalLength))
+            return false;
+        if (literalLength > static_cast<size_t>(ipEnd - ip) || literalLength > static_cast<size_t>(opEnd - op))
+            return false;
+        memcpy(op, ip, literalLength);
+        ip += literalLength;
+        op += literalLength;
+
+        if (ip == ipEnd)
+            return op == opEnd;
+
+        if (ipEnd - ip < 2)
+            return false;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > static_cast<size_t>(op - destination))
+            return false;
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(ip, ipEnd, matchLength))
+            return false;
+        matchLength += LZ4_MIN_MATCH;
+        if (matchLength > static_cast<size_t>(opEnd - op))
+            return false;
+
+        // Matches may overlap their own output, which repeats the pattern.
+        const u8* match = op - offset;
+        if (offset >= matchLength)
+        {
+            memcpy(op, match, matchLength);
+            op += matchLength;
+        }
+        else
+        {
+            for (size_t i = 0; i < matchLength; i++)
+                *op++ = *match++;
+        }
+    }
+}
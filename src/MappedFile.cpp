@@ -0,0 +1,206 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+
+#include <AssetArchive.hpp>
+#include <MappedFile.hpp>
+
+static void adviseRange(const char* data, size_t size, u32 hints);
+static void discardRange(const char* data, size_t size);
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const std::string& path, u32 hints)
+{
+    Close();
+
+    if (ReadArchivedFile(path, m_data, m_size, m_buffer))
+    {
+        m_archived = true;
+        m_open = true;
+        Advise(0, m_size, hints);
+        return true;
+    }
+    return openFile(path, hints);
+}
+
+// Decoded archive files live in an ordinary heap buffer, hints only apply to
+// pages that are backed by a file.
+void MappedFile::Advise(size_t offset, size_t size, u32 hints) const
+{
+    if (!m_data || m_buffer || offset >= m_size || hints == MAPPED_FILE_NORMAL)
+        return;
+    adviseRange(m_data + offset, std::min(size, m_size - offset), hints);
+}
+
+void MappedFile::Discard(size_t offset, size_t size) const
+{
+    if (!m_data || m_buffer || offset >= m_size)
+        return;
+    discardRange(m_data + offset, std::min(size, m_size - offset));
+}
+
+#ifdef _WIN32
+static void adviseRange(const char* data, size_t size, u32 hints)
+{
+    if (hints & MAPPED_FILE_WILLNEED)
+    {
+        WIN32_MEMORY_RANGE_ENTRY range{ const_cast<char*>(data), size };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+}
+
+// Unlocking pages that aren't locked removes them from the working set, the
+// documented way to trim a range of a file view.
+static void discardRange(const char* data, size_t size)
+{
+    VirtualUnlock(const_cast<char*>(data), size);
+}
+
+bool MappedFile::openFile(const std::string& path, u32 hints)
+{
+    DWORD flags = hints & MAPPED_FILE_SEQUENTIAL ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL;
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    m_file = file;
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+    m_open = true;
+    if (m_size == 0)
+        return true;
+
+    m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping)
+        m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+
+    if (!m_data)
+    {
+        Close();
+        return false;
+    }
+
+    adviseRange(m_data, m_size, hints);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_data && !m_archived) UnmapViewOfFile(m_data);
+    if (m_mapping) CloseHandle(m_mapping);
+    if (m_file) CloseHandle(m_file);
+
+    m_data = nullptr;
+    m_mapping = nullptr;
+    m_file = nullptr;
+    m_size = 0;
+    m_open = false;
+    m_archived = false;
+    m_buffer.reset();
+}
+#else
+// madvise wants page aligned addresses, the range is widened to whole pages.
+static void adviseRange(const char* data, size_t size, u32 hints)
+{
+    static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t begin = reinterpret_cast<uintptr_t>(data) & ~(pageSize - 1);
+    size_t length = reinterpret_cast<uintptr_t>(data) + size - begin;
+
+    if (hints & MAPPED_FILE_SEQUENTIAL)
+        madvise(reinterpret_cast<void*>(begin), length, MADV_SEQUENTIAL);
+    if (hints & MAPPED_FILE_WILLNEED)
+        madvise(reinterpret_cast<void*>(begin), length, MADV_WILLNEED);
+}
+
+// The mapping is private and never written, dropped pages are read back from
+// the file if they are touched again.
+static void discardRange(const char* data, size_t size)
+{
+    static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t begin = reinterpret_cast<uintptr_t>(data) & ~(pageSize - 1);
+    madvise(reinterpret_cast<void*>(begin), reinterpret_cast<uintptr_t>(data) + size - begin, MADV_DONTNEED);
+}
+
+bool MappedFile::openFile(const std::string& path, u32 hints)
+{
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+
+    struct stat fileStat;
+    if (fstat(file, &fileStat) != 0)
+    {
+        close(file);
+        return false;
+    }
+
+    m_file = file;
+    m_size = static_cast<size_t>(fileStat.st_size);
+    m_open = true;
+    if (m_size == 0)
+        return true;
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (data == MAP_FAILED)
+    {
+        Close();
+        return false;
+    }
+    m_data = static_cast<const char*>(data);
+
+    adviseRange(m_data, m_size, hints);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_data && !m_archived) munmap(const_cast<char*>(m_data), m_size);
+    if (m_file >= 0) close(m_file);
+
+    m_data = nullptr;
+    m_file = -1;
+    m_size = 0;
+    m_open = false;
+    m_archived = false;
+    m_buffer.reset();
+}
+#endif
+
+bool MappedFile::IsOpen() const
+{
+    return m_open;
+}
+
+const char* MappedFile::GetData() const
+{
+    return m_data;
+}
+
+size_t MappedFile::GetSize() const
+{
+    return m_size;
+}
+
+FileSpan MappedFile::GetSpan() const
+{
+    return { m_data, m_size };
+}
@@ -0,0 +1,185 @@
+#include <cstdio>
+#include <fstream>
+
+#include <MyUtils.hpp>
+#include <MeshCache.hpp>
+
+u64 MeshCache::HashSource(const char* data, size_t size)
+{
+    return Hash64(data, size, MESH_CACHE_VERSION);
+}
+
+std::string MeshCache::GetCachePath(const char* sourcePath)
+{
+    return std::string(sourcePath) + ".meshcache";
+}
+
+bool MeshCache::Write(const std::string& cachePath, const AssetDependencies& dependencies, u32 flags,
+    const Submesh* submeshes, size_t submeshCount,
+    const MeshLod* lods, size_t lodCount,
+    const MeshletData& meshlets,
+    const Vertex* vertices, size_t vertexCount,
+    const u32* indices, size_t indexCount)
+{
+    MeshCacheHeader header{};
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.flags = flags;
+    header.lodCount = static_cast<u32>(lodCount);
+    header.submeshCount = static_cast<u32>(submeshCount);
+    header.dependencies = dependencies;
+    header.vertexCount = vertexCount;
+    header.indexCount = indexCount;
+    header.meshletCount = meshlets.meshlets.size();
+    header.meshletVertexCount = meshlets.vertices.size();
+    header.meshletTriangleCount = meshlets.triangles.size();
+
+    std::string tempPath = cachePath + ".tmp";
+
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(submeshes), sizeof(Submesh) * submeshCount);
+    file.write(reinterpret_cast<const char*>(lods), sizeof(MeshLod) * lodCount);
+    file.write(reinterpret_cast<const char*>(meshlets.meshlets.data()), sizeof(Meshlet) * meshlets.meshlets.size());
+    file.write(reinterpret_cast<const char*>(vertices), sizeof(Vertex) * vertexCount);
+    file.write(reinterpret_cast<const char*>(indices), sizeof(u32) * indexCount);
+    file.write(reinterpret_cast<const char*>(meshlets.vertices.data()), sizeof(u32) * meshlets.vertices.size());
+    file.write(reinterpret_cast<const char*>(meshlets.triangles.data()), meshlets.triangles.size());
+    file.close();
+
+    // A stale or half written cache is only a missed opportunity, never an error
+    // at runtime; the cooker reports it.
+    std::remove(cachePath.c_str());
+    if (!file || std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool MeshCache::Open(const std::string& cachePath, u32 flags)
+{
+    Close();
+
+    if (!m_file.Open(cachePath, MAPPED_FILE_WILLNEED) || m_file.GetSize() < sizeof(MeshCacheHeader))
+    {
+        Close();
+        return false;
+    }
+
+    const MeshCacheHeader* header = reinterpret_cast<const MeshCacheHeader*>(m_file.GetData());
+    u64 expectedSize = sizeof(MeshCacheHeader)
+        + header->submeshCount * sizeof(Submesh)
+        + header->lodCount * sizeof(MeshLod)
+        + header->meshletCount * sizeof(Meshlet)
+        + header->vertexCount * sizeof(Vertex)
+        + header->indexCount * sizeof(u32)
+        + header->meshletVertexCount * sizeof(u32)
+        + header->meshletTriangleCount;
+
+    if (header->magic != MESH_CACHE_MAGIC ||
+        header->version != MESH_CACHE_VERSION ||
+        header->flags != flags ||
+        header->dependencies.count > MAX_ASSET_DEPENDENCIES ||
+        m_file.GetSize() != expectedSize)
+    {
+        Close();
+        return false;
+    }
+
+    const Submesh* submeshes = reinterpret_cast<const Submesh*>(header + 1);
+    const MeshLod* lods = reinterpret_cast<const MeshLod*>(submeshes + header->submeshCount);
+    bool valid = true;
+    for (u32 i = 0; i < header->submeshCount; i++)
+        valid &= submeshes[i].lodCount > 0 && submeshes[i].lodCount <= MAX_MESH_LODS &&
+            static_cast<u64>(submeshes[i].firstLod) + submeshes[i].lodCount <= header->lodCount &&
+            static_cast<u64>(submeshes[i].vertexOffset) + submeshes[i].vertexCount <= header->vertexCount;
+    for (u32 i = 0; i < header->lodCount; i++)
+        valid &= static_cast<u64>(lods[i].firstIndex) + lods[i].indexCount <= header->indexCount &&
+            static_cast<u64>(lods[i].firstMeshlet) + lods[i].meshletCount <= header->meshletCount;
+
+    if (!valid)
+    {
+        Close();
+        return false;
+    }
+
+    m_header = header;
+    return true;
+}
+
+void MeshCache::Close()
+{
+    m_file.Close();
+    m_header = nullptr;
+}
+
+const AssetDependencies& MeshCache::GetDependencies() const
+{
+    static const AssetDependencies none{};
+    return m_header ? m_header->dependencies : none;
+}
+
+const Submesh* MeshCache::GetSubmeshes() const
+{
+    return reinterpret_cast<const Submesh*>(m_file.GetData() + sizeof(MeshCacheHeader));
+}
+
+u32 MeshCache::GetSubmeshCount() const
+{
+    return m_header ? m_header->submeshCount : 0;
+}
+
+const MeshLod* MeshCache::GetLods() const
+{
+    return reinterpret_cast<const MeshLod*>(GetSubmeshes() + GetSubmeshCount());
+}
+
+u32 MeshCache::GetLodCount() const
+{
+    return m_header ? m_header->lodCount : 0;
+}
+
+const Meshlet* MeshCache::GetMeshlets() const
+{
+    return reinterpret_cast<const Meshlet*>(GetLods() + GetLodCount());
+}
+
+u32 MeshCache::GetMeshletCount() const
+{
+    return m_header ? static_cast<u32>(m_header->meshletCount) : 0;
+}
+
+const Vertex* MeshCache::GetVertices() const
+{
+    return reinterpret_cast<const Vertex*>(GetMeshlets() + GetMeshletCount());
+}
+
+u32 MeshCache::GetVertexCount() const
+{
+    return m_header ? static_cast<u32>(m_header->vertexCount) : 0;
+}
+
+const u32* MeshCache::GetIndices() const
+{
+    return reinterpret_cast<const u32*>(GetVertices() + GetVertexCount());
+}
+
+u32 MeshCache::GetIndexCount() const
+{
+    return m_header ? static_cast<u32>(m_header->indexCount) : 0;
+}
+
+const u32* MeshCache::GetMeshletVertices() const
+{
+    return GetIndices() + GetIndexCount();
+}
+
+const u8* MeshCache::GetMeshletTriangles() const
+{
+    return reinterpret_cast<const u8*>(GetMeshletVertices() + (m_header ? m_header->meshletVertexCount : 0));
+}
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <numeric>
+
+#include <MeshOptimizer.hpp>
+
+VertexCacheStats AnalyzeVertexCache(const u32* indices, size_t indexCount, size_t vertexCount, u32 cacheSize)
+{
+    VertexCacheStats stats{};
+    if (indexCount == 0 || vertexCount == 0)
+        return stats;
+
+    // A vertex is in the cache while fewer than cacheSize misses happened since
+    // it was last loaded.
+    std::vector<u32> loadedAt(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    u32 misses = 0;
+    size_t referencedCount = 0;
+
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        u32 v = indices[i];
+        if (!referenced[v])
+        {
+            referenced[v] = true;
+            referencedCount++;
+        }
+        else if (misses - loadedAt[v] < cacheSize)
+        {
+            continue;
+        }
+        loadedAt[v] = ++misses;
+    }
+
+    stats.acmr = static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+    stats.atvr = static_cast<float>(misses) / static_cast<float>(referencedCount);
+    return stats;
+}
+
+void OptimizeVertexCache(u32* indices, size_t indexCount, size_t vertexCount,
+    std::vector<u32>& clusters, u32 cacheSize)
+{
+    const size_t triangleCount = indexCount / 3;
+    clusters.clear();
+    if (triangleCount == 0)
+        return;
+
+    // Vertex to triangle adjacency.
+    std::vector<u32> liveTriangles(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; i++)
+        liveTriangles[indices[i]]++;
+
+    std::vector<u32> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+
+    std::vector<u32> adjacency(indexCount);
+    std::vector<u32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < indexCount; i++)
+        adjacency[fill[indices[i]]++] = static_cast<u32>(i / 3);
+
+    std::vector<u32> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<u32> deadEnds;
+    std::vector<u32> candidates;
+    std::vector<u32> output;
+    output.reserve(indexCount);
+
+    u32 time = cacheSize + 1;
+    size_t cursor = 0;
+
+    // Dead ends are where the cache has most likely been flushed, so they
+    // make cluster boundaries that cost next to nothing in cache efficiency.
+    auto startCluster = [&]()
+    {
+        u32 triangle = static_cast<u32>(output.size() / 3);
+        if (clusters.empty() || triangle - clusters.back() >= cacheSize)
+            clusters.push_back(triangle);
+    };
+
+    auto skipDeadEnd = [&]() -> i64
+    {
+        while (!deadEnds.empty())
+        {
+            u32 vertex = deadEnds.back();
+            deadEnds.pop_back();
+            if (liveTriangles[vertex] > 0)
+            {
+                startCluster();
+                return vertex;
+            }
+        }
+
+        for (; cursor < vertexCount; cursor++)
+        {
+            if (liveTriangles[cursor] > 0)
+            {
+                startCluster();
+                return static_cast<i64>(cursor);
+            }
+        }
+        return -1;
+    };
+
+    for (i64 fanning = skipDeadEnd(); fanning >= 0;)
+    {
+        candidates.clear();
+
+        for (u32 a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++)
+        {
+            u32 triangle = adjacency[a];
+            if (emitted[triangle])
+                continue;
+
+            for (u32 k = 0; k < 3; k++)
+            {
+                u32 vertex = indices[3 * triangle + k];
+                output.push_back(vertex);
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                liveTriangles[vertex]--;
+                if (time - cacheTime[vertex] > cacheSize)
+                    cacheTime[vertex] = time++;
+            }
+            emitted[triangle] = true;
+        }
+
+        // Prefer the candidate that is still going to be in the cache once all
+        // of its remaining triangles are emitted, and among those the oldest.
+        i64 next = -1;
+        i64 bestPriority = -1;
+        for (u32 vertex : candidates)
+        {
+            if (liveTriangles[vertex] == 0)
+                continue;
+
+            i64 priority = 0;
+            if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+                priority = time - cacheTime[vertex];
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = vertex;
+            }
+        }
+
+        fanning = next >= 0 ? next : skipDeadEnd();
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeOverdraw(u32* indices, size_t indexCount, const Vertex* vertices, const std::vector<u32>& clusters)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (clusters.size() < 2)
+        return;
+
+    typedef struct Cluster
+    {
+        u32 begin;
+        u32 end;
+        float sortKey;
+    } Cluster;
+
+    std::vector<Cluster> sorted(clusters.size());
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+
+    std::vector<glm::vec3> centroids(clusters.size());
+    std::vector<glm::vec3> normals(clusters.size());
+
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        sorted[c].begin = clusters[c];
+        sorted[c].end = c + 1 < clusters.size() ? clusters[c + 1] : static_cast<u32>(triangleCount);
+
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+
+        for (u32 t = sorted[c].begin; t < sorted[c].end; t++)
+        {
+            const glm::vec3& a = vertices[indices[3 * t + 0]].pos;
+            const glm::vec3& b = vertices[indices[3 * t + 1]].pos;
+            const glm::vec3& d = vertices[indices[3 * t + 2]].pos;
+
+            glm::vec3 weightedNormal = glm::cross(b - a, d - a);
+            float triangleArea = glm::length(weightedNormal);
+
+            centroid += (a + b + d) * (triangleArea / 3.0f);
+            normal += weightedNormal;
+            area += triangleArea;
+        }
+
+        meshCentroid += centroid;
+        meshArea += area;
+        centroids[c] = area > 0.0f ? centroid / area : centroid;
+        normals[c] = glm::length(normal) > 0.0f ? glm::normalize(normal) : normal;
+    }
+
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    for (size_t c = 0; c < clusters.size(); c++)
+        sorted[c].sortKey = glm::dot(centroids[c] - meshCentroid, normals[c]);
+
+    std::stable_sort(sorted.begin(), sorted.end(),
+        [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<u32> output;
+    output.reserve(indexCount);
+    for (const Cluster& cluster : sorted)
+        output.insert(output.end(), indices + 3 * cluster.begin, indices + 3 * cluster.end);
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+size_t OptimizeVertexFetch(Vertex* vertices, size_t vertexCount, u32* indices, size_t indexCount)
+{
+    const u32 unused = 0xFFFFFFFF;
+    std::vector<u32> remap(vertexCount, unused);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertexCount);
+
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        u32& target = remap[indices[i]];
+        if (target == unused)
+        {
+            target = static_cast<u32>(reordered.size());
+            reordered.push_back(vertices[indices[i]]);
+        }
+        indices[i] = target;
+    }
+
+    std::copy(reordered.begin(), reordered.end(), vertices);
+    return reordered.size();
+}
+
+void OptimizeMesh(std::vector<Vertex>& vertices, std::vector<u32>& indices)
+{
+    std::vector<u32> clusters;
+    OptimizeVertexCache(indices.data(), indices.size(), vertices.size(), clusters);
+    OptimizeOverdraw(indices.data(), indices.size(), vertices.data(), clusters);
+    vertices.resize(OptimizeVertexFetch(vertices.data(), vertices.size(), indices.data(), indices.size()));
+}
@@ -0,0 +1,449 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <MeshOptimizer.hpp>
+#include <MeshSimplifier.hpp>
+#include <VertexWelder.hpp>
+
+#define LOD_MIN_TRIANGLES 64
+#define LOD_MIN_REDUCTION 0.8f
+
+typedef struct Quadric
+{
+    // Symmetric 4x4 matrix of the summed squared plane distances.
+    double a00, a01, a02, a03;
+    double a11, a12, a13;
+    double a22, a23;
+    double a33;
+    double weight;
+} Quadric;
+
+static void addPlane(Quadric& q, const glm::dvec3& normal, double distance, double weight)
+{
+    q.a00 += weight * normal.x * normal.x;
+    q.a01 += weight * normal.x * normal.y;
+    q.a02 += weight * normal.x * normal.z;
+    q.a03 += weight * normal.x * distance;
+    q.a11 += weight * normal.y * normal.y;
+    q.a12 += weight * normal.y * normal.z;
+    q.a13 += weight * normal.y * distance;
+    q.a22 += weight * normal.z * normal.z;
+    q.a23 += weight * normal.z * distance;
+    q.a33 += weight * distance * distance;
+    q.weight += weight;
+}
+
+static void addQuadric(Quadric& q, const Quadric& other)
+{
+    q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02; q.a03 += other.a03;
+    q.a11 += other.a11; q.a12 += other.a12; q.a13 += other.a13;
+    q.a22 += other.a22; q.a23 += other.a23;
+    q.a33 += other.a33;
+    q.weight += other.weight;
+}
+
+// Mean squared distance from p to the planes accumulated in q and r.
+static double quadricError(const Quadric& q, const Quadric& r, const glm::vec3& position)
+{
+    double x = position.x, y = position.y, z = position.z;
+    double a00 = q.a00 + r.a00, a01 = q.a01 + r.a01, a02 = q.a02 + r.a02, a03 = q.a03 + r.a03;
+    double a11 = q.a11 + r.a11, a12 = q.a12 + r.a12, a13 = q.a13 + r.a13;
+    double a22 = q.a22 + r.a22, a23 = q.a23 + r.a23;
+    double a33 = q.a33 + r.a33;
+    double weight = q.weight + r.weight;
+
+    double error = x * x * a00 + y * y * a11 + z * z * a22 + a33
+        + 2.0 * (x * y * a01 + x * z * a02 + y * z * a12 + x * a03 + y * a13 + z * a23);
+    return weight > 0.0 ? std::max(error, 0.0) / weight : 0.0;
+}
+
+// How a position may move. Seam vertices sit where two UV islands meet and
+// border vertices on an open edge, both slide along their two special edges
+// only so the outline of the mesh and its islands is kept.
+enum VertexKind : u8
+{
+    VERTEX_MANIFOLD,
+    VERTEX_SEAM,
+    VERTEX_BORDER,
+    VERTEX_LOCKED,
+};
+
+typedef struct PositionInfo
+{
+    VertexKind kind;
+    u8 specialCount;
+    bool border;
+    u32 special[2]; // Positions across the seam or border edges
+} PositionInfo;
+
+static u64 edgeKey(u32 a, u32 b)
+{
+    return static_cast<u64>(std::min(a, b)) << 32 | std::max(a, b);
+}
+
+static void addSpecialEdge(PositionInfo& info, u32 other, bool border)
+{
+    for (u32 i = 0; i < std::min<u32>(info.specialCount, 2); i++)
+        if (info.special[i] == other)
+            return;
+
+    if (info.specialCount < 2)
+        info.special[info.specialCount] = other;
+    info.specialCount = static_cast<u8>(std::min(info.specialCount + 1, 3));
+    info.border |= border;
+}
+
+float SimplifyMesh(const Vertex* vertices, size_t vertexCount,
+    const u32* indices, size_t indexCount,
+    size_t targetIndexCount, std::vector<u32>& result)
+{
+    result.assign(indices, indices + indexCount);
+    if (indexCount <= targetIndexCount)
+        return 0.0f;
+
+    // Vertices sharing a position are wedges of the same position, differing in
+    // their attributes. Collapses are decided per position and move every wedge.
+    VertexWelder welder;
+    welder.Reserve(vertexCount);
+    std::vector<u32> positionOf(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        positionOf[v] = welder.Insert({ vertices[v].pos, glm::vec3(0.0f), glm::vec2(0.0f) });
+    const std::vector<Vertex>& positions = welder.GetVertices();
+    const size_t positionCount = positions.size();
+
+    std::vector<u32> wedgeOffsets(positionCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        wedgeOffsets[positionOf[v] + 1]++;
+    for (size_t p = 0; p < positionCount; p++)
+        wedgeOffsets[p + 1] += wedgeOffsets[p];
+    std::vector<u32> wedges(vertexCount);
+    {
+        std::vector<u32> fill(wedgeOffsets.begin(), wedgeOffsets.end() - 1);
+        for (size_t v = 0; v < vertexCount; v++)
+            wedges[fill[positionOf[v]]++] = static_cast<u32>(v);
+    }
+
+    // Edges of the position topology used by anything but two triangles are
+    // borders, edges of the vertex topology used by one triangle where the
+    // positions are closed are seams.
+    std::vector<u64> positionEdges, vertexEdges;
+    positionEdges.reserve(indexCount);
+    vertexEdges.reserve(indexCount);
+    for (size_t i = 0; i < indexCount; i += 3)
+        for (u32 k = 0; k < 3; k++)
+        {
+            u32 a = indices[i + k], b = indices[i + (k + 1) % 3];
+            positionEdges.push_back(edgeKey(positionOf[a], positionOf[b]));
+            vertexEdges.push_back(edgeKey(a, b));
+        }
+    std::sort(positionEdges.begin(), positionEdges.end());
+    std::sort(vertexEdges.begin(), vertexEdges.end());
+
+    auto positionEdgeUses = [&](u64 key)
+    {
+        auto range = std::equal_range(positionEdges.begin(), positionEdges.end(), key);
+        return static_cast<size_t>(range.second - range.first);
+    };
+
+    std::vector<PositionInfo> info(positionCount, PositionInfo{});
+    for (size_t i = 0; i < positionEdges.size();)
+    {
+        size_t j = i;
+        while (j < positionEdges.size() && positionEdges[j] == positionEdges[i]) j++;
+        u32 a = static_cast<u32>(positionEdges[i] >> 32), b = static_cast<u32>(positionEdges[i]);
+        if (j - i != 2 && a != b)
+        {
+            addSpecialEdge(info[a], b, true);
+            addSpecialEdge(info[b], a, true);
+            if (j - i > 2)
+                info[a].specialCount = info[b].specialCount = 3;
+        }
+        i = j;
+    }
+    for (size_t i = 0; i < vertexEdges.size();)
+    {
+        size_t j = i;
+        while (j < vertexEdges.size() && vertexEdges[j] == vertexEdges[i]) j++;
+        u32 a = positionOf[static_cast<u32>(vertexEdges[i] >> 32)], b = positionOf[static_cast<u32>(vertexEdges[i])];
+        if (j - i != 2 && a != b && positionEdgeUses(edgeKey(a, b)) == 2)
+        {
+            addSpecialEdge(info[a], b, false);
+            addSpecialEdge(info[b], a, false);
+        }
+        i = j;
+    }
+
+    for (size_t p = 0; p < positionCount; p++)
+    {
+        PositionInfo& position = info[p];
+        u32 wedgeCount = wedgeOffsets[p + 1] - wedgeOffsets[p];
+        position.kind = VERTEX_LOCKED;
+        if (position.specialCount == 0 && wedgeCount == 1)
+            position.kind = VERTEX_MANIFOLD;
+        else if (position.specialCount == 2 && position.border && wedgeCount == 1)
+            position.kind = VERTEX_BORDER;
+        else if (position.specialCount == 2 && !position.border && wedgeCount == 2)
+            position.kind = VERTEX_SEAM;
+    }
+
+    // Triangle planes weighted by area, plus planes standing on the seam and
+    // border edges so sliding along them keeps the outline straight.
+    std::vector<Quadric> quadrics(positionCount, Quadric{});
+    for (size_t i = 0; i < indexCount; i += 3)
+    {
+        glm::dvec3 p0 = vertices[indices[i]].pos, p1 = vertices[indices[i + 1]].pos, p2 = vertices[indices[i + 2]].pos;
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double area = glm::length(normal);
+        if (area <= 0.0)
+            continue;
+
+        normal /= area;
+        double distance = -glm::dot(normal, p0);
+        for (u32 k = 0; k < 3; k++)
+            addPlane(quadrics[positionOf[indices[i + k]]], normal, distance, area);
+
+        for (u32 k = 0; k < 3; k++)
+        {
+            u32 a = indices[i + k], b = indices[i + (k + 1) % 3];
+            auto range = std::equal_range(vertexEdges.begin(), vertexEdges.end(), edgeKey(a, b));
+            if (range.second - range.first != 1)
+                continue;
+
+            glm::dvec3 pa = vertices[a].pos, pb = vertices[b].pos;
+            glm::dvec3 edge = pb - pa;
+            double length = glm::length(edge);
+            glm::dvec3 edgeNormal = glm::cross(edge, normal);
+            if (length <= 0.0 || glm::length(edgeNormal) <= 0.0)
+                continue;
+
+            edgeNormal = glm::normalize(edgeNormal);
+            double edgeDistance = -glm::dot(edgeNormal, pa);
+            addPlane(quadrics[positionOf[a]], edgeNormal, edgeDistance, length * length);
+            addPlane(quadrics[positionOf[b]], edgeNormal, edgeDistance, length * length);
+        }
+    }
+
+    typedef struct Collapse
+    {
+        u32 from;
+        u32 to;
+        double error;
+    } Collapse;
+
+    std::vector<u32> remap(vertexCount);
+    std::vector<u32> targets(vertexCount);
+    std::vector<bool> touched(positionCount);
+    std::vector<u32> adjacencyOffsets(vertexCount + 1);
+    std::vector<u32> adjacency;
+    std::vector<Collapse> collapses;
+    double maxError = 0.0;
+
+    auto canCollapse = [&](u32 from, u32 to)
+    {
+        const PositionInfo& position = info[from];
+        if (position.kind == VERTEX_MANIFOLD)
+            return true;
+        if (position.kind == VERTEX_LOCKED)
+            return false;
+        return position.special[0] == to || position.special[1] == to;
+    };
+
+    // Passes get cheaper as the target nears but each one still walks the whole
+    // mesh, landing within a few percent is close enough.
+    const size_t stopIndexCount = targetIndexCount + targetIndexCount / 32;
+
+    while (result.size() > stopIndexCount)
+    {
+        const size_t triangleCount = result.size() / 3;
+
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (u32 v : result)
+            adjacencyOffsets[v + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        adjacency.resize(result.size());
+        std::vector<u32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < result.size(); i++)
+            adjacency[fill[result[i]]++] = static_cast<u32>(i / 3);
+
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3)
+            for (u32 k = 0; k < 3; k++)
+            {
+                u32 a = positionOf[result[i + k]], b = positionOf[result[i + (k + 1) % 3]];
+                if (canCollapse(a, b))
+                    collapses.push_back({ a, b, quadricError(quadrics[a], quadrics[b], positions[b].pos) });
+                if (canCollapse(b, a))
+                    collapses.push_back({ b, a, quadricError(quadrics[b], quadrics[a], positions[a].pos) });
+            }
+
+        // Interior edges show up once from each triangle.
+        std::sort(collapses.begin(), collapses.end(),
+            [](const Collapse& x, const Collapse& y) { return x.from != y.from ? x.from < y.from : x.to < y.to; });
+        collapses.erase(std::unique(collapses.begin(), collapses.end(),
+            [](const Collapse& x, const Collapse& y) { return x.from == y.from && x.to == y.to; }), collapses.end());
+        std::sort(collapses.begin(), collapses.end(),
+            [](const Collapse& x, const Collapse& y) { return x.error < y.error; });
+
+        for (size_t v = 0; v < vertexCount; v++)
+            remap[v] = static_cast<u32>(v);
+        std::fill(touched.begin(), touched.end(), false);
+
+        // Each collapse removes the two triangles around the edge. Everything in
+        // the one-ring of a collapsed position is left alone for the rest of the
+        // pass so the triangles checked for flips are still the ones being moved.
+        // Collapses much worse than the ones that would have met the target are
+        // left for a later pass, by then cheaper ones may have opened up. Each
+        // collapse blocks a handful of others, so a pass always gets some done.
+        size_t wanted = (triangleCount - targetIndexCount / 3 + 1) / 2;
+        size_t performed = 0;
+        double errorGoal = collapses.empty() ? 0.0 : collapses[std::min(wanted, collapses.size() - 1)].error;
+
+        for (const Collapse& collapse : collapses)
+        {
+            if (performed >= wanted)
+                break;
+            if (collapse.error > errorGoal * 1.5 && performed > wanted / 6)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // Every wedge moves onto the wedge of the target its own triangles use.
+            bool valid = true;
+            const glm::vec3& target = positions[collapse.to].pos;
+
+            for (u32 w = wedgeOffsets[collapse.from]; w < wedgeOffsets[collapse.from + 1] && valid; w++)
+            {
+                u32 wedge = wedges[w];
+                targets[wedge] = ~0u;
+
+                for (u32 a = adjacencyOffsets[wedge]; a < adjacencyOffsets[wedge + 1] && valid; a++)
+                {
+                    const u32* triangle = &result[3 * adjacency[a]];
+                    glm::vec3 before[3], after[3];
+                    bool moved = true;
+                    for (u32 k = 0; k < 3; k++)
+                    {
+                        if (positionOf[triangle[k]] == collapse.to)
+                        {
+                            targets[wedge] = triangle[k];
+                            moved = false;
+                        }
+                        before[k] = vertices[triangle[k]].pos;
+                        after[k] = triangle[k] == wedge ? target : before[k];
+                    }
+                    if (!moved)
+                        continue;
+
+                    glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                    glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                    valid = glm::dot(normalBefore, normalAfter) > 0.0f;
+                }
+
+                valid &= adjacencyOffsets[wedge] == adjacencyOffsets[wedge + 1] || targets[wedge] != ~0u;
+            }
+            if (!valid)
+                continue;
+
+            for (u32 w = wedgeOffsets[collapse.from]; w < wedgeOffsets[collapse.from + 1]; w++)
+            {
+                u32 wedge = wedges[w];
+                for (u32 a = adjacencyOffsets[wedge]; a < adjacencyOffsets[wedge + 1]; a++)
+                    for (u32 k = 0; k < 3; k++)
+                        touched[positionOf[result[3 * adjacency[a] + k]]] = true;
+                if (targets[wedge] != ~0u)
+                    remap[wedge] = targets[wedge];
+            }
+
+            // The target inherits the special edge the collapsed position had on
+            // its other side.
+            PositionInfo& from = info[collapse.from];
+            if (from.kind == VERTEX_SEAM || from.kind == VERTEX_BORDER)
+            {
+                u32 other = from.special[0] == collapse.to ? from.special[1] : from.special[0];
+                for (u32 p : { collapse.to, other })
+                {
+                    PositionInfo& position = info[p];
+                    u32 replacement = p == collapse.to ? other : collapse.to;
+                    for (u32 i = 0; i < 2; i++)
+                        if (position.special[i] == collapse.from)
+                            position.special[i] = replacement;
+                }
+            }
+            from.kind = VERTEX_LOCKED;
+
+            addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+            maxError = std::max(maxError, collapse.error);
+            performed++;
+        }
+
+        if (performed == 0)
+            break;
+
+        size_t written = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            u32 a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            result[written++] = a;
+            result[written++] = b;
+            result[written++] = c;
+        }
+        result.resize(written);
+    }
+
+    return static_cast<float>(std::sqrt(maxError));
+}
+
+void BuildLodChain(const std::vector<Vertex>& vertices, std::vector<u32>& indices, std::vector<MeshLod>& lods)
+{
+    const size_t fullIndexCount = indices.size();
+
+    lods.clear();
+    lods.push_back({ 0, static_cast<u32>(fullIndexCount), 0, 0, 0.0f });
+
+    std::vector<u32> simplified;
+    size_t targetIndexCount = fullIndexCount / 2;
+
+    while (lods.size() < MAX_MESH_LODS && targetIndexCount >= 3 * LOD_MIN_TRIANGLES)
+    {
+        float error = SimplifyMesh(vertices.data(), vertices.size(),
+            indices.data(), fullIndexCount, targetIndexCount, simplified);
+
+        if (simplified.size() > lods.back().indexCount * LOD_MIN_REDUCTION)
+            break;
+
+        std::vector<u32> clusters;
+        OptimizeVertexCache(simplified.data(), simplified.size(), vertices.size(), clusters);
+
+        MeshLod lod{};
+        lod.firstIndex = static_cast<u32>(indices.size());
+        lod.indexCount = static_cast<u32>(simplified.size());
+        lod.error = std::max(error, lods.back().error);
+        lods.push_back(lod);
+
+        indices.insert(indices.end(), simplified.begin(), simplified.end());
+        targetIndexCount = simplified.size() / 2;
+    }
+}
+
+BoundingSphere ComputeBoundingSphere(const Vertex* vertices, size_t vertexCount)
+{
+    BoundingSphere sphere{};
+    if (vertexCount == 0)
+        return sphere;
+
+    glm::vec3 minimum = vertices[0].pos, maximum = vertices[0].pos;
+    for (size_t i = 1; i < vertexCount; i++)
+    {
+        minimum = glm::min(minimum, vertices[i].pos);
+        maximum = glm::max(maximum, vertices[i].pos);
+    }
+
+    sphere.center = (minimum + maximum) * 0.5f;
+    for (size_t i = 0; i < vertexCount; i++)
+        sphere.radius = std::max(sphere.radius, glm::length(vertices[i].pos - sphere.center));
+    return sphere;
+}
@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <cmath>
+
+#include <MeshletBuilder.hpp>
+
+#define MESHLET_SEED_COHERENCE 0.7f
+
+static void computeMeshletBounds(const Vertex* vertices, const MeshletData& data, Meshlet& meshlet)
+{
+    const u32* meshletVertices = &data.vertices[meshlet.vertexOffset];
+    const u8* meshletTriangles = &data.triangles[meshlet.triangleOffset];
+
+    glm::vec3 minimum = vertices[meshletVertices[0]].pos, maximum = minimum;
+    for (u32 i = 1; i < meshlet.vertexCount; i++)
+    {
+        minimum = glm::min(minimum, vertices[meshletVertices[i]].pos);
+        maximum = glm::max(maximum, vertices[meshletVertices[i]].pos);
+    }
+
+    meshlet.center = (minimum + maximum) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (u32 i = 0; i < meshlet.vertexCount; i++)
+        meshlet.radius = std::max(meshlet.radius, glm::length(vertices[meshletVertices[i]].pos - meshlet.center));
+
+    // The cone axis is the average triangle normal, the cutoff comes from the
+    // normal furthest from it. Past 90 degrees some triangle always faces the
+    // camera.
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.triangleCount);
+    glm::vec3 axis(0.0f);
+    for (u32 i = 0; i < meshlet.triangleCount; i++)
+    {
+        const glm::vec3& p0 = vertices[meshletVertices[meshletTriangles[3 * i + 0]]].pos;
+        const glm::vec3& p1 = vertices[meshletVertices[meshletTriangles[3 * i + 1]]].pos;
+        const glm::vec3& p2 = vertices[meshletVertices[meshletTriangles[3 * i + 2]]].pos;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        if (length <= 0.0f)
+            continue;
+
+        normals.push_back(normal / length);
+        axis += normals.back();
+    }
+
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+
+    float axisLength = glm::length(axis);
+    if (normals.empty() || axisLength <= 0.0f)
+        return;
+
+    axis /= axisLength;
+    float minimumDot = 1.0f;
+    for (const glm::vec3& normal : normals)
+        minimumDot = std::min(minimumDot, glm::dot(axis, normal));
+
+    if (minimumDot <= 0.1f)
+        return;
+
+    meshlet.coneAxis = axis;
+    meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+}
+
+void BuildMeshlets(const Vertex* vertices, size_t vertexCount, u32* indices, size_t indexCount, MeshletData& data)
+{
+    const u32 triangleCount = static_cast<u32>(indexCount / 3);
+
+    std::vector<u32> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < indexCount; i++)
+        adjacencyOffsets[indices[i] + 1]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    std::vector<u32> adjacency(indexCount);
+    {
+        std::vector<u32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < indexCount; i++)
+            adjacency[fill[indices[i]]++] = static_cast<u32>(i / 3);
+    }
+
+    std::vector<glm::vec3> normals(triangleCount);
+    for (u32 t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3& p0 = vertices[indices[3 * t]].pos;
+        glm::vec3 normal = glm::cross(vertices[indices[3 * t + 1]].pos - p0, vertices[indices[3 * t + 2]].pos - p0);
+        float length = glm::length(normal);
+        normals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+    }
+
+    // Local index of each vertex in the open meshlet, valid while its stamp
+    // matches the meshlet's.
+    std::vector<u32> stamps(vertexCount, ~0u);
+    std::vector<u8> local(vertexCount);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<u32> order;
+    order.reserve(triangleCount);
+    std::vector<u32> meshletVertices;
+    u32 stamp = 0, seed = 0;
+
+    Meshlet meshlet{};
+    glm::vec3 normalSum(0.0f);
+
+    auto finish = [&]()
+    {
+        if (meshlet.triangleCount == 0)
+            return;
+
+        meshlet.vertexOffset = static_cast<u32>(data.vertices.size());
+        meshlet.triangleOffset = static_cast<u32>(data.triangles.size());
+        data.vertices.insert(data.vertices.end(), meshletVertices.begin(), meshletVertices.end());
+        for (size_t i = order.size() - meshlet.triangleCount; i < order.size(); i++)
+            for (u32 k = 0; k < 3; k++)
+                data.triangles.push_back(local[indices[3 * order[i] + k]]);
+
+        computeMeshletBounds(vertices, data, meshlet);
+        data.meshlets.push_back(meshlet);
+
+        meshlet = Meshlet{};
+        meshletVertices.clear();
+        normalSum = glm::vec3(0.0f);
+        stamp++;
+    };
+
+    // Meshlets grow through shared vertices, preferring triangles that add the
+    // fewest vertices and face the same way as the meshlet so far, which keeps
+    // the normal cones narrow enough to cull. When nothing connected fits, the
+    // first unused triangle in input order is nearby thanks to the vertex cache
+    // ordering. It joins the meshlet if it faces roughly the same way, otherwise
+    // it starts the next one.
+    while (order.size() < triangleCount)
+    {
+        u32 best = ~0u;
+        float bestScore = 0.0f;
+
+        if (meshlet.triangleCount > 0 && meshlet.triangleCount < MESHLET_MAX_TRIANGLES)
+        {
+            glm::vec3 axis = glm::length(normalSum) > 0.0f ? glm::normalize(normalSum) : glm::vec3(0.0f);
+
+            for (u32 vertex : meshletVertices)
+                for (u32 a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++)
+                {
+                    u32 t = adjacency[a];
+                    if (emitted[t])
+                        continue;
+
+                    const u32* triangle = &indices[3 * t];
+                    u32 extra = (stamps[triangle[0]] != stamp)
+                        + (stamps[triangle[1]] != stamp && triangle[1] != triangle[0])
+                        + (stamps[triangle[2]] != stamp && triangle[2] != triangle[0] && triangle[2] != triangle[1]);
+                    if (meshlet.vertexCount + extra > MESHLET_MAX_VERTICES)
+                        continue;
+
+                    float score = extra + 2.0f * (1.0f - glm::dot(axis, normals[t]));
+                    if (best == ~0u || score < bestScore)
+                    {
+                        best = t;
+                        bestScore = score;
+                    }
+                }
+        }
+
+        if (best == ~0u)
+        {
+            while (emitted[seed])
+                seed++;
+            best = seed;
+
+            const u32* triangle = &indices[3 * best];
+            u32 extra = (stamps[triangle[0]] != stamp) + (stamps[triangle[1]] != stamp) + (stamps[triangle[2]] != stamp);
+            glm::vec3 axis = glm::length(normalSum) > 0.0f ? glm::normalize(normalSum) : glm::vec3(0.0f);
+            if (meshlet.triangleCount == MESHLET_MAX_TRIANGLES || meshlet.vertexCount + extra > MESHLET_MAX_VERTICES ||
+                glm::dot(axis, normals[best]) < MESHLET_SEED_COHERENCE)
+                finish();
+        }
+
+        for (u32 k = 0; k < 3; k++)
+        {
+            u32 vertex = indices[3 * best + k];
+            if (stamps[vertex] != stamp)
+            {
+                stamps[vertex] = stamp;
+                local[vertex] = static_cast<u8>(meshlet.vertexCount++);
+                meshletVertices.push_back(vertex);
+            }
+        }
+
+        emitted[best] = true;
+        order.push_back(best);
+        normalSum += normals[best];
+        meshlet.triangleCount++;
+    }
+
+    finish();
+
+    std::vector<u32> reordered(indexCount);
+    for (u32 i = 0; i < triangleCount; i++)
+        for (u32 k = 0; k < 3; k++)
+            reordered[3 * i + k] = indices[3 * order[i] + k];
+    std::copy(reordered.begin(), reordered.end(), indices);
+}
+
+MeshletCullStats CullMeshlets(const Meshlet* meshlets, u32 meshletCount,
+    const glm::mat4& objectToClip, const glm::vec3& cameraPosition,
+    std::vector<VkDrawIndexedIndirectCommand>& draws)
+{
+    // Gribb-Hartmann planes for a [0, 1] depth range, normalized so distances
+    // are in object space units.
+    glm::mat4 rows = glm::transpose(objectToClip);
+    glm::vec4 planes[6] = {
+        rows[3] + rows[0], rows[3] - rows[0],
+        rows[3] + rows[1], rows[3] - rows[1],
+        rows[2], rows[3] - rows[2],
+    };
+    for (glm::vec4& plane : planes)
+        plane /= glm::length(glm::vec3(plane));
+
+    MeshletCullStats stats{};
+    draws.clear();
+
+    for (u32 i = 0; i < meshletCount; i++)
+    {
+        const Meshlet& meshlet = meshlets[i];
+
+        bool outside = false;
+        for (const glm::vec4& plane : planes)
+            outside |= glm::dot(glm::vec3(plane), meshlet.center) + plane.w < -meshlet.radius;
+        if (outside)
+        {
+            stats.frustumCulledTriangles += meshlet.triangleCount;
+            continue;
+        }
+
+        glm::vec3 view = meshlet.center - cameraPosition;
+        if (glm::dot(view, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(view) + meshlet.radius)
+        {
+            stats.coneCulledTriangles += meshlet.triangleCount;
+            continue;
+        }
+
+        stats.visibleMeshlets++;
+        stats.visibleTriangles += meshlet.triangleCount;
+
+        if (!draws.empty() && draws.back().firstIndex + draws.back().indexCount == meshlet.triangleOffset)
+        {
+            draws.back().indexCount += 3 * meshlet.triangleCount;
+            continue;
+        }
+
+        VkDrawIndexedIndirectCommand draw{};
+        draw.indexCount = 3 * meshlet.triangleCount;
+        draw.instanceCount = 1;
+        draw.firstIndex = meshlet.triangleOffset;
+        draws.push_back(draw);
+    }
+
+    return stats;
+}
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MIP_GENERATOR_SSE2
+#endif
+
+#include <MipGenerator.hpp>
+#include <PixelConversion.hpp>
+
+u32 GetMipCount(u32 width, u32 height)
+{
+    u32 count = 1;
+    for (u32 size = std::max(width, height); size > 1; size >>= 1)
+        count++;
+    return count;
+}
+
+// Linear RGBA of a texel, the source is either the sRGB base level or the
+// previous level's linear values. Alpha is linear already and scaled to [0, 1].
+#ifdef MIP_GENERATOR_SSE2
+static inline __m128 loadTexel(const float* decode, const u8* base, const float* linear, size_t index)
+{
+    if (linear)
+        return _mm_loadu_ps(linear + index * 4);
+
+    const u8* texel = base + index * 4;
+    return _mm_set_ps(texel[3] * (1.0f / 255.0f), decode[texel[2]], decode[texel[1]], decode[texel[0]]);
+}
+#else
+static inline void loadTexel(const float* decode, const u8* base, const float* linear, size_t index, float sum[4])
+{
+    if (linear)
+    {
+        for (u32 c = 0; c < 4; c++)
+            sum[c] += linear[index * 4 + c];
+        return;
+    }
+
+    const u8* texel = base + index * 4;
+    sum[0] += decode[texel[0]];
+    sum[1] += decode[texel[1]];
+    sum[2] += decode[texel[2]];
+    sum[3] += texel[3] * (1.0f / 255.0f);
+}
+#endif
+
+// Odd sizes fold their last row or column into the box next to it.
+static void filterRow(const float* decode, const u8* base, const float* linear, u32 sourceWidth, u32 sourceHeight,
+    u32 mipWidth, u32 mipHeight, u32 y, float* row)
+{
+    u32 y0 = y * sourceHeight / mipHeight, y1 = std::max(y0 + 1, (y + 1) * sourceHeight / mipHeight);
+    for (u32 x = 0; x < mipWidth; x++)
+    {
+        u32 x0 = x * sourceWidth / mipWidth, x1 = std::max(x0 + 1, (x + 1) * sourceWidth / mipWidth);
+        float weight = 1.0f / ((x1 - x0) * (y1 - y0));
+
+#ifdef MIP_GENERATOR_SSE2
+        __m128 sum = _mm_setzero_ps();
+        for (u32 sy = y0; sy < y1; sy++)
+            for (u32 sx = x0; sx < x1; sx++)
+                sum = _mm_add_ps(sum, loadTexel(decode, base, linear, static_cast<size_t>(sy) * sourceWidth + sx));
+        _mm_storeu_ps(row + x * 4, _mm_mul_ps(sum, _mm_set1_ps(weight)));
+#else
+        float sum[4] = {};
+        for (u32 sy = y0; sy < y1; sy++)
+            for (u32 sx = x0; sx < x1; sx++)
+                loadTexel(decode, base, linear, static_cast<size_t>(sy) * sourceWidth + sx, sum);
+        for (u32 c = 0; c < 4; c++)
+            row[x * 4 + c] = sum[c] * weight;
+#endif
+    }
+}
+
+void BuildMipChain(ThreadPool& pool, const u8* pixels, u32 width, u32 height, u32 mipCount, std::vector<u8>& chain)
+{
+    const float* decode = GetSrgbDecodeTable();
+
+    size_t size = 0;
+    for (u32 level = 0; level < mipCount; level++)
+        size += static_cast<size_t>(std::max(width >> level, 1u)) * std::max(height >> level, 1u) * 4;
+    chain.resize(size);
+    memcpy(chain.data(), pixels, static_cast<size_t>(width) * height * 4);
+
+    std::vector<float> source, destination;
+    size_t mipOffset = static_cast<size_t>(width) * height * 4;
+    u32 sourceWidth = width, sourceHeight = height;
+    for (u32 level = 1; level < mipCount; level++)
+    {
+        u32 mipWidth = std::max(sourceWidth >> 1, 1u), mipHeight = std::max(sourceHeight >> 1, 1u);
+        destination.resize(static_cast<size_t>(mipWidth) * mipHeight * 4);
+        const float* linear = level > 1 ? source.data() : nullptr;
+        u8* mip = chain.data() + mipOffset;
+
+        u32 jobCount = (mipHeight + MIP_ROWS_PER_JOB - 1) / MIP_ROWS_PER_JOB;
+        pool.ParallelFor(jobCount, [&](u32 job)
+        {
+            u32 lastRow = std::min((job + 1) * MIP_ROWS_PER_JOB, mipHeight);
+            for (u32 y = job * MIP_ROWS_PER_JOB; y < lastRow; y++)
+            {
+                size_t rowOffset = static_cast<size_t>(y) * mipWidth * 4;
+                filterRow(decode, pixels, linear, sourceWidth, sourceHeight, mipWidth, mipHeight, y, destination.data() + rowOffset);
+                EncodeSrgb(destination.data() + rowOffset, mip + rowOffset, mipWidth);
+            }
+        });
+
+        std::swap(source, destination);
+        mipOffset += static_cast<size_t>(mipWidth) * mipHeight * 4;
+        sourceWidth = mipWidth;
+        sourceHeight = mipHeight;
+    }
+}
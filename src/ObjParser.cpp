@@ -0,0 +1,723 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <MappedFile.hpp>
+#include <ObjParser.hpp>
+#include <VertexWelder.hpp>
+
+#define OBJ_CHUNK_MIN_SIZE (256 * 1024)
+#define OBJ_PARALLEL_WELD_THRESHOLD (1 << 20)
+
+// An o, g or usemtl record, applying from the face it precedes.
+typedef struct ObjChunkEvent
+{
+    u32 face;
+    u32 corner;
+    bool material;
+    std::string name;
+} ObjChunkEvent;
+
+typedef struct ObjChunk
+{
+    const char* begin;
+    const char* end;
+
+    std::vector<float> positions;
+    std::vector<float> texcoords;
+
+    // Face corners as (position, texcoord) pairs, -1 texcoord when absent.
+    // Negative OBJ indices are relative to the records seen so far, which this
+    // chunk only knows locally, so they are stored chunk relative and listed
+    // for a fixup once the bases of every chunk are known.
+    std::vector<int> faceCorners;
+    std::vector<u32> faceSizes;
+    std::vector<u32> relativePositions;
+    std::vector<u32> relativeTexcoords;
+
+    std::vector<ObjChunkEvent> events;
+
+    u32 positionBase;
+    u32 texcoordBase;
+    std::vector<ObjCorner> triangles;
+} ObjChunk;
+
+static inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static inline const char* skipBlanks(const char* p, const char* end)
+{
+    while (p < end && isBlank(*p)) p++;
+    return p;
+}
+
+static inline const char* skipLine(const char* p, const char* end)
+{
+    while (p < end && *p != '\n') p++;
+    return p < end ? p + 1 : end;
+}
+
+// Exact whenever the digits fit in 53 bits and |exponent| <= 22, which covers
+// everything exporters write. Anything else goes through strtod.
+static const char* parseFloat(const char* p, const char* end, float& value)
+{
+    static const double powers[] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    u64 mantissa = 0;
+    int digits = 0, exponent = 0;
+    bool any = false;
+
+    for (; p < end && isDigit(*p); p++, any = true)
+        if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); if (mantissa) digits++; }
+        else exponent++;
+
+    if (p < end && *p == '.')
+        for (p++; p < end && isDigit(*p); p++, any = true)
+            if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); exponent--; if (mantissa) digits++; }
+
+    if (!any)
+    {
+        value = 0.0f;
+        return start;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char* q = p + 1;
+        bool negativeExponent = false;
+        if (q < end && (*q == '-' || *q == '+'))
+            negativeExponent = *q++ == '-';
+        if (q < end && isDigit(*q))
+        {
+            int e = 0;
+            for (; q < end && isDigit(*q); q++)
+                if (e < 10000) e = e * 10 + (*q - '0');
+            exponent += negativeExponent ? -e : e;
+            p = q;
+        }
+    }
+
+    if (mantissa < (1ULL << 53) && exponent >= -22 && exponent <= 22)
+    {
+        double result = static_cast<double>(mantissa);
+        result = exponent < 0 ? result / powers[-exponent] : result * powers[exponent];
+        value = static_cast<float>(negative ? -result : result);
+        return p;
+    }
+
+    char buffer[64];
+    size_t length = static_cast<size_t>(p - start);
+    if (length >= sizeof(buffer)) length = sizeof(buffer) - 1;
+    memcpy(buffer, start, length);
+    buffer[length] = '\0';
+    value = static_cast<float>(strtod(buffer, nullptr));
+    return p;
+}
+
+static inline bool startsRecord(const char* p, const char* end, const char* keyword)
+{
+    size_t length = strlen(keyword);
+    return static_cast<size_t>(end - p) > length && memcmp(p, keyword, length) == 0 && isBlank(p[length]);
+}
+
+// The rest of the line with the surrounding blanks trimmed.
+static const char* parseName(const char* p, const char* end, std::string& name)
+{
+    p = skipBlanks(p, end);
+    const char* last = p;
+    while (last < end && *last != '\n') last++;
+    const char* next = last;
+    while (last > p && isBlank(last[-1])) last--;
+
+    name.assign(p, last);
+    return next;
+}
+
+static const char* parseInt(const char* p, const char* end, int& value, bool& valid)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    int result = 0;
+    valid = p < end && isDigit(*p);
+    for (; p < end && isDigit(*p); p++)
+        result = result * 10 + (*p - '0');
+
+    value = negative ? -result : result;
+    return p;
+}
+
+static void parseChunk(ObjChunk& chunk)
+{
+    const char* p = chunk.begin;
+    const char* end = chunk.end;
+
+    while (p < end)
+    {
+        p = skipBlanks(p, end);
+        if (p + 1 >= end)
+            break;
+
+        if (p[0] == 'v' && isBlank(p[1]))
+        {
+            p += 2;
+            for (int i = 0; i < 3; i++)
+            {
+                float value;
+                p = parseFloat(skipBlanks(p, end), end, value);
+                chunk.positions.push_back(value);
+            }
+        }
+        else if (p[0] == 'v' && p[1] == 't' && p + 2 < end && isBlank(p[2]))
+        {
+            p += 3;
+            for (int i = 0; i < 2; i++)
+            {
+                float value;
+                p = parseFloat(skipBlanks(p, end), end, value);
+                chunk.texcoords.push_back(value);
+            }
+        }
+        else if (p[0] == 'f' && isBlank(p[1]))
+        {
+            p += 2;
+            u32 size = 0;
+            for (;;)
+            {
+                p = skipBlanks(p, end);
+                if (p >= end || *p == '\n' || *p == '#')
+                    break;
+
+                int position = 0, texcoord = 0, normal = 0;
+                bool hasPosition = false, hasTexcoord = false, hasNormal = false;
+                p = parseInt(p, end, position, hasPosition);
+                if (p < end && *p == '/')
+                {
+                    p = parseInt(p + 1, end, texcoord, hasTexcoord);
+                    if (p < end && *p == '/')
+                        p = parseInt(p + 1, end, normal, hasNormal);
+                }
+                if (!hasPosition || position == 0)
+                    throw std::runtime_error("Invalid face in OBJ file");
+
+                size_t slot = chunk.faceCorners.size();
+                if (position < 0)
+                {
+                    chunk.relativePositions.push_back(static_cast<u32>(slot));
+                    position += static_cast<int>(chunk.positions.size() / 3);
+                }
+                else
+                {
+                    position -= 1;
+                }
+
+                if (!hasTexcoord)
+                {
+                    texcoord = -1;
+                }
+                else if (texcoord < 0)
+                {
+                    chunk.relativeTexcoords.push_back(static_cast<u32>(slot + 1));
+                    texcoord += static_cast<int>(chunk.texcoords.size() / 2);
+                }
+                else
+                {
+                    texcoord -= 1;
+                }
+
+                chunk.faceCorners.push_back(position);
+                chunk.faceCorners.push_back(texcoord);
+                size++;
+
+                while (p < end && !isBlank(*p) && *p != '\n') p++;
+            }
+
+            if (size >= 3)
+                chunk.faceSizes.push_back(size);
+            else
+                chunk.faceCorners.resize(chunk.faceCorners.size() - 2 * size);
+        }
+        else if ((p[0] == 'o' || p[0] == 'g') && isBlank(p[1]))
+        {
+            ObjChunkEvent event{ static_cast<u32>(chunk.faceSizes.size()), 0, false, {} };
+            p = parseName(p + 2, end, event.name);
+            chunk.events.push_back(std::move(event));
+        }
+        else if (startsRecord(p, end, "usemtl"))
+        {
+            ObjChunkEvent event{ static_cast<u32>(chunk.faceSizes.size()), 0, true, {} };
+            p = parseName(p + 7, end, event.name);
+            chunk.events.push_back(std::move(event));
+        }
+
+        p = skipLine(p, end);
+    }
+}
+
+// Crossing test of a point against a triangle in the projected plane.
+static bool insideTriangle(const float* x, const float* y, float testX, float testY)
+{
+    bool inside = false;
+    for (int i = 0, j = 2; i < 3; j = i++)
+    {
+        if ((y[i] > testY) != (y[j] > testY) && testX < (x[j] - x[i]) * (testY - y[i]) / (y[j] - y[i]) + x[i])
+            inside = !inside;
+    }
+    return inside;
+}
+
+// Ear clipping the way tinyobj does it, so both loaders agree on the triangles
+// of any polygon. The polygon is projected on the plane its first non
+// degenerate corner is most aligned with, and like tinyobj, corners left over
+// when no ear can be found are dropped.
+static void clipEars(std::vector<ObjCorner>& polygon, const ObjData& obj, std::vector<ObjCorner>& triangles)
+{
+    auto position = [&](const ObjCorner& corner) { return &obj.positions[3 * corner.position]; };
+
+    const size_t size = polygon.size();
+    int axes[2] = { 1, 2 };
+    for (size_t k = 0; k < size; k++)
+    {
+        const float* v0 = position(polygon[k]);
+        const float* v1 = position(polygon[(k + 1) % size]);
+        const float* v2 = position(polygon[(k + 2) % size]);
+        float e0x = v1[0] - v0[0], e0y = v1[1] - v0[1], e0z = v1[2] - v0[2];
+        float e1x = v2[0] - v1[0], e1y = v2[1] - v1[1], e1z = v2[2] - v1[2];
+        float cx = std::fabs(e0y * e1z - e0z * e1y);
+        float cy = std::fabs(e0z * e1x - e0x * e1z);
+        float cz = std::fabs(e0x * e1y - e0y * e1x);
+
+        const float epsilon = std::numeric_limits<float>::epsilon();
+        if (cx > epsilon || cy > epsilon || cz > epsilon)
+        {
+            if (!(cx > cy && cx > cz))
+            {
+                axes[0] = 0;
+                if (cz > cx && cz > cy)
+                    axes[1] = 1;
+            }
+            break;
+        }
+    }
+
+    // Every corner gets one try as an ear before the polygon is given up on.
+    size_t guess = 0, remainingIterations = size, previousCount = size;
+    while (polygon.size() > 3 && remainingIterations > 0)
+    {
+        const size_t count = polygon.size();
+        if (guess >= count)
+            guess -= count;
+
+        if (previousCount != count)
+        {
+            previousCount = count;
+            remainingIterations = count;
+        }
+        else
+        {
+            remainingIterations--;
+        }
+
+        ObjCorner ear[3];
+        float x[3], y[3];
+        for (int k = 0; k < 3; k++)
+        {
+            ear[k] = polygon[(guess + k) % count];
+            x[k] = position(ear[k])[axes[0]];
+            y[k] = position(ear[k])[axes[1]];
+        }
+
+        float cross = (x[1] - x[0]) * (y[2] - y[1]) - (y[1] - y[0]) * (x[2] - x[1]);
+        float area = (x[0] * y[1] - y[0] * x[1]) * 0.5f;
+        if (cross * area < 0.0f)
+        {
+            guess++;
+            continue;
+        }
+
+        bool overlap = false;
+        for (size_t other = 3; other < count && !overlap; other++)
+        {
+            const float* v = position(polygon[(guess + other) % count]);
+            overlap = insideTriangle(x, y, v[axes[0]], v[axes[1]]);
+        }
+        if (overlap)
+        {
+            guess++;
+            continue;
+        }
+
+        triangles.insert(triangles.end(), ear, ear + 3);
+        polygon.erase(polygon.begin() + (guess + 1) % count);
+    }
+
+    if (polygon.size() == 3)
+        triangles.insert(triangles.end(), polygon.begin(), polygon.end());
+}
+
+static void triangulateChunk(ObjChunk& chunk, const ObjData& obj)
+{
+    const u32 positionCount = static_cast<u32>(obj.positions.size() / 3);
+    const u32 texcoordCount = static_cast<u32>(obj.texcoords.size() / 2);
+
+    for (u32 slot : chunk.relativePositions)
+        chunk.faceCorners[slot] += static_cast<int>(chunk.positionBase);
+    for (u32 slot : chunk.relativeTexcoords)
+        chunk.faceCorners[slot] += static_cast<int>(chunk.texcoordBase);
+
+    auto corner = [&](size_t index)
+    {
+        ObjCorner result;
+        int position = chunk.faceCorners[2 * index];
+        int texcoord = chunk.faceCorners[2 * index + 1];
+
+        if (position < 0 || static_cast<u32>(position) >= positionCount)
+            throw std::runtime_error("Face with invalid vertex index in OBJ file");
+        if (texcoord >= 0 && static_cast<u32>(texcoord) >= texcoordCount)
+            throw std::runtime_error("Face with invalid texcoord index in OBJ file");
+
+        result.position = static_cast<u32>(position);
+        result.texcoord = texcoord < 0 ? OBJ_NO_TEXCOORD : static_cast<u32>(texcoord);
+        return result;
+    };
+
+    auto squaredDistance = [&](const ObjCorner& a, const ObjCorner& b)
+    {
+        const float* pa = &obj.positions[3 * a.position];
+        const float* pb = &obj.positions[3 * b.position];
+        float dx = pb[0] - pa[0], dy = pb[1] - pa[1], dz = pb[2] - pa[2];
+        return dx * dx + dy * dy + dz * dz;
+    };
+
+    chunk.triangles.reserve(chunk.faceCorners.size() / 2);
+    std::vector<ObjCorner> polygon;
+
+    size_t first = 0, event = 0;
+    for (u32 face = 0; face < chunk.faceSizes.size(); face++)
+    {
+        for (; event < chunk.events.size() && chunk.events[event].face == face; event++)
+            chunk.events[event].corner = static_cast<u32>(chunk.triangles.size());
+
+        u32 size = chunk.faceSizes[face];
+        if (size == 3)
+        {
+            chunk.triangles.insert(chunk.triangles.end(), { corner(first), corner(first + 1), corner(first + 2) });
+        }
+        else if (size == 4)
+        {
+            ObjCorner c0 = corner(first), c1 = corner(first + 1), c2 = corner(first + 2), c3 = corner(first + 3);
+            if (squaredDistance(c0, c2) < squaredDistance(c1, c3))
+                chunk.triangles.insert(chunk.triangles.end(), { c0, c1, c2, c0, c2, c3 });
+            else
+                chunk.triangles.insert(chunk.triangles.end(), { c0, c1, c3, c1, c2, c3 });
+        }
+        else
+        {
+            polygon.clear();
+            for (u32 i = 0; i < size; i++)
+                polygon.push_back(corner(first + i));
+            clipEars(polygon, obj, chunk.triangles);
+        }
+        first += size;
+    }
+
+    for (; event < chunk.events.size(); event++)
+        chunk.events[event].corner = static_cast<u32>(chunk.triangles.size());
+}
+
+static u32 internName(std::vector<std::string>& names, std::unordered_map<std::string, u32>& ids, const std::string& name)
+{
+    auto result = ids.emplace(name, static_cast<u32>(names.size()));
+    if (result.second)
+        names.push_back(name);
+    return result.first->second;
+}
+
+void ParseObj(ThreadPool& pool, const char* text, size_t size, ObjData& obj)
+{
+    obj.positions.clear();
+    obj.texcoords.clear();
+    obj.corners.clear();
+    obj.objects.clear();
+    obj.materials.clear();
+    obj.groups.clear();
+
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(size / OBJ_CHUNK_MIN_SIZE, 4 * (pool.GetThreadCount() + 1)));
+    std::vector<ObjChunk> chunks(chunkCount);
+
+    const char* end = text + size;
+    const char* begin = text;
+    for (size_t i = 0; i < chunkCount; i++)
+    {
+        const char* split = (i + 1 == chunkCount) ? end : text + size * (i + 1) / chunkCount;
+        if (split < begin) split = begin;
+        while (split < end && split[-1] != '\n') split++;
+
+        chunks[i].begin = begin;
+        chunks[i].end = split;
+        begin = split;
+    }
+
+    pool.ParallelFor(static_cast<u32>(chunkCount), [&](u32 i) { parseChunk(chunks[i]); });
+
+    size_t positionCount = 0, texcoordCount = 0;
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.positionBase = static_cast<u32>(positionCount / 3);
+        chunk.texcoordBase = static_cast<u32>(texcoordCount / 2);
+        positionCount += chunk.positions.size();
+        texcoordCount += chunk.texcoords.size();
+    }
+
+    obj.positions.reserve(positionCount);
+    obj.texcoords.reserve(texcoordCount);
+    for (ObjChunk& chunk : chunks)
+    {
+        obj.positions.insert(obj.positions.end(), chunk.positions.begin(), chunk.positions.end());
+        obj.texcoords.insert(obj.texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+        std::vector<float>().swap(chunk.positions);
+        std::vector<float>().swap(chunk.texcoords);
+    }
+
+    pool.ParallelFor(static_cast<u32>(chunkCount), [&](u32 i) { triangulateChunk(chunks[i], obj); });
+
+    // Runs of triangles between the o/g/usemtl records, in file order.
+    std::unordered_map<std::string, u32> objectIds, materialIds;
+    std::vector<ObjGroup> runs;
+    u32 object = ~0u, material = ~0u;
+    size_t cornerCount = 0;
+
+    auto addRun = [&](u32 firstCorner, u32 lastCorner)
+    {
+        if (firstCorner == lastCorner)
+            return;
+        if (object == ~0u)
+            object = internName(obj.objects, objectIds, "");
+        if (material == ~0u)
+            material = internName(obj.materials, materialIds, "");
+
+        if (!runs.empty() && runs.back().object == object && runs.back().material == material)
+            runs.back().cornerCount += lastCorner - firstCorner;
+        else
+            runs.push_back({ object, material, firstCorner, lastCorner - firstCorner });
+    };
+
+    for (const ObjChunk& chunk : chunks)
+    {
+        u32 base = static_cast<u32>(cornerCount);
+        u32 corner = 0;
+        for (const ObjChunkEvent& event : chunk.events)
+        {
+            addRun(base + corner, base + event.corner);
+            corner = event.corner;
+            if (event.material)
+                material = internName(obj.materials, materialIds, event.name);
+            else
+                object = internName(obj.objects, objectIds, event.name);
+        }
+        addRun(base + corner, base + static_cast<u32>(chunk.triangles.size()));
+        cornerCount += chunk.triangles.size();
+    }
+
+    obj.corners.reserve(cornerCount);
+    for (const ObjChunk& chunk : chunks)
+        obj.corners.insert(obj.corners.end(), chunk.triangles.begin(), chunk.triangles.end());
+
+    // Runs sharing an object and material become one group.
+    std::unordered_map<u64, u32> groupIds;
+    std::vector<u32> runGroups(runs.size());
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        u64 key = static_cast<u64>(runs[i].object) << 32 | runs[i].material;
+        auto result = groupIds.emplace(key, static_cast<u32>(obj.groups.size()));
+        if (result.second)
+            obj.groups.push_back({ runs[i].object, runs[i].material, 0, 0 });
+        runGroups[i] = result.first->second;
+        obj.groups[runGroups[i]].cornerCount += runs[i].cornerCount;
+    }
+
+    for (size_t i = 1; i < obj.groups.size(); i++)
+        obj.groups[i].firstCorner = obj.groups[i - 1].firstCorner + obj.groups[i - 1].cornerCount;
+
+    if (obj.groups.size() == runs.size())
+        return;
+
+    std::vector<ObjCorner> grouped(cornerCount);
+    std::vector<u32> fill(obj.groups.size());
+    for (size_t i = 0; i < obj.groups.size(); i++)
+        fill[i] = obj.groups[i].firstCorner;
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        std::copy_n(obj.corners.begin() + runs[i].firstCorner, runs[i].cornerCount, grouped.begin() + fill[runGroups[i]]);
+        fill[runGroups[i]] += runs[i].cornerCount;
+    }
+    obj.corners = std::move(grouped);
+}
+
+static inline Vertex objVertex(const ObjData& obj, const ObjCorner& corner)
+{
+    Vertex vertex{};
+
+    vertex.pos =
+    {
+        obj.positions[3 * corner.position + 0],
+        obj.positions[3 * corner.position + 1],
+        obj.positions[3 * corner.position + 2]
+    };
+
+    if (corner.texcoord != OBJ_NO_TEXCOORD)
+    {
+        vertex.texCoord =
+        {
+            obj.texcoords[2 * corner.texcoord + 0],
+            1.0f - obj.texcoords[2 * corner.texcoord + 1]
+        };
+    }
+
+    vertex.color = { 1.0f, 1.0f, 1.0f };
+    return vertex;
+}
+
+void WeldObj(ThreadPool& pool, const ObjData& obj, const ObjGroup& group, std::vector<Vertex>& vertices, std::vector<u32>& indices)
+{
+    const u32 cornerCount = group.cornerCount;
+    const ObjCorner* corners = obj.corners.data() + group.firstCorner;
+
+    if (cornerCount >= OBJ_PARALLEL_WELD_THRESHOLD && pool.GetThreadCount() > 0)
+    {
+        VertexWelder::WeldParallel(pool, cornerCount,
+            [&](u32 i) { return objVertex(obj, corners[i]); },
+            vertices, indices);
+        return;
+    }
+
+    // Closed meshes share each vertex between about six triangles, seams and
+    // UV islands double that, so the face count is a comfortable first guess.
+    VertexWelder welder;
+    welder.Reserve(cornerCount / 3);
+
+    indices.resize(cornerCount);
+    for (u32 i = 0; i < cornerCount; i++)
+        indices[i] = welder.Insert(objVertex(obj, corners[i]));
+
+    vertices = std::move(welder.GetVertices());
+}
+
+void StreamObj(const char* path, std::vector<std::string>& objects, std::vector<std::string>& materials,
+    const std::function<void(ObjStreamBlock&)>& emit)
+{
+    MappedFile file;
+    if (!file.Open(path, MAPPED_FILE_SEQUENTIAL))
+        throw std::runtime_error(std::string("Failed to open ") + path);
+
+    // Only positions, texcoords and names are filled, the window's faces are
+    // triangulated against them as one chunk.
+    ObjData obj;
+    std::unordered_map<std::string, u32> objectIds, materialIds;
+    u32 object = ~0u, material = ~0u;
+
+    ObjStreamBlock block{};
+    VertexWelder welder;
+    welder.Reserve(OBJ_STREAM_BLOCK_VERTICES);
+
+    auto flush = [&]()
+    {
+        if (block.indices.empty())
+            return;
+        block.vertices = std::move(welder.GetVertices());
+        emit(block);
+
+        block.vertices.clear();
+        block.indices.clear();
+        welder = VertexWelder();
+        welder.Reserve(OBJ_STREAM_BLOCK_VERTICES);
+    };
+
+    auto addTriangles = [&](const ObjCorner* corners, size_t count)
+    {
+        if (count == 0)
+            return;
+        if (object == ~0u)
+            object = internName(obj.objects, objectIds, "");
+        if (material == ~0u)
+            material = internName(obj.materials, materialIds, "");
+        block.object = object;
+        block.material = material;
+
+        for (size_t i = 0; i < count; i += 3)
+        {
+            if (welder.GetVertices().size() + 3 > OBJ_STREAM_BLOCK_VERTICES)
+                flush();
+            for (size_t j = i; j < i + 3; j++)
+                block.indices.push_back(welder.Insert(objVertex(obj, corners[j])));
+        }
+    };
+
+    const char* data = file.GetData();
+    size_t size = file.GetSize();
+
+    for (size_t offset = 0; offset < size;)
+    {
+        // Whole lines only, the partial last line starts the next window.
+        size_t length = std::min<size_t>(OBJ_STREAM_WINDOW_SIZE, size - offset);
+        if (offset + length < size)
+        {
+            while (length > 0 && data[offset + length - 1] != '\n') length--;
+            if (length == 0)
+                throw std::runtime_error("OBJ line longer than the stream window");
+        }
+
+        ObjChunk chunk{};
+        chunk.begin = data + offset;
+        chunk.end = data + offset + length;
+        parseChunk(chunk);
+
+        chunk.positionBase = static_cast<u32>(obj.positions.size() / 3);
+        chunk.texcoordBase = static_cast<u32>(obj.texcoords.size() / 2);
+        obj.positions.insert(obj.positions.end(), chunk.positions.begin(), chunk.positions.end());
+        obj.texcoords.insert(obj.texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+        triangulateChunk(chunk, obj);
+
+        u32 corner = 0;
+        for (const ObjChunkEvent& event : chunk.events)
+        {
+            addTriangles(chunk.triangles.data() + corner, event.corner - corner);
+            corner = event.corner;
+
+            u32& current = event.material ? material : object;
+            u32 id = internName(event.material ? obj.materials : obj.objects, event.material ? materialIds : objectIds, event.name);
+            if (id != current)
+                flush();
+            current = id;
+        }
+        addTriangles(chunk.triangles.data() + corner, chunk.triangles.size() - corner);
+
+        file.Discard(offset, length);
+        offset += length;
+    }
+
+    flush();
+    objects = std::move(obj.objects);
+    materials = std::move(obj.materials);
+}
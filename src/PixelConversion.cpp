@@ -0,0 +1,480 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PIXEL_CONVERSION_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#ifdef PIXEL_CONVERSION_BENCHMARK
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#endif
+
+#include <PixelConversion.hpp>
+
+// GCC and Clang only emit the instructions in functions marked for them, MSVC
+// does in any function.
+#if defined(PIXEL_CONVERSION_X86) && defined(__GNUC__)
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#endif
+
+#define SRGB_ENCODE_SIZE 65536
+
+typedef struct SrgbTables
+{
+    float decode[256];
+    u8 encode[SRGB_ENCODE_SIZE];
+} SrgbTables;
+
+static float srgbToLinear(float value)
+{
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static u8 linearToSrgb(float value)
+{
+    value = std::min(std::max(value, 0.0f), 1.0f);
+    float encoded = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    return static_cast<u8>(encoded * 255.0f + 0.5f);
+}
+
+// The encode table is fine enough that even the darkest steps, where sRGB is
+// steepest, land within a rounding of the exact curve.
+static const SrgbTables& getSrgbTables()
+{
+    static const std::unique_ptr<SrgbTables> tables = []()
+    {
+        std::unique_ptr<SrgbTables> result = std::make_unique<SrgbTables>();
+        for (u32 i = 0; i < 256; i++)
+            result->decode[i] = srgbToLinear(i / 255.0f);
+        for (u32 i = 0; i < SRGB_ENCODE_SIZE; i++)
+            result->encode[i] = linearToSrgb(i / static_cast<float>(SRGB_ENCODE_SIZE - 1));
+        return result;
+    }();
+    return *tables;
+}
+
+const float* GetSrgbDecodeTable()
+{
+    return getSrgbTables().decode;
+}
+
+// AVX2 also needs the OS to save the YMM registers.
+static u32 detectLevel()
+{
+#ifdef PIXEL_CONVERSION_X86
+    u32 features = 0, extendedFeatures = 0;
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    features = static_cast<u32>(info[2]);
+    if (maxLeaf >= 7)
+    {
+        __cpuidex(info, 7, 0);
+        extendedFeatures = static_cast<u32>(info[1]);
+    }
+#else
+    u32 eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        features = ecx;
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        extendedFeatures = ebx;
+#endif
+
+    if (!(features & (1u << 9)))
+        return PIXEL_CONVERSION_SCALAR;
+    if (!(features & (1u << 27)) || !(features & (1u << 28)) || !(extendedFeatures & (1u << 5)))
+        return PIXEL_CONVERSION_SSSE3;
+
+#ifdef _MSC_VER
+    u64 enabledState = _xgetbv(0);
+#else
+    u32 low, high;
+    __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+    u64 enabledState = (static_cast<u64>(high) << 32) | low;
+#endif
+    return (enabledState & 6) == 6 ? PIXEL_CONVERSION_AVX2 : PIXEL_CONVERSION_SSSE3;
+#else
+    return PIXEL_CONVERSION_SCALAR;
+#endif
+}
+
+static std::atomic<u32> s_level{ PIXEL_CONVERSION_AVX2 };
+
+u32 GetSupportedPixelConversionLevel()
+{
+    static const u32 level = detectLevel();
+    return level;
+}
+
+u32 GetPixelConversionLevel()
+{
+    return std::min(s_level.load(std::memory_order_relaxed), GetSupportedPixelConversionLevel());
+}
+
+void SetPixelConversionLevel(u32 level)
+{
+    s_level.store(level, std::memory_order_relaxed);
+}
+
+// The scalar conversions also finish what the wider ones leave over.
+static void expandRgbToRgbaScalar(const u8* source, u8* destination, size_t pixelCount)
+{
+    for (size_t i = 0; i < pixelCount; i++, source += 3, destination += 4)
+    {
+        destination[0] = source[0];
+        destination[1] = source[1];
+        destination[2] = source[2];
+        destination[3] = 255;
+    }
+}
+
+static void swizzleRgbaToBgraScalar(const u8* source, u8* destination, size_t pixelCount)
+{
+    for (size_t i = 0; i < pixelCount; i++, source += 4, destination += 4)
+    {
+        u8 red = source[0];
+        destination[0] = source[2];
+        destination[1] = source[1];
+        destination[2] = red;
+        destination[3] = source[3];
+    }
+}
+
+// Exact rounding of color * alpha / 255, the same as the vector paths.
+static inline u8 multiplyAlpha(u32 color, u32 alpha)
+{
+    u32 product = color * alpha + 128;
+    return static_cast<u8>((product + (product >> 8)) >> 8);
+}
+
+static void premultiplyAlphaScalar(const u8* source, u8* destination, size_t pixelCount)
+{
+    for (size_t i = 0; i < pixelCount; i++, source += 4, destination += 4)
+    {
+        u8 alpha = source[3];
+        destination[0] = multiplyAlpha(source[0], alpha);
+        destination[1] = multiplyAlpha(source[1], alpha);
+        destination[2] = multiplyAlpha(source[2], alpha);
+        destination[3] = alpha;
+    }
+}
+
+static void decodeSrgbScalar(const u8* source, float* destination, size_t pixelCount)
+{
+    const float* decode = getSrgbTables().decode;
+    for (size_t i = 0; i < pixelCount; i++, source += 4, destination += 4)
+    {
+        destination[0] = decode[source[0]];
+        destination[1] = decode[source[1]];
+        destination[2] = decode[source[2]];
+        destination[3] = source[3] * (1.0f / 255.0f);
+    }
+}
+
+static void encodeSrgbScalar(const float* source, u8* destination, size_t pixelCount)
+{
+    const u8* encode = getSrgbTables().encode;
+    const float colorScale = static_cast<float>(SRGB_ENCODE_SIZE - 1);
+    for (size_t i = 0; i < pixelCount; i++, source += 4, destination += 4)
+    {
+        for (u32 c = 0; c < 4; c++)
+        {
+            float value = std::min(std::max(source[c], 0.0f), 1.0f);
+            u32 index = static_cast<u32>(value * (c < 3 ? colorScale : 255.0f) + 0.5f);
+            destination[c] = c < 3 ? encode[index] : static_cast<u8>(index);
+        }
+    }
+}
+
+// The vector paths return how many pixels they converted. Loads of packed RGB
+// read a few bytes past the pixels they use, so they stop early enough to
+// stay inside the source.
+#ifdef PIXEL_CONVERSION_X86
+TARGET_SSSE3 static size_t expandRgbToRgbaSsse3(const u8* source, u8* destination, size_t pixelCount)
+{
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+    size_t i = 0;
+    for (; i + 6 <= pixelCount; i += 4)
+    {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), alpha));
+    }
+    return i;
+}
+
+TARGET_AVX2 static size_t expandRgbToRgbaAvx2(const u8* source, u8* destination, size_t pixelCount)
+{
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+    size_t i = 0;
+    for (; i + 10 <= pixelCount; i += 8)
+    {
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 3));
+        __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 3 + 12));
+        __m256i pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), alpha));
+    }
+    return i;
+}
+
+TARGET_SSSE3 static size_t swizzleRgbaToBgraSsse3(const u8* source, u8* destination, size_t pixelCount)
+{
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    size_t i = 0;
+    for (; i + 4 <= pixelCount; i += 4)
+    {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), _mm_shuffle_epi8(pixels, shuffle));
+    }
+    return i;
+}
+
+TARGET_AVX2 static size_t swizzleRgbaToBgraAvx2(const u8* source, u8* destination, size_t pixelCount)
+{
+    const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    size_t i = 0;
+    for (; i + 8 <= pixelCount; i += 8)
+    {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i * 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i * 4), _mm256_shuffle_epi8(pixels, shuffle));
+    }
+    return i;
+}
+
+// Channels are widened to 16 bits, two pixels to a register half. Each
+// pixel's alpha is spread over its color lanes and its own lane is multiplied
+// by 255, which rounds back to alpha.
+TARGET_SSSE3 static inline __m128i multiplyAlphaSsse3(__m128i channels)
+{
+    const __m128i spread = _mm_setr_epi8(6, 7, 6, 7, 6, 7, -1, -1, 14, 15, 14, 15, 14, 15, -1, -1);
+    const __m128i alphaLane = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+    __m128i factors = _mm_or_si128(_mm_shuffle_epi8(channels, spread), alphaLane);
+    __m128i product = _mm_add_epi16(_mm_mullo_epi16(channels, factors), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+}
+
+TARGET_SSSE3 static size_t premultiplyAlphaSsse3(const u8* source, u8* destination, size_t pixelCount)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= pixelCount; i += 4)
+    {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 4));
+        __m128i low = multiplyAlphaSsse3(_mm_unpacklo_epi8(pixels, zero));
+        __m128i high = multiplyAlphaSsse3(_mm_unpackhi_epi8(pixels, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i * 4), _mm_packus_epi16(low, high));
+    }
+    return i;
+}
+
+TARGET_AVX2 static inline __m256i multiplyAlphaAvx2(__m256i channels)
+{
+    const __m256i spread = _mm256_setr_epi8(6, 7, 6, 7, 6, 7, -1, -1, 14, 15, 14, 15, 14, 15, -1, -1,
+        6, 7, 6, 7, 6, 7, -1, -1, 14, 15, 14, 15, 14, 15, -1, -1);
+    const __m256i alphaLane = _mm256_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255);
+    __m256i factors = _mm256_or_si256(_mm256_shuffle_epi8(channels, spread), alphaLane);
+    __m256i product = _mm256_add_epi16(_mm256_mullo_epi16(channels, factors), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(product, _mm256_srli_epi16(product, 8)), 8);
+}
+
+// Unpacking and packing both work within 128-bit halves, so the pixels come
+// back out in order.
+TARGET_AVX2 static size_t premultiplyAlphaAvx2(const u8* source, u8* destination, size_t pixelCount)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= pixelCount; i += 8)
+    {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i * 4));
+        __m256i low = multiplyAlphaAvx2(_mm256_unpacklo_epi8(pixels, zero));
+        __m256i high = multiplyAlphaAvx2(_mm256_unpackhi_epi8(pixels, zero));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i * 4), _mm256_packus_epi16(low, high));
+    }
+    return i;
+}
+
+// Only AVX2 can gather from the decode table, below it the scalar path is
+// as fast as any.
+TARGET_AVX2 static size_t decodeSrgbAvx2(const u8* source, float* destination, size_t pixelCount)
+{
+    const float* decode = getSrgbTables().decode;
+    const __m256 alphaScale = _mm256_set1_ps(1.0f / 255.0f);
+    size_t i = 0;
+    for (; i + 2 <= pixelCount; i += 2)
+    {
+        __m256i texels = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(source + i * 4)));
+        __m256 color = _mm256_i32gather_ps(decode, texels, 4);
+        __m256 alpha = _mm256_mul_ps(_mm256_cvtepi32_ps(texels), alphaScale);
+        _mm256_storeu_ps(destination + i * 4, _mm256_blend_ps(color, alpha, 0x88));
+    }
+    return i;
+}
+
+// The table lookups bound the encode, wider registers only slow it down, with
+// gathers as well as without.
+TARGET_SSSE3 static size_t encodeSrgbSsse3(const float* source, u8* destination, size_t pixelCount)
+{
+    const u8* encode = getSrgbTables().encode;
+    const float colorScale = static_cast<float>(SRGB_ENCODE_SIZE - 1);
+    const __m128 scale = _mm_set_ps(255.0f, colorScale, colorScale, colorScale);
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(source + i * 4), zero), one);
+        alignas(16) i32 index[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(index), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, scale), half)));
+
+        u8* texel = destination + i * 4;
+        texel[0] = encode[index[0]];
+        texel[1] = encode[index[1]];
+        texel[2] = encode[index[2]];
+        texel[3] = static_cast<u8>(index[3]);
+    }
+    return pixelCount;
+}
+#endif
+
+void ExpandRgbToRgba(const u8* source, u8* destination, size_t pixelCount)
+{
+    size_t converted = 0;
+#ifdef PIXEL_CONVERSION_X86
+    u32 level = GetPixelConversionLevel();
+    if (level >= PIXEL_CONVERSION_AVX2)
+        converted = expandRgbToRgbaAvx2(source, destination, pixelCount);
+    else if (level >= PIXEL_CONVERSION_SSSE3)
+        converted = expandRgbToRgbaSsse3(source, destination, pixelCount);
+#endif
+    expandRgbToRgbaScalar(source + converted * 3, destination + converted * 4, pixelCount - converted);
+}
+
+void SwizzleRgbaToBgra(const u8* source, u8* destination, size_t pixelCount)
+{
+    size_t converted = 0;
+#ifdef PIXEL_CONVERSION_X86
+    u32 level = GetPixelConversionLevel();
+    if (level >= PIXEL_CONVERSION_AVX2)
+        converted = swizzleRgbaToBgraAvx2(source, destination, pixelCount);
+    else if (level >= PIXEL_CONVERSION_SSSE3)
+        converted = swizzleRgbaToBgraSsse3(source, destination, pixelCount);
+#endif
+    swizzleRgbaToBgraScalar(source + converted * 4, destination + converted * 4, pixelCount - converted);
+}
+
+void PremultiplyAlpha(const u8* source, u8* destination, size_t pixelCount)
+{
+    size_t converted = 0;
+#ifdef PIXEL_CONVERSION_X86
+    u32 level = GetPixelConversionLevel();
+    if (level >= PIXEL_CONVERSION_AVX2)
+        converted = premultiplyAlphaAvx2(source, destination, pixelCount);
+    else if (level >= PIXEL_CONVERSION_SSSE3)
+        converted = premultiplyAlphaSsse3(source, destination, pixelCount);
+#endif
+    premultiplyAlphaScalar(source + converted * 4, destination + converted * 4, pixelCount - converted);
+}
+
+void DecodeSrgb(const u8* source, float* destination, size_t pixelCount)
+{
+    size_t converted = 0;
+#ifdef PIXEL_CONVERSION_X86
+    u32 level = GetPixelConversionLevel();
+    if (level >= PIXEL_CONVERSION_AVX2)
+        converted = decodeSrgbAvx2(source, destination, pixelCount);
+#endif
+    decodeSrgbScalar(source + converted * 4, destination + converted * 4, pixelCount - converted);
+}
+
+void EncodeSrgb(const float* source, u8* destination, size_t pixelCount)
+{
+    size_t converted = 0;
+#ifdef PIXEL_CONVERSION_X86
+    u32 level = GetPixelConversionLevel();
+    if (level >= PIXEL_CONVERSION_SSSE3)
+        converted = encodeSrgbSsse3(source, destination, pixelCount);
+#endif
+    encodeSrgbScalar(source + converted * 4, destination + converted * 4, pixelCount - converted);
+}
+
+#ifdef PIXEL_CONVERSION_BENCHMARK
+typedef struct ConversionBenchmark
+{
+    const char* name;
+    std::function<void()> convert;
+    const void* output;
+    size_t outputSize;
+} ConversionBenchmark;
+
+// Each conversion is repeated over at least 64M pixels and its fastest run
+// counts. The scalar output is the reference for the other levels.
+void BenchmarkPixelConversion(const u8* pixels, size_t pixelCount)
+{
+    static const char* levelNames[] = { "scalar", "SSSE3", "AVX2" };
+
+    std::vector<u8> rgb(pixelCount * 3), rgba(pixels, pixels + pixelCount * 4), bytes(pixelCount * 4);
+    std::vector<float> linear(pixelCount * 4), floats(pixelCount * 4);
+    for (size_t i = 0; i < pixelCount; i++)
+        memcpy(rgb.data() + i * 3, pixels + i * 4, 3);
+    decodeSrgbScalar(rgba.data(), linear.data(), pixelCount);
+
+    std::vector<ConversionBenchmark> benchmarks = {
+        { "expand RGB to RGBA", [&]() { ExpandRgbToRgba(rgb.data(), bytes.data(), pixelCount); }, bytes.data(), bytes.size() },
+        { "swizzle RGBA to BGRA", [&]() { SwizzleRgbaToBgra(rgba.data(), bytes.data(), pixelCount); }, bytes.data(), bytes.size() },
+        { "premultiply alpha", [&]() { PremultiplyAlpha(rgba.data(), bytes.data(), pixelCount); }, bytes.data(), bytes.size() },
+        { "decode sRGB", [&]() { DecodeSrgb(rgba.data(), floats.data(), pixelCount); }, floats.data(), floats.size() * sizeof(float) },
+        { "encode sRGB", [&]() { EncodeSrgb(linear.data(), bytes.data(), pixelCount); }, bytes.data(), bytes.size() },
+    };
+
+    u32 previousLevel = s_level.load();
+    size_t repeats = std::max<size_t>(1, (64ull << 20) / std::max<size_t>(pixelCount, 1));
+    std::cout << "Pixel conversion benchmark (" << pixelCount << " pixels)\n";
+    for (const ConversionBenchmark& benchmark : benchmarks)
+    {
+        std::vector<u8> reference;
+        for (u32 level = PIXEL_CONVERSION_SCALAR; level <= GetSupportedPixelConversionLevel(); level++)
+        {
+            SetPixelConversionLevel(level);
+            double fastest = 0.0;
+            for (size_t i = 0; i < repeats; i++)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                benchmark.convert();
+                double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+                fastest = i == 0 ? seconds : std::min(fastest, seconds);
+            }
+
+            const u8* output = static_cast<const u8*>(benchmark.output);
+            if (level == PIXEL_CONVERSION_SCALAR)
+                reference.assign(output, output + benchmark.outputSize);
+            bool match = memcmp(reference.data(), output, benchmark.outputSize) == 0;
+
+            std::cout << "  " << std::left << std::setw(21) << benchmark.name << std::setw(6) << levelNames[level] << ": "
+                << pixelCount / std::max(fastest, 1e-9) / 1e6 << " Mpixels/s"
+                << (match ? "" : ", MISMATCH") << "\n";
+        }
+    }
+    std::cout << std::flush;
+    SetPixelConversionLevel(previousLevel);
+}
+#endif
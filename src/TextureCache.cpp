@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#include <TextureCache.hpp>
+
+u64 TextureCache::GetMipSize(VkFormat format, u32 width, u32 height, u32 level)
+{
+    u64 mipWidth = std::max(width >> level, 1u), mipHeight = std::max(height >> level, 1u);
+    switch (format)
+    {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        return mipWidth * mipHeight * 4;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        return ((mipWidth + 3) / 4) * ((mipHeight + 3) / 4) * 8;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+        return ((mipWidth + 3) / 4) * ((mipHeight + 3) / 4) * 16;
+    default:
+        return 0;
+    }
+}
+
+bool TextureCache::Write(const std::string& cachePath, const AssetDependencies& dependencies,
+    VkFormat format, u32 width, u32 height, u32 mipCount, const u8* data, size_t size)
+{
+    TextureCacheHeader header{};
+    header.magic = TEXTURE_CACHE_MAGIC;
+    header.version = TEXTURE_CACHE_VERSION;
+    header.format = static_cast<u32>(format);
+    header.width = width;
+    header.height = height;
+    header.mipCount = mipCount;
+    header.dependencies = dependencies;
+    header.dataSize = size;
+
+    std::string tempPath = cachePath + ".tmp";
+
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(data), size);
+    file.close();
+
+    std::remove(cachePath.c_str());
+    if (!file || std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool TextureCache::IsValidHeader(const TextureCacheHeader& header)
+{
+    bool valid = header.magic == TEXTURE_CACHE_MAGIC &&
+        header.version == TEXTURE_CACHE_VERSION &&
+        header.dependencies.count <= MAX_ASSET_DEPENDENCIES &&
+        header.width > 0 && header.height > 0 &&
+        header.mipCount > 0 && header.mipCount <= 32;
+
+    u64 expectedSize = 0;
+    for (u32 level = 0; valid && level < header.mipCount; level++)
+    {
+        u64 mipSize = GetMipSize(static_cast<VkFormat>(header.format), header.width, header.height, level);
+        valid = mipSize > 0;
+        expectedSize += mipSize;
+    }
+    return valid && expectedSize == header.dataSize;
+}
+
+bool TextureCache::Open(const std::string& cachePath)
+{
+    Close();
+
+    if (!m_file.Open(cachePath, MAPPED_FILE_WILLNEED) || m_file.GetSize() < sizeof(TextureCacheHeader))
+    {
+        Close();
+        return false;
+    }
+
+    const TextureCacheHeader* header = reinterpret_cast<const TextureCacheHeader*>(m_file.GetData());
+    if (!IsValidHeader(*header) || m_file.GetSize() != sizeof(TextureCacheHeader) + header->dataSize)
+    {
+        Close();
+        return false;
+    }
+
+    m_header = header;
+    return true;
+}
+
+void TextureCache::Close()
+{
+    m_file.Close();
+    m_header = nullptr;
+}
+
+const AssetDependencies& TextureCache::GetDependencies() const
+{
+    static const AssetDependencies none{};
+    return m_header ? m_header->dependencies : none;
+}
+
+VkFormat TextureCache::GetFormat() const
+{
+    return m_header ? static_cast<VkFormat>(m_header->format) : VK_FORMAT_UNDEFINED;
+}
+
+u32 TextureCache::GetWidth() const
+{
+    return m_header ? m_header->width : 0;
+}
+
+u32 TextureCache::GetHeight() const
+{
+    return m_header ? m_header->height : 0;
+}
+
+u32 TextureCache::GetMipCount() const
+{
+    return m_header ? m_header->mipCount : 0;
+}
+
+const u8* TextureCache::GetData() const
+{
+    return reinterpret_cast<const u8*>(m_file.GetData() + sizeof(TextureCacheHeader));
+}
+
+size_t TextureCache::GetDataSize() const
+{
+    return m_header ? static_cast<size_t>(m_header->dataSize) : 0;
+}
@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <MyUtils.hpp>
+#include <MipGenerator.hpp>
+#include <TexturePacker.hpp>
+
+// Seeds the hash of the packed array, which depends on the layout as much as
+// on the textures in it.
+#define TEXTURE_PACKER_VERSION 1
+
+typedef struct TexturePlacement
+{
+    u32 layer;
+    u32 x;
+    u32 y;
+    bool fillsLayer;
+} TexturePlacement;
+
+static const u8* getMipLevel(const TextureAsset& texture, u32 level)
+{
+    if (!texture.mipOffsets.empty())
+        return texture.pixelData + texture.mipOffsets[level];
+
+    const u8* data = texture.pixelData;
+    for (u32 i = 0; i < level; i++)
+        data += TextureCache::GetMipSize(texture.format, texture.width, texture.height, i);
+    return data;
+}
+
+// 0 when any of the textures has no hash of its own.
+static u64 getPackedContentHash(const std::vector<const TextureAsset*>& textures)
+{
+    std::vector<u64> hashes;
+    for (const TextureAsset* texture : textures)
+    {
+        if (texture->contentHash == 0)
+            return 0;
+        hashes.push_back(texture->contentHash);
+    }
+    return Hash64(hashes.data(), hashes.size() * sizeof(u64), TEXTURE_PACKER_VERSION);
+}
+
+// Copies the texture's base level into the layer, repeating its edges out to
+// the rectangle around it or, when it has the layer to itself, over the rest
+// of the layer.
+static void placeTexture(const TextureAsset& texture, const TexturePlacement& placement, u32 layerWidth, u32 layerHeight, u8* layer)
+{
+    i64 left = placement.fillsLayer ? 0 : static_cast<i64>(placement.x) - TEXTURE_ATLAS_PADDING;
+    i64 top = placement.fillsLayer ? 0 : static_cast<i64>(placement.y) - TEXTURE_ATLAS_PADDING;
+    i64 right = placement.fillsLayer ? layerWidth : static_cast<i64>(placement.x) + texture.width + TEXTURE_ATLAS_PADDING;
+    i64 bottom = placement.fillsLayer ? layerHeight : static_cast<i64>(placement.y) + texture.height + TEXTURE_ATLAS_PADDING;
+
+    const u8* pixels = texture.pixelData;
+    for (i64 y = top; y < bottom; y++)
+    {
+        i64 sourceY = std::min(std::max(y - static_cast<i64>(placement.y), static_cast<i64>(0)), static_cast<i64>(texture.height) - 1);
+        const u8* row = pixels + static_cast<size_t>(sourceY) * texture.width * 4;
+        u8* destination = layer + (static_cast<size_t>(y) * layerWidth + left) * 4;
+        for (i64 x = left; x < right; x++, destination += 4)
+        {
+            i64 sourceX = std::min(std::max(x - static_cast<i64>(placement.x), static_cast<i64>(0)), static_cast<i64>(texture.width) - 1);
+            memcpy(destination, row + sourceX * 4, 4);
+        }
+    }
+}
+
+static std::unique_ptr<PackedTextures> stackTextures(const std::vector<const TextureAsset*>& textures)
+{
+    const TextureAsset& first = *textures[0];
+    std::unique_ptr<PackedTextures> packed = std::make_unique<PackedTextures>();
+    TextureAsset& array = *(packed->texture = std::make_unique<TextureAsset>());
+    array.format = first.format;
+    array.width = first.width;
+    array.height = first.height;
+    array.mipCount = first.mipCount;
+    array.layerCount = static_cast<u32>(textures.size());
+
+    for (u32 level = 0; level < array.mipCount; level++)
+    {
+        size_t size = static_cast<size_t>(TextureCache::GetMipSize(array.format, array.width, array.height, level));
+        array.mipOffsets.push_back(array.pixels.size());
+        for (const TextureAsset* texture : textures)
+        {
+            const u8* data = getMipLevel(*texture, level);
+            array.pixels.insert(array.pixels.end(), data, data + size);
+        }
+    }
+    array.pixelData = array.pixels.data();
+    array.pixelSize = array.pixels.size();
+    array.contentHash = getPackedContentHash(textures);
+
+    for (u32 i = 0; i < array.layerCount; i++)
+        packed->regions.push_back({ { 0.0f, 0.0f }, { 1.0f, 1.0f }, i });
+    return packed;
+}
+
+std::unique_ptr<PackedTextures> PackTextures(ThreadPool& pool, const std::vector<const TextureAsset*>& textures)
+{
+    if (textures.empty())
+        throw std::runtime_error("No textures to pack");
+
+    bool sameLayout = true;
+    u32 layerWidth = 0, layerHeight = 0;
+    for (const TextureAsset* texture : textures)
+    {
+        if (!texture->pixelData)
+            throw std::runtime_error("Staged textures can't be packed");
+        sameLayout = sameLayout && texture->format == textures[0]->format && texture->width == textures[0]->width &&
+            texture->height == textures[0]->height && texture->mipCount == textures[0]->mipCount;
+        layerWidth = std::max(layerWidth, texture->width);
+        layerHeight = std::max(layerHeight, texture->height);
+    }
+
+    if (sameLayout)
+        return stackTextures(textures);
+
+    for (const TextureAsset* texture : textures)
+        if (texture->format != VK_FORMAT_R8G8B8A8_SRGB)
+            throw std::runtime_error("Only RGBA8 textures of different sizes can be packed together");
+
+    // Textures too large to leave room for their padding take a whole layer,
+    // the rest go on shelves, tallest first.
+    std::vector<TexturePlacement> placements(textures.size());
+    std::vector<u32> atlased;
+    u32 layerCount = 0;
+    for (u32 i = 0; i < textures.size(); i++)
+    {
+        if (textures[i]->width + 2 * TEXTURE_ATLAS_PADDING > layerWidth || textures[i]->height + 2 * TEXTURE_ATLAS_PADDING > layerHeight)
+            placements[i] = { layerCount++, 0, 0, true };
+        else
+            atlased.push_back(i);
+    }
+    std::stable_sort(atlased.begin(), atlased.end(), [&textures](u32 a, u32 b) { return textures[a]->height > textures[b]->height; });
+
+    u32 shelfX = 0, shelfY = 0, shelfHeight = 0;
+    bool open = false;
+    for (u32 i : atlased)
+    {
+        u32 width = textures[i]->width + 2 * TEXTURE_ATLAS_PADDING;
+        u32 height = textures[i]->height + 2 * TEXTURE_ATLAS_PADDING;
+        if (open && shelfX + width > layerWidth)
+        {
+            shelfY += shelfHeight;
+            shelfX = 0;
+            shelfHeight = 0;
+        }
+        if (!open || shelfY + height > layerHeight)
+        {
+            layerCount++;
+            shelfX = shelfY = shelfHeight = 0;
+            open = true;
+        }
+        placements[i] = { layerCount - 1, shelfX + TEXTURE_ATLAS_PADDING, shelfY + TEXTURE_ATLAS_PADDING, false };
+        shelfX += width;
+        shelfHeight = std::max(shelfHeight, height);
+    }
+
+    // A texture that is exactly a layer and has its chain already is copied
+    // as it is, every other layer is composed and filtered down.
+    u32 mipCount = GetMipCount(layerWidth, layerHeight);
+    std::vector<const TextureAsset*> wholeLayers(layerCount, nullptr);
+    for (u32 i = 0; i < textures.size(); i++)
+        if (placements[i].fillsLayer && textures[i]->width == layerWidth && textures[i]->height == layerHeight && textures[i]->mipCount == mipCount)
+            wholeLayers[placements[i].layer] = textures[i];
+
+    size_t layerSize = static_cast<size_t>(layerWidth) * layerHeight * 4;
+    std::vector<std::vector<u8>> bases(layerCount);
+    for (u32 layer = 0; layer < layerCount; layer++)
+        if (!wholeLayers[layer])
+            bases[layer].assign(layerSize, 0);
+
+    pool.ParallelFor(static_cast<u32>(textures.size()), [&](u32 i)
+    {
+        const TexturePlacement& placement = placements[i];
+        if (!wholeLayers[placement.layer])
+            placeTexture(*textures[i], placement, layerWidth, layerHeight, bases[placement.layer].data());
+    });
+
+    std::vector<std::vector<u8>> chains(layerCount);
+    for (u32 layer = 0; layer < layerCount; layer++)
+    {
+        if (wholeLayers[layer])
+            continue;
+        BuildMipChain(pool, bases[layer].data(), layerWidth, layerHeight, mipCount, chains[layer]);
+        bases[layer] = std::vector<u8>();
+    }
+
+    std::unique_ptr<PackedTextures> packed = std::make_unique<PackedTextures>();
+    TextureAsset& array = *(packed->texture = std::make_unique<TextureAsset>());
+    array.format = VK_FORMAT_R8G8B8A8_SRGB;
+    array.width = layerWidth;
+    array.height = layerHeight;
+    array.mipCount = mipCount;
+    array.layerCount = layerCount;
+
+    size_t chainOffset = 0;
+    for (u32 level = 0; level < mipCount; level++)
+    {
+        size_t size = static_cast<size_t>(TextureCache::GetMipSize(array.format, layerWidth, layerHeight, level));
+        array.mipOffsets.push_back(array.pixels.size());
+        for (u32 layer = 0; layer < layerCount; layer++)
+        {
+            const u8* data = wholeLayers[layer] ? getMipLevel(*wholeLayers[layer], level) : chains[layer].data() + chainOffset;
+            array.pixels.insert(array.pixels.end(), data, data + size);
+        }
+        chainOffset += size;
+    }
+    array.pixelData = array.pixels.data();
+    array.pixelSize = array.pixels.size();
+    array.contentHash = getPackedContentHash(textures);
+
+    for (u32 i = 0; i < textures.size(); i++)
+    {
+        const TexturePlacement& placement = placements[i];
+        packed->regions.push_back({
+            { static_cast<float>(placement.x) / layerWidth, static_cast<float>(placement.y) / layerHeight },
+            { static_cast<float>(textures[i]->width) / layerWidth, static_cast<float>(textures[i]->height) / layerHeight },
+            placement.layer });
+    }
+    return packed;
+}
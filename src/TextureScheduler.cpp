@@ -0,0 +1,81 @@
+#include <iostream>
+
+#include <TextureScheduler.hpp>
+
+void TextureScheduler::Create(ThreadPool& pool, AsyncIo& io, const StagingAllocator& staging)
+{
+    m_pool = &pool;
+    m_io = &io;
+    m_staging = staging;
+}
+
+void TextureScheduler::Load(const std::string& path, bool preferCooked, bool buildMips, VkFormat format, bool staged)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    if (m_pending.empty())
+    {
+        m_batchStart = start;
+        m_batchSize = 0;
+        m_batchLoadMilliseconds = 0.0;
+    }
+    m_batchSize++;
+
+    m_pending.push_back({ path, staged ? LoadTextureAsync(*m_pool, *m_io, path, m_staging, preferCooked, buildMips, format) :
+        LoadTextureAsync(*m_pool, path, preferCooked, buildMips, format), start });
+}
+
+bool TextureScheduler::IsLoading(const std::string& path) const
+{
+    for (const PendingTexture& pending : m_pending)
+        if (pending.path == path)
+            return true;
+    return false;
+}
+
+u32 TextureScheduler::GetPendingCount() const
+{
+    return static_cast<u32>(m_pending.size());
+}
+
+void TextureScheduler::Poll(std::vector<ScheduledTexture>& finished)
+{
+    if (m_pending.empty())
+        return;
+
+    auto now = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < m_pending.size();)
+    {
+        PendingTexture& pending = m_pending[i];
+        if (!pending.handle.IsReady())
+        {
+            i++;
+            continue;
+        }
+
+        ScheduledTexture result{ pending.path, nullptr, 0.0, std::chrono::duration<double, std::milli>(now - pending.start).count() };
+        try
+        {
+            result.texture = pending.handle.Take();
+            result.loadMilliseconds = result.texture->loadMilliseconds;
+            m_batchLoadMilliseconds += result.loadMilliseconds;
+            std::cout << "Loaded texture " << result.path << " (" << result.texture->width << "x" << result.texture->height
+                << ", " << result.texture->mipCount << " levels) in " << result.loadMilliseconds << " ms, "
+                << result.totalMilliseconds << " ms after it was requested" << std::endl;
+        }
+        catch (const std::exception& exception)
+        {
+            std::cerr << exception.what() << std::endl;
+        }
+        finished.push_back(std::move(result));
+
+        m_pending[i] = std::move(m_pending.back());
+        m_pending.pop_back();
+    }
+
+    // The sum of the loads against the batch's wall time shows how well they
+    // overlapped.
+    if (m_pending.empty() && m_batchSize > 1)
+        std::cout << "Loaded " << m_batchSize << " textures in "
+            << std::chrono::duration<double, std::milli>(now - m_batchStart).count() << " ms, "
+            << m_batchLoadMilliseconds << " ms of loading" << std::endl;
+}
@@ -0,0 +1,123 @@
+#include <algorithm>
+
+#include <TextureCache.hpp>
+#include <TextureStreamer.hpp>
+
+static u32 getTailLevel(u32 width, u32 height, u32 mipCount)
+{
+    u32 level = 0;
+    while (level + 1 < mipCount && std::max(width >> level, height >> level) > TEXTURE_STREAMING_TAIL_SIZE)
+        level++;
+    return level;
+}
+
+bool TextureStreamer::IsStreamable(u32 width, u32 height, u32 mipCount)
+{
+    return getTailLevel(width, height, mipCount) > 0;
+}
+
+u32 TextureStreamer::Add(VkFormat format, u32 width, u32 height, u32 mipCount, u32 layerCount)
+{
+    StreamedTexture texture{};
+    texture.used = true;
+    texture.tailLevel = getTailLevel(width, height, mipCount);
+    texture.wantedLevel = texture.firstLevel = texture.residentLevel = texture.tailLevel;
+    for (u32 level = 0; level < mipCount; level++)
+        texture.levelSizes.push_back(TextureCache::GetMipSize(format, width, height, level) * layerCount);
+    m_usedBytes += getSize(texture, texture.firstLevel);
+
+    if (m_freeTextures.empty())
+    {
+        m_textures.push_back(std::move(texture));
+        return static_cast<u32>(m_textures.size() - 1);
+    }
+    u32 id = m_freeTextures.back();
+    m_freeTextures.pop_back();
+    m_textures[id] = std::move(texture);
+    return id;
+}
+
+void TextureStreamer::Remove(u32 texture)
+{
+    m_usedBytes -= getSize(m_textures[texture], m_textures[texture].firstLevel);
+    m_textures[texture] = StreamedTexture{};
+    m_freeTextures.push_back(texture);
+}
+
+u32 TextureStreamer::GetFirstLevel(u32 texture) const
+{
+    return m_textures[texture].firstLevel;
+}
+
+u64 TextureStreamer::GetUsedBytes() const
+{
+    return m_usedBytes;
+}
+
+void TextureStreamer::Request(u32 texture, u32 level, float coverage)
+{
+    StreamedTexture& streamed = m_textures[texture];
+    streamed.wantedLevel = std::min(level, streamed.tailLevel);
+    streamed.coverage = coverage;
+}
+
+// Tails are always in, even past the budget. What is left goes to the wanted
+// levels first and to keeping levels no longer wanted after that, each time
+// in order of coverage.
+void TextureStreamer::Update(std::vector<TextureStreamingUpdate>& updates)
+{
+    std::vector<u32> order;
+    u64 used = 0;
+    for (u32 i = 0; i < m_textures.size(); i++)
+    {
+        if (!m_textures[i].used)
+            continue;
+        order.push_back(i);
+        used += getSize(m_textures[i], m_textures[i].tailLevel);
+    }
+    std::stable_sort(order.begin(), order.end(), [this](u32 a, u32 b) { return m_textures[a].coverage > m_textures[b].coverage; });
+
+    std::vector<u32> targets(m_textures.size());
+    for (u32 i : order)
+    {
+        const StreamedTexture& texture = m_textures[i];
+        u32 level = texture.tailLevel;
+        while (level > texture.wantedLevel && used + texture.levelSizes[level - 1] <= TEXTURE_MEMORY_BUDGET)
+            used += texture.levelSizes[--level];
+        targets[i] = level;
+    }
+    for (u32 i : order)
+    {
+        const StreamedTexture& texture = m_textures[i];
+        while (targets[i] > texture.firstLevel && used + texture.levelSizes[targets[i] - 1] <= TEXTURE_MEMORY_BUDGET)
+            used += texture.levelSizes[--targets[i]];
+    }
+
+    // Evicted levels go at once, finer ones come in a level per texture.
+    u64 uploaded = 0;
+    m_usedBytes = used;
+    for (u32 i : order)
+    {
+        StreamedTexture& texture = m_textures[i];
+        bool changed = targets[i] != texture.firstLevel;
+        texture.firstLevel = targets[i];
+        texture.residentLevel = std::max(texture.residentLevel, texture.firstLevel);
+
+        if (texture.residentLevel > texture.firstLevel &&
+            (uploaded == 0 || uploaded + texture.levelSizes[texture.residentLevel - 1] <= TEXTURE_STREAMING_FRAME_BYTES))
+        {
+            uploaded += texture.levelSizes[--texture.residentLevel];
+            changed = true;
+        }
+        if (changed)
+            updates.push_back({ i, texture.firstLevel, texture.residentLevel });
+    }
+}
+
+u64 TextureStreamer::getSize(const StreamedTexture& texture, u32 firstLevel)
+{
+    u64 size = 0;
+    for (u32 level = firstLevel; level < texture.levelSizes.size(); level++)
+        size += texture.levelSizes[level];
+    return size;
+}
@@ -0,0 +1,140 @@
+#include <algorithm>
+
+#include <ThreadPool.hpp>
+
+ThreadPool::~ThreadPool()
+{
+    Destroy();
+}
+
+void ThreadPool::Create(u32 threadCount)
+{
+    Destroy();
+
+    if (threadCount == 0)
+    {
+        u32 hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+
+    m_stopping = false;
+    m_workers.reserve(threadCount);
+    for (u32 i = 0; i < threadCount; i++)
+        m_workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+void ThreadPool::Destroy()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+
+    for (std::thread& worker : m_workers)
+        worker.join();
+    m_workers.clear();
+    m_jobs.clear();
+}
+
+u32 ThreadPool::GetThreadCount() const
+{
+    return static_cast<u32>(m_workers.size());
+}
+
+void ThreadPool::ParallelFor(u32 count, const std::function<void(u32)>& body)
+{
+    if (count == 0)
+        return;
+
+    if (count == 1 || m_workers.empty())
+    {
+        for (u32 i = 0; i < count; i++)
+            body(i);
+        return;
+    }
+
+    struct State
+    {
+        std::atomic<u32> next{ 0 };
+        std::atomic<u32> done{ 0 };
+        u32 count;
+        const std::function<void(u32)>* body;
+        std::exception_ptr exception;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    auto state = std::make_shared<State>();
+    state->count = count;
+    state->body = &body;
+
+    auto run = [state]()
+    {
+        u32 completed = 0;
+        for (u32 i = state->next++; i < state->count; i = state->next++)
+        {
+            try
+            {
+                (*state->body)(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (!state->exception)
+                    state->exception = std::current_exception();
+            }
+            completed++;
+        }
+
+        if (completed && state->done.fetch_add(completed) + completed == state->count)
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->finished.notify_all();
+        }
+    };
+
+    u32 helpers = std::min(count - 1, GetThreadCount());
+    for (u32 i = 0; i < helpers; i++)
+        enqueue(run);
+
+    run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&]() { return state->done.load() == count; });
+
+    if (state->exception)
+        std::rethrow_exception(state->exception);
+}
+
+void ThreadPool::enqueue(std::function<void()> job)
+{
+    if (m_workers.empty())
+    {
+        job();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_condition.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+            if (m_stopping && m_jobs.empty())
+                return;
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        job();
+    }
+}
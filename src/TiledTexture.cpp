@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <TiledTexture.hpp>
+
+#define TILED_TEXTURE_DATA_ALIGNMENT 16
+
+static u32 getPageCount(u32 size, u32 level)
+{
+    return (std::max(size >> level, 1u) + VIRTUAL_PAGE_SIZE - 1) / VIRTUAL_PAGE_SIZE;
+}
+
+u32 TiledTexture::GetLevelCount(u32 width, u32 height)
+{
+    u32 pages = getPageCount(std::max(width, height), 0);
+    u32 levelCount = 1;
+    while ((1u << (levelCount - 1)) < pages)
+        levelCount++;
+    return levelCount;
+}
+
+u32 TiledTexture::GetGridOffset(u32 levelCount, u32 level)
+{
+    u32 offset = 0;
+    u32 gridSize = 1u << (levelCount - 1);
+    for (u32 i = 0; i < level; i++)
+        offset += (gridSize >> i) * (gridSize >> i);
+    return offset;
+}
+
+// Edge texels repeat past the image, at its outer edges and in the border.
+static void cutPage(const u8* level, u32 width, u32 height, u32 pageX, u32 pageY, u8* page)
+{
+    for (u32 y = 0; y < VIRTUAL_PAGE_STRIDE; y++)
+    {
+        i64 sourceY = static_cast<i64>(pageY) * VIRTUAL_PAGE_SIZE + y - VIRTUAL_PAGE_BORDER;
+        sourceY = std::min(std::max(sourceY, static_cast<i64>(0)), static_cast<i64>(height) - 1);
+        const u8* row = level + static_cast<size_t>(sourceY) * width * 4;
+        for (u32 x = 0; x < VIRTUAL_PAGE_STRIDE; x++)
+        {
+            i64 sourceX = static_cast<i64>(pageX) * VIRTUAL_PAGE_SIZE + x - VIRTUAL_PAGE_BORDER;
+            sourceX = std::min(std::max(sourceX, static_cast<i64>(0)), static_cast<i64>(width) - 1);
+            memcpy(page + (static_cast<size_t>(y) * VIRTUAL_PAGE_STRIDE + x) * 4, row + sourceX * 4, 4);
+        }
+    }
+}
+
+bool TiledTexture::Write(ThreadPool& pool, const std::string& path, const AssetDependencies& dependencies,
+    u32 width, u32 height, const u8* chain, u32 mipCount)
+{
+    u32 levelCount = GetLevelCount(width, height);
+    if (levelCount > TILED_TEXTURE_MAX_LEVELS || mipCount < levelCount)
+        return false;
+
+    u32 gridSize = 1u << (levelCount - 1);
+    std::vector<u32> pages(GetGridOffset(levelCount, levelCount), TILED_TEXTURE_NO_PAGE);
+    u32 pageCount = 0;
+    for (u32 level = 0; level < levelCount; level++)
+    {
+        u32* grid = pages.data() + GetGridOffset(levelCount, level);
+        for (u32 y = 0; y < getPageCount(height, level); y++)
+            for (u32 x = 0; x < getPageCount(width, level); x++)
+                grid[y * (gridSize >> level) + x] = pageCount++;
+    }
+
+    TiledTextureHeader header{};
+    header.magic = TILED_TEXTURE_MAGIC;
+    header.version = TILED_TEXTURE_VERSION;
+    header.width = width;
+    header.height = height;
+    header.levelCount = levelCount;
+    header.pageCount = pageCount;
+    header.dependencies = dependencies;
+
+    u64 indexEnd = sizeof(header) + pages.size() * sizeof(u32);
+    header.dataOffset = (indexEnd + TILED_TEXTURE_DATA_ALIGNMENT - 1) / TILED_TEXTURE_DATA_ALIGNMENT * TILED_TEXTURE_DATA_ALIGNMENT;
+
+    std::string tempPath = path + ".tmp";
+
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    const char padding[TILED_TEXTURE_DATA_ALIGNMENT] = {};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(pages.data()), pages.size() * sizeof(u32));
+    file.write(padding, static_cast<std::streamsize>(header.dataOffset - indexEnd));
+
+    std::vector<u8> levelPages;
+    const u8* level = chain;
+    for (u32 i = 0; i < levelCount && file; i++)
+    {
+        u32 levelWidth = std::max(width >> i, 1u), levelHeight = std::max(height >> i, 1u);
+        u32 columns = getPageCount(width, i);
+        u32 count = columns * getPageCount(height, i);
+        levelPages.resize(static_cast<size_t>(count) * VIRTUAL_PAGE_BYTES);
+        pool.ParallelFor(count, [&](u32 page)
+        {
+            cutPage(level, levelWidth, levelHeight, page % columns, page / columns, levelPages.data() + static_cast<size_t>(page) * VIRTUAL_PAGE_BYTES);
+        });
+
+        file.write(reinterpret_cast<const char*>(levelPages.data()), levelPages.size());
+        level += static_cast<size_t>(levelWidth) * levelHeight * 4;
+    }
+    file.close();
+
+    std::remove(path.c_str());
+    if (!file || std::rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool TiledTexture::Open(const std::string& path)
+{
+    Close();
+
+    if (!m_file.Open(path) || m_file.GetSize() < sizeof(TiledTextureHeader))
+    {
+        Close();
+        return false;
+    }
+
+    const TiledTextureHeader* header = reinterpret_cast<const TiledTextureHeader*>(m_file.GetData());
+    bool valid = header->magic == TILED_TEXTURE_MAGIC &&
+        header->version == TILED_TEXTURE_VERSION &&
+        header->dependencies.count <= MAX_ASSET_DEPENDENCIES &&
+        header->width > 0 && header->height > 0 &&
+        header->levelCount == GetLevelCount(header->width, header->height) &&
+        header->levelCount <= TILED_TEXTURE_MAX_LEVELS;
+
+    u64 cellCount = valid ? GetGridOffset(header->levelCount, header->levelCount) : 0;
+    valid = valid && header->dataOffset >= sizeof(TiledTextureHeader) + cellCount * sizeof(u32) &&
+        m_file.GetSize() == header->dataOffset + static_cast<u64>(header->pageCount) * VIRTUAL_PAGE_BYTES;
+    if (!valid)
+    {
+        Close();
+        return false;
+    }
+
+    m_header = header;
+    m_pages = reinterpret_cast<const u32*>(m_file.GetData() + sizeof(TiledTextureHeader));
+    m_path = path;
+    return true;
+}
+
+void TiledTexture::Close()
+{
+    m_file.Close();
+    m_path.clear();
+    m_header = nullptr;
+    m_pages = nullptr;
+}
+
+const std::string& TiledTexture::GetPath() const
+{
+    return m_path;
+}
+
+const AssetDependencies& TiledTexture::GetDependencies() const
+{
+    static const AssetDependencies none{};
+    return m_header ? m_header->dependencies : none;
+}
+
+u32 TiledTexture::GetWidth() const
+{
+    return m_header ? m_header->width : 0;
+}
+
+u32 TiledTexture::GetHeight() const
+{
+    return m_header ? m_header->height : 0;
+}
+
+u32 TiledTexture::GetLevelCount() const
+{
+    return m_header ? m_header->levelCount : 0;
+}
+
+u32 TiledTexture::GetGridSize() const
+{
+    return m_header ? 1u << (m_header->levelCount - 1) : 0;
+}
+
+u64 TiledTexture::GetPageOffset(u32 level, u32 x, u32 y) const
+{
+    u32 gridSize = GetGridSize() >> level;
+    if (!m_header || level >= m_header->levelCount || x >= gridSize || y >= gridSize)
+        return 0;
+
+    u32 page = m_pages[GetGridOffset(m_header->levelCount, level) + y * gridSize + x];
+    if (page >= m_header->pageCount)
+        return 0;
+    return m_header->dataOffset + static_cast<u64>(page) * VIRTUAL_PAGE_BYTES;
+}
+
+const u8* TiledTexture::GetFileData() const
+{
+    return reinterpret_cast<const u8*>(m_file.GetData());
+}
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include <glm/gtc/packing.hpp>
+
+#include <VertexPacking.hpp>
+
+static inline u16 quantizeUnorm16(float value, float offset, float scale)
+{
+    float normalized = scale > 0.0f ? (value - offset) / scale : 0.0f;
+    return static_cast<u16>(glm::clamp(normalized, 0.0f, 1.0f) * 65535.0f + 0.5f);
+}
+
+static inline float dequantizeUnorm16(u16 value, float offset, float scale)
+{
+    return offset + scale * (static_cast<float>(value) / 65535.0f);
+}
+
+static inline bool isUnorm8(float value)
+{
+    return value >= 0.0f && value <= 1.0f && std::round(value * 255.0f) / 255.0f == value;
+}
+
+static u32 formatSize(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_R32G32B32_SFLOAT: return 12;
+    case VK_FORMAT_R32G32_SFLOAT: return 8;
+    case VK_FORMAT_R16G16B16A16_UNORM: return 8;
+    case VK_FORMAT_R16G16_SFLOAT: return 4;
+    case VK_FORMAT_R8G8B8A8_UNORM: return 4;
+    default: throw std::runtime_error("Unsupported vertex attribute format");
+    }
+}
+
+VertexLayout GetFullPrecisionLayout()
+{
+    VertexLayout layout{};
+    layout.positionFormat = VK_FORMAT_R32G32B32_SFLOAT;
+    layout.colorFormat = VK_FORMAT_R32G32B32_SFLOAT;
+    layout.texCoordFormat = VK_FORMAT_R32G32_SFLOAT;
+    layout.positionOffset = offsetof(Vertex, pos);
+    layout.colorOffset = offsetof(Vertex, color);
+    layout.texCoordOffset = offsetof(Vertex, texCoord);
+    layout.stride = sizeof(Vertex);
+    layout.constantColor = false;
+    layout.dequantizeOffset = glm::vec3(0.0f);
+    layout.dequantizeScale = glm::vec3(1.0f);
+    layout.indexType = VK_INDEX_TYPE_UINT32;
+    return layout;
+}
+
+VertexLayout ChooseVertexLayout(const Vertex* vertices, size_t vertexCount, size_t indexedVertexCount, const VertexPackingOptions& options)
+{
+    return ChooseVertexLayout([vertices](u32 i) { return vertices[i]; }, vertexCount, indexedVertexCount, options);
+}
+
+VertexLayout ChooseVertexLayout(const std::function<Vertex(u32)>& fetch, size_t vertexCount, size_t indexedVertexCount, const VertexPackingOptions& options)
+{
+    VertexLayout layout = GetFullPrecisionLayout();
+    if (vertexCount == 0)
+        return layout;
+
+    Vertex first = fetch(0);
+    glm::vec3 minimum = first.pos, maximum = first.pos;
+    bool constantColor = true;
+    for (u32 i = 0; i < vertexCount; i++)
+    {
+        Vertex vertex = fetch(i);
+        minimum = glm::min(minimum, vertex.pos);
+        maximum = glm::max(maximum, vertex.pos);
+        constantColor = constantColor && vertex.color == first.color;
+    }
+
+    if (options.allowUnorm16Positions)
+    {
+        glm::vec3 extent = maximum - minimum;
+        float error = 0.0f;
+        for (u32 i = 0; i < vertexCount; i++)
+        {
+            glm::vec3 position = fetch(i).pos;
+            for (int c = 0; c < 3; c++)
+            {
+                float value = position[c];
+                float restored = dequantizeUnorm16(quantizeUnorm16(value, minimum[c], extent[c]), minimum[c], extent[c]);
+                error = std::max(error, std::abs(restored - value));
+            }
+        }
+
+        if (error <= options.maxPositionError * glm::length(extent))
+        {
+            layout.positionFormat = VK_FORMAT_R16G16B16A16_UNORM;
+            layout.dequantizeOffset = minimum;
+            layout.dequantizeScale = extent;
+            layout.positionError = error;
+        }
+    }
+
+    if (options.allowHalfTexCoords)
+    {
+        float error = 0.0f;
+        for (u32 i = 0; i < vertexCount; i++)
+        {
+            glm::vec2 texCoord = fetch(i).texCoord;
+            for (int c = 0; c < 2; c++)
+            {
+                float value = texCoord[c];
+                error = std::max(error, std::abs(glm::unpackHalf1x16(glm::packHalf1x16(value)) - value));
+            }
+        }
+
+        if (error <= options.maxTexCoordError)
+        {
+            layout.texCoordFormat = VK_FORMAT_R16G16_SFLOAT;
+            layout.texCoordError = error;
+        }
+    }
+
+    if (constantColor)
+    {
+        const glm::vec3& color = first.color;
+        layout.constantColor = true;
+        layout.colorFormat = isUnorm8(color.r) && isUnorm8(color.g) && isUnorm8(color.b)
+            ? VK_FORMAT_R8G8B8A8_UNORM
+            : VK_FORMAT_R32G32B32_SFLOAT;
+    }
+
+    layout.positionOffset = 0;
+    layout.stride = formatSize(layout.positionFormat);
+    if (!layout.constantColor)
+    {
+        layout.colorOffset = layout.stride;
+        layout.stride += formatSize(layout.colorFormat);
+    }
+    layout.texCoordOffset = layout.stride;
+    layout.stride += formatSize(layout.texCoordFormat);
+
+    layout.indexType = indexedVertexCount <= 0x10000 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    return layout;
+}
+
+size_t GetConstantColorOffset(const VertexLayout& layout, size_t vertexCount)
+{
+    return (layout.stride * vertexCount + 3) & ~size_t(3);
+}
+
+size_t GetPackedVertexSize(const VertexLayout& layout, size_t vertexCount)
+{
+    if (!layout.constantColor)
+        return layout.stride * vertexCount;
+    return GetConstantColorOffset(layout, vertexCount) + formatSize(layout.colorFormat);
+}
+
+size_t GetPackedIndexSize(const VertexLayout& layout, size_t indexCount)
+{
+    return indexCount * (layout.indexType == VK_INDEX_TYPE_UINT16 ? sizeof(u16) : sizeof(u32));
+}
+
+static void packColor(VkFormat format, const glm::vec3& color, char* destination)
+{
+    if (format == VK_FORMAT_R8G8B8A8_UNORM)
+    {
+        u8 packed[4] =
+        {
+            static_cast<u8>(color.r * 255.0f + 0.5f),
+            static_cast<u8>(color.g * 255.0f + 0.5f),
+            static_cast<u8>(color.b * 255.0f + 0.5f),
+            255
+        };
+        memcpy(destination, packed, sizeof(packed));
+    }
+    else
+    {
+        memcpy(destination, &color, sizeof(color));
+    }
+}
+
+void PackVertices(const VertexLayout& layout, const Vertex* vertices, size_t vertexCount, void* destination)
+{
+    PackVertices(layout, [vertices](u32 i) { return vertices[i]; }, vertexCount, destination);
+}
+
+void PackVertices(const VertexLayout& layout, const std::function<Vertex(u32)>& fetch, size_t vertexCount, void* destination)
+{
+    char* output = static_cast<char*>(destination);
+
+    for (u32 i = 0; i < vertexCount; i++, output += layout.stride)
+    {
+        Vertex vertex = fetch(i);
+
+        if (layout.positionFormat == VK_FORMAT_R16G16B16A16_UNORM)
+        {
+            u16 position[4] =
+            {
+                quantizeUnorm16(vertex.pos.x, layout.dequantizeOffset.x, layout.dequantizeScale.x),
+                quantizeUnorm16(vertex.pos.y, layout.dequantizeOffset.y, layout.dequantizeScale.y),
+                quantizeUnorm16(vertex.pos.z, layout.dequantizeOffset.z, layout.dequantizeScale.z),
+                0
+            };
+            memcpy(output + layout.positionOffset, position, sizeof(position));
+        }
+        else
+        {
+            memcpy(output + layout.positionOffset, &vertex.pos, sizeof(vertex.pos));
+        }
+
+        if (!layout.constantColor)
+            packColor(layout.colorFormat, vertex.color, output + layout.colorOffset);
+
+        if (layout.texCoordFormat == VK_FORMAT_R16G16_SFLOAT)
+        {
+            u16 texCoord[2] = { glm::packHalf1x16(vertex.texCoord.x), glm::packHalf1x16(vertex.texCoord.y) };
+            memcpy(output + layout.texCoordOffset, texCoord, sizeof(texCoord));
+        }
+        else
+        {
+            memcpy(output + layout.texCoordOffset, &vertex.texCoord, sizeof(vertex.texCoord));
+        }
+    }
+
+    if (layout.constantColor && vertexCount > 0)
+        packColor(layout.colorFormat, fetch(0).color, static_cast<char*>(destination) + GetConstantColorOffset(layout, vertexCount));
+}
+
+void PackIndices(const VertexLayout& layout, const u32* indices, size_t indexCount, void* destination)
+{
+    if (layout.indexType == VK_INDEX_TYPE_UINT32)
+    {
+        memcpy(destination, indices, indexCount * sizeof(u32));
+        return;
+    }
+
+    u16* output = static_cast<u16*>(destination);
+    for (size_t i = 0; i < indexCount; i++)
+        output[i] = static_cast<u16>(indices[i]);
+}
+
+glm::mat4 GetDequantizeMatrix(const VertexLayout& layout)
+{
+    glm::mat4 dequantize = glm::translate(glm::mat4(1.0f), layout.dequantizeOffset);
+    return glm::scale(dequantize, layout.dequantizeScale);
+}
@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <cstring>
+
+#include <MyUtils.hpp>
+#include <VertexWelder.hpp>
+
+#define WELD_EMPTY_SLOT 0xFFFFFFFF
+#define WELD_SHARD_BITS 6
+#define WELD_BLOCK_SIZE 65536
+
+static inline u64 hashVertex(const Vertex& vertex)
+{
+    return Hash64(&vertex, sizeof(Vertex));
+}
+
+static inline bool sameVertex(const Vertex& a, const Vertex& b)
+{
+    return memcmp(&a, &b, sizeof(Vertex)) == 0;
+}
+
+static size_t slotCountFor(size_t vertexCount)
+{
+    size_t slotCount = 16;
+    while (slotCount < vertexCount * 2)
+        slotCount *= 2;
+    return slotCount;
+}
+
+void VertexWelder::Reserve(size_t expectedVertexCount)
+{
+    m_vertices.reserve(expectedVertexCount);
+    if (slotCountFor(expectedVertexCount) > m_slots.size())
+        rehash(slotCountFor(expectedVertexCount));
+}
+
+u32 VertexWelder::Insert(const Vertex& vertex)
+{
+    if (m_vertices.size() * 2 >= m_slots.size())
+        rehash(slotCountFor(m_vertices.size() + 1));
+
+    u64 hash = hashVertex(vertex);
+    u32 tag = static_cast<u32>(hash >> 32);
+
+    for (u32 slot = static_cast<u32>(hash) & m_mask;; slot = (slot + 1) & m_mask)
+    {
+        Slot& entry = m_slots[slot];
+        if (entry.index == WELD_EMPTY_SLOT)
+        {
+            entry.tag = tag;
+            entry.index = static_cast<u32>(m_vertices.size());
+            m_vertices.push_back(vertex);
+            return entry.index;
+        }
+        if (entry.tag == tag && sameVertex(m_vertices[entry.index], vertex))
+            return entry.index;
+    }
+}
+
+std::vector<Vertex>& VertexWelder::GetVertices()
+{
+    return m_vertices;
+}
+
+void VertexWelder::rehash(size_t slotCount)
+{
+    m_slots.assign(slotCount, { 0, WELD_EMPTY_SLOT });
+    m_mask = static_cast<u32>(slotCount - 1);
+
+    for (u32 i = 0; i < m_vertices.size(); i++)
+    {
+        u64 hash = hashVertex(m_vertices[i]);
+        u32 slot = static_cast<u32>(hash) & m_mask;
+        while (m_slots[slot].index != WELD_EMPTY_SLOT)
+            slot = (slot + 1) & m_mask;
+        m_slots[slot] = { static_cast<u32>(hash >> 32), i };
+    }
+}
+
+void VertexWelder::WeldParallel(ThreadPool& pool, u32 count,
+    const std::function<Vertex(u32)>& fetch,
+    std::vector<Vertex>& vertices, std::vector<u32>& indices)
+{
+    const u32 shardCount = 1 << WELD_SHARD_BITS;
+    const u32 blockCount = (count + WELD_BLOCK_SIZE - 1) / WELD_BLOCK_SIZE;
+
+    std::vector<u64> hashes(count);
+    std::vector<u32> blockShardCounts(static_cast<size_t>(blockCount) * shardCount, 0);
+
+    pool.ParallelFor(blockCount, [&](u32 block)
+    {
+        u32* counts = &blockShardCounts[static_cast<size_t>(block) * shardCount];
+        u32 end = std::min(count, (block + 1) * WELD_BLOCK_SIZE);
+        for (u32 i = block * WELD_BLOCK_SIZE; i < end; i++)
+        {
+            hashes[i] = hashVertex(fetch(i));
+            counts[hashes[i] >> (64 - WELD_SHARD_BITS)]++;
+        }
+    });
+
+    // Counting sort of the vertex ids by shard. Blocks are laid out in order so
+    // every shard sees its ids in increasing order.
+    std::vector<u32> shardBegin(shardCount + 1, 0);
+    std::vector<u32> blockShardOffsets(blockShardCounts.size());
+    u32 offset = 0;
+    for (u32 shard = 0; shard < shardCount; shard++)
+    {
+        shardBegin[shard] = offset;
+        for (u32 block = 0; block < blockCount; block++)
+        {
+            size_t cell = static_cast<size_t>(block) * shardCount + shard;
+            blockShardOffsets[cell] = offset;
+            offset += blockShardCounts[cell];
+        }
+    }
+    shardBegin[shardCount] = offset;
+
+    std::vector<u32> order(count);
+    pool.ParallelFor(blockCount, [&](u32 block)
+    {
+        u32* offsets = &blockShardOffsets[static_cast<size_t>(block) * shardCount];
+        u32 end = std::min(count, (block + 1) * WELD_BLOCK_SIZE);
+        for (u32 i = block * WELD_BLOCK_SIZE; i < end; i++)
+            order[offsets[hashes[i] >> (64 - WELD_SHARD_BITS)]++] = i;
+    });
+
+    // Each shard finds the first occurrence of every vertex it owns.
+    std::vector<u32> first(count);
+    pool.ParallelFor(shardCount, [&](u32 shard)
+    {
+        u32 begin = shardBegin[shard], end = shardBegin[shard + 1];
+        std::vector<Slot> slots(slotCountFor(end - begin), { 0, WELD_EMPTY_SLOT });
+        u32 mask = static_cast<u32>(slots.size() - 1);
+
+        for (u32 k = begin; k < end; k++)
+        {
+            u32 id = order[k];
+            u32 tag = static_cast<u32>(hashes[id] >> 32);
+            Vertex vertex = fetch(id);
+
+            for (u32 slot = static_cast<u32>(hashes[id]) & mask;; slot = (slot + 1) & mask)
+            {
+                Slot& entry = slots[slot];
+                if (entry.index == WELD_EMPTY_SLOT)
+                {
+                    entry = { tag, id };
+                    first[id] = id;
+                    break;
+                }
+                if (entry.tag == tag && sameVertex(fetch(entry.index), vertex))
+                {
+                    first[id] = entry.index;
+                    break;
+                }
+            }
+        }
+    });
+
+    // Number the first occurrences in id order, then resolve every index.
+    std::vector<u32> blockVertexBase(blockCount + 1, 0);
+    pool.ParallelFor(blockCount, [&](u32 block)
+    {
+        u32 end = std::min(count, (block + 1) * WELD_BLOCK_SIZE);
+        u32 unique = 0;
+        for (u32 i = block * WELD_BLOCK_SIZE; i < end; i++)
+            unique += first[i] == i;
+        blockVertexBase[block + 1] = unique;
+    });
+    for (u32 block = 0; block < blockCount; block++)
+        blockVertexBase[block + 1] += blockVertexBase[block];
+
+    vertices.resize(blockVertexBase[blockCount]);
+    indices.resize(count);
+
+    pool.ParallelFor(blockCount, [&](u32 block)
+    {
+        u32 end = std::min(count, (block + 1) * WELD_BLOCK_SIZE);
+        u32 next = blockVertexBase[block];
+        for (u32 i = block * WELD_BLOCK_SIZE; i < end; i++)
+        {
+            if (first[i] == i)
+            {
+                vertices[next] = fetch(i);
+                indices[i] = next++;
+            }
+        }
+    });
+
+    pool.ParallelFor(blockCount, [&](u32 block)
+    {
+        u32 end = std::min(count, (block + 1) * WELD_BLOCK_SIZE);
+        for (u32 i = block * WELD_BLOCK_SIZE; i < end; i++)
+            if (first[i] != i)
+                indices[i] = indices[first[i]];
+    });
+}
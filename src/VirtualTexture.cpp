@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#include <AssetArchive.hpp>
+#include <VirtualTexture.hpp>
+
+#define VIRTUAL_SLOT_NONE 0xFFFFFFFF
+
+static u32 getPageLevel(u32 key)
+{
+    return key >> 28;
+}
+
+static u32 getPageX(u32 key)
+{
+    return key & 0x3FFF;
+}
+
+static u32 getPageY(u32 key)
+{
+    return (key >> 14) & 0x3FFF;
+}
+
+bool VirtualTexture::Open(const std::string& path)
+{
+    m_archived = IsArchivedFile(path);
+    return m_file.Open(path);
+}
+
+void VirtualTexture::Create(ThreadPool& pool, AsyncIo& io, u8* uploadMemory, u32 cacheSize)
+{
+    m_pool = &pool;
+    m_io = &io;
+    m_uploadMemory = uploadMemory;
+    m_cacheSize = cacheSize;
+    m_gridSize = m_file.GetGridSize();
+    m_levelCount = m_file.GetLevelCount();
+
+    m_levelOffsets.clear();
+    for (u32 level = 0; level <= m_levelCount; level++)
+        m_levelOffsets.push_back(TiledTexture::GetGridOffset(m_levelCount, level));
+
+    m_pageSlots.assign(m_levelOffsets.back(), VIRTUAL_SLOT_NONE);
+    m_slotPages.assign(cacheSize * cacheSize, VIRTUAL_PAGE_NONE);
+    m_slotFrames.assign(cacheSize * cacheSize, 0);
+    m_freeUploads.clear();
+    for (u32 slot = VIRTUAL_TEXTURE_UPLOAD_PAGES; slot-- > 0;)
+        m_freeUploads.push_back(slot);
+
+    // Everything falls back on the top level page.
+    load(VIRTUAL_PAGE_KEY(m_levelCount - 1, 0, 0));
+}
+
+void VirtualTexture::Destroy()
+{
+    m_file.Close();
+    m_pageSlots.clear();
+    m_slotPages.clear();
+    m_slotFrames.clear();
+    m_loading.clear();
+    m_copiedUploads.clear();
+    m_loaded.clear();
+}
+
+const TiledTexture& VirtualTexture::GetFile() const
+{
+    return m_file;
+}
+
+u32 VirtualTexture::GetCacheSize() const
+{
+    return m_cacheSize;
+}
+
+u32 VirtualTexture::GetPageTableEntryCount() const
+{
+    return m_levelOffsets.empty() ? 0 : m_levelOffsets.back();
+}
+
+VirtualTextureParameters VirtualTexture::GetParameters(float lodBias) const
+{
+    float size = static_cast<float>(m_gridSize * VIRTUAL_PAGE_SIZE);
+
+    VirtualTextureParameters parameters{};
+    parameters.scale[0] = m_file.GetWidth() / size;
+    parameters.scale[1] = m_file.GetHeight() / size;
+    parameters.size = size;
+    parameters.maxLevel = static_cast<float>(m_levelCount - 1);
+    parameters.lodBias = lodBias;
+    parameters.cacheSize = static_cast<float>(m_cacheSize * VIRTUAL_PAGE_STRIDE);
+    return parameters;
+}
+
+// Keys sort by level first, so the missing pages are loaded coarsest first
+// and every page has something close to fall back on while its children load.
+void VirtualTexture::RequestPages(const u32* feedback, size_t count, u64 frame)
+{
+    m_frame = frame;
+    m_requests.assign(feedback, feedback + count);
+    std::sort(m_requests.begin(), m_requests.end());
+    m_requests.erase(std::unique(m_requests.begin(), m_requests.end()), m_requests.end());
+
+    std::vector<u32> missing;
+    for (u32 key : m_requests)
+    {
+        u32 level = getPageLevel(key), x = getPageX(key), y = getPageY(key);
+        if (key == VIRTUAL_PAGE_NONE || level >= m_levelCount || x >= (m_gridSize >> level) || y >= (m_gridSize >> level))
+            continue;
+
+        for (; level < m_levelCount; level++, x >>= 1, y >>= 1)
+        {
+            u32 page = VIRTUAL_PAGE_KEY(level, x, y);
+            u32 slot = m_pageSlots[getEntry(page)];
+            if (slot != VIRTUAL_SLOT_NONE)
+                m_slotFrames[slot] = frame;
+            else if (!m_loading.count(page) && m_file.GetPageOffset(level, x, y) != 0)
+                missing.push_back(page);
+        }
+    }
+
+    std::sort(missing.begin(), missing.end(), std::greater<u32>());
+    missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+    for (size_t i = 0; i < missing.size() && !m_freeUploads.empty(); i++)
+        load(missing[i]);
+}
+
+void VirtualTexture::CollectUploads(u64 frame, u64 completedFrame, std::vector<VirtualPageUpload>& uploads)
+{
+    while (!m_copiedUploads.empty() && m_copiedUploads.front().first <= completedFrame)
+    {
+        m_freeUploads.push_back(m_copiedUploads.front().second);
+        m_copiedUploads.pop_front();
+    }
+
+    std::vector<LoadedPage> loaded;
+    {
+        std::lock_guard<std::mutex> lock(m_loadedMutex);
+        loaded.swap(m_loaded);
+    }
+
+    // A page that finds no slot is dropped and requested again later.
+    for (const LoadedPage& page : loaded)
+    {
+        m_loading.erase(page.key);
+        u32 slot = page.success ? findCacheSlot() : VIRTUAL_SLOT_NONE;
+        if (slot == VIRTUAL_SLOT_NONE)
+        {
+            m_freeUploads.push_back(page.uploadSlot);
+            continue;
+        }
+
+        if (m_slotPages[slot] != VIRTUAL_PAGE_NONE)
+            m_pageSlots[getEntry(m_slotPages[slot])] = VIRTUAL_SLOT_NONE;
+        m_slotPages[slot] = page.key;
+        m_slotFrames[slot] = m_frame;
+        m_pageSlots[getEntry(page.key)] = slot;
+
+        uploads.push_back({ page.uploadSlot, slot % m_cacheSize, slot / m_cacheSize });
+        m_copiedUploads.push_back({ frame, page.uploadSlot });
+        m_dirty = true;
+    }
+}
+
+bool VirtualTexture::IsPageTableDirty() const
+{
+    return m_dirty;
+}
+
+// Coarsest level first, so pages that aren't resident copy their parent's
+// entry.
+void VirtualTexture::WritePageTable(u32* entries)
+{
+    for (u32 level = m_levelCount; level-- > 0;)
+    {
+        u32 side = m_gridSize >> level;
+        u32* grid = entries + m_levelOffsets[level];
+        const u32* parents = entries + m_levelOffsets[level + 1];
+        for (u32 y = 0; y < side; y++)
+        {
+            for (u32 x = 0; x < side; x++)
+            {
+                u32 slot = m_pageSlots[m_levelOffsets[level] + y * side + x];
+                if (slot != VIRTUAL_SLOT_NONE)
+                    grid[y * side + x] = (slot % m_cacheSize) | ((slot / m_cacheSize) << 8) | (level << 16) | (1u << 24);
+                else
+                    grid[y * side + x] = level + 1 < m_levelCount ? parents[(y / 2) * (side / 2) + x / 2] : 0;
+            }
+        }
+    }
+    m_dirty = false;
+}
+
+u32 VirtualTexture::getEntry(u32 key) const
+{
+    u32 level = getPageLevel(key);
+    return m_levelOffsets[level] + getPageY(key) * (m_gridSize >> level) + getPageX(key);
+}
+
+// Archived files have no file of their own to read from, their pages are
+// copied out of the mapping on the pool instead.
+void VirtualTexture::load(u32 key)
+{
+    u32 uploadSlot = m_freeUploads.back();
+    m_freeUploads.pop_back();
+    m_loading.insert(key);
+
+    u64 offset = m_file.GetPageOffset(getPageLevel(key), getPageX(key), getPageY(key));
+    u8* destination = m_uploadMemory + static_cast<size_t>(uploadSlot) * VIRTUAL_PAGE_BYTES;
+    ReadCallback done = [this, key, uploadSlot](bool success)
+    {
+        std::lock_guard<std::mutex> lock(m_loadedMutex);
+        m_loaded.push_back({ key, uploadSlot, success });
+    };
+
+    if (!m_archived)
+    {
+        m_io->Read(m_file.GetPath(), offset, VIRTUAL_PAGE_BYTES, destination, done);
+        return;
+    }
+
+    const u8* source = m_file.GetFileData() + offset;
+    m_pool->Submit([source, destination, done]()
+    {
+        memcpy(destination, source, VIRTUAL_PAGE_BYTES);
+        done(true);
+    });
+}
+
+// A free slot, or the least recently requested page that isn't the top level
+// one and wasn't requested by the latest feedback.
+u32 VirtualTexture::findCacheSlot() const
+{
+    u32 root = VIRTUAL_PAGE_KEY(m_levelCount - 1, 0, 0);
+    u32 best = VIRTUAL_SLOT_NONE;
+    for (u32 slot = 0; slot < m_slotPages.size(); slot++)
+    {
+        if (m_slotPages[slot] == VIRTUAL_PAGE_NONE)
+            return slot;
+        if (m_slotPages[slot] == root || m_slotFrames[slot] == m_frame)
+            continue;
+        if (best == VIRTUAL_SLOT_NONE || m_slotFrames[slot] < m_slotFrames[best])
+            best = slot;
+    }
+    return best;
+}